@@ -9,6 +9,7 @@
 #include "spdlog/spdlog.h"
 #include "spdlog/async.h"
 #include "spdlog/sinks/basic_file_sink.h"
+#include "spdlog/sinks/null_sink.h"
 
 #if defined(SPDLOG_USE_STD_FORMAT)
 #    include <format>
@@ -31,7 +32,8 @@ using namespace spdlog;
 using namespace spdlog::sinks;
 using namespace utils;
 
-void bench_mt(int howmany, std::shared_ptr<spdlog::logger> log, int thread_count);
+double bench_mt(int howmany, std::shared_ptr<spdlog::logger> log, int thread_count);
+void bench_scaling(int howmany, int max_threads, int queue_size, async_queue_topology topology);
 
 #ifdef _MSC_VER
 #    pragma warning(push)
@@ -83,6 +85,23 @@ int main(int argc, char *argv[])
         if (argc == 1)
         {
             spdlog::info("Usage: {} <message_count> <threads> <q_size> <iterations>", argv[0]);
+            spdlog::info("       {} scaling <message_count> <max_threads> <q_size> [shared|per_thread|byte_ring]", argv[0]);
+            return 0;
+        }
+
+        if (std::string(argv[1]) == "scaling")
+        {
+            if (argc > 2)
+                howmany = atoi(argv[2]);
+            int max_threads = argc > 3 ? atoi(argv[3]) : 32;
+            if (argc > 4)
+                queue_size = atoi(argv[4]);
+            auto topology = async_queue_topology::shared;
+            if (argc > 5 && std::string(argv[5]) == "per_thread")
+                topology = async_queue_topology::per_thread;
+            else if (argc > 5 && std::string(argv[5]) == "byte_ring")
+                topology = async_queue_topology::byte_ring;
+            bench_scaling(howmany, max_threads, queue_size, topology);
             return 0;
         }
 
@@ -159,7 +178,7 @@ void thread_fun(std::shared_ptr<spdlog::logger> logger, int howmany)
     }
 }
 
-void bench_mt(int howmany, std::shared_ptr<spdlog::logger> logger, int thread_count)
+double bench_mt(int howmany, std::shared_ptr<spdlog::logger> logger, int thread_count)
 {
     using std::chrono::high_resolution_clock;
     vector<std::thread> threads;
@@ -183,4 +202,38 @@ void bench_mt(int howmany, std::shared_ptr<spdlog::logger> logger, int thread_co
     auto delta = high_resolution_clock::now() - start;
     auto delta_d = duration_cast<duration<double>>(delta).count();
     spdlog::info("Elapsed: {} secs\t {:L}/sec", delta_d, int(howmany / delta_d));
+    return howmany / delta_d;
+}
+
+// throughput of the queue alone (null sink) for 1, 2, 4 .. max_threads producers.
+// with the per_thread topology queue_size is the size of each producer's ring,
+// with the byte_ring topology it is the size of the ring in bytes.
+void bench_scaling(int howmany, int max_threads, int queue_size, async_queue_topology topology)
+{
+    thread_pool_options options;
+    options.topology = topology;
+    options.queue_size = static_cast<size_t>(queue_size);
+    options.per_thread_queue_size = static_cast<size_t>(queue_size);
+    options.queue_bytes = static_cast<size_t>(queue_size);
+    spdlog::info("-------------------------------------------------");
+    spdlog::info("Scaling      : {:L} messages, 1..{} producers, {} queue {:L} slots", howmany, max_threads,
+        topology == async_queue_topology::shared ? "shared" : topology == async_queue_topology::per_thread ? "per thread" : "byte ring",
+        queue_size);
+    spdlog::info("-------------------------------------------------");
+    std::vector<std::pair<int, double>> curve;
+    for (int threads = 1; threads <= max_threads; threads *= 2)
+    {
+        auto tp = std::make_shared<details::thread_pool>(options);
+        auto logger = std::make_shared<async_logger>(
+            "async_logger", std::make_shared<spdlog::sinks::null_sink_mt>(), std::move(tp), async_overflow_policy::block);
+        spdlog::info("Producers: {}", threads);
+        curve.emplace_back(threads, bench_mt(howmany, std::move(logger), threads));
+    }
+
+    spdlog::info("");
+    spdlog::info("{:>10} {:>15} {:>8}", "producers", "msgs/sec", "speedup");
+    for (auto &point : curve)
+    {
+        spdlog::info("{:>10} {:>15L} {:>7.2f}x", point.first, int(point.second), point.second / curve.front().second);
+    }
 }
@@ -15,6 +15,12 @@
 #include "spdlog/sinks/daily_file_sink.h"
 #include "spdlog/sinks/null_sink.h"
 #include "spdlog/sinks/rotating_file_sink.h"
+#include "spdlog/sinks/base_sink.h"
+#include "spdlog/details/null_mutex.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
 
 void bench_c_string(benchmark::State &state, std::shared_ptr<spdlog::logger> logger)
 {
@@ -61,6 +67,46 @@ void bench_disabled_macro(benchmark::State &state, std::shared_ptr<spdlog::logge
     }
 }
 
+// counts the messages reaching the sink (only the async worker thread writes it)
+class arrival_sink final : public spdlog::sinks::base_sink<spdlog::details::null_mutex>
+{
+public:
+    std::atomic<size_t> arrived{0};
+
+protected:
+    void sink_it_(const spdlog::details::log_msg &) override
+    {
+        arrived.fetch_add(1, std::memory_order_release);
+    }
+    void flush_() override {}
+};
+
+// end to end latency of an async logger: from the log call until the worker thread handed the message to the sink.
+// the logger is idle between the messages, so the worker thread waits the way its wait strategy says.
+void bench_async_latency(benchmark::State &state, spdlog::async_wait_strategy strategy)
+{
+    spdlog::thread_pool_options options;
+    options.wait_strategy = strategy;
+    auto tp = std::make_shared<spdlog::details::thread_pool>(options);
+    auto sink = std::make_shared<arrival_sink>();
+    auto logger = std::make_shared<spdlog::async_logger>("async_latency", sink, tp);
+
+    int i = 0;
+    for (auto _ : state)
+    {
+        auto expected = sink->arrived.load(std::memory_order_relaxed) + 1;
+        auto start = std::chrono::steady_clock::now();
+        logger->info("Hello logger: msg number {}...............", ++i);
+        while (sink->arrived.load(std::memory_order_acquire) != expected)
+        {
+            std::this_thread::yield();
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        state.SetIterationTime(std::chrono::duration_cast<std::chrono::duration<double>>(elapsed).count());
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+}
+
 #ifdef __linux__
 void bench_dev_null()
 {
@@ -172,6 +218,15 @@ int main(int argc, char *argv[])
     async_logger_tracing->enable_backtrace(32);
     benchmark::RegisterBenchmark("async_logger/tracing", bench_logger, async_logger_tracing)->Threads(n_threads)->UseRealTime();
 
+    // end to end latency for each wait strategy of the worker thread
+    benchmark::RegisterBenchmark("async_latency/park", bench_async_latency, spdlog::async_wait_strategy::park)->UseManualTime();
+    benchmark::RegisterBenchmark("async_latency/busy_spin", bench_async_latency, spdlog::async_wait_strategy::busy_spin)->UseManualTime();
+    benchmark::RegisterBenchmark("async_latency/yield", bench_async_latency, spdlog::async_wait_strategy::yield)->UseManualTime();
+    benchmark::RegisterBenchmark("async_latency/spin_then_park", bench_async_latency, spdlog::async_wait_strategy::spin_then_park)
+        ->UseManualTime();
+    benchmark::RegisterBenchmark("async_latency/timed_batch", bench_async_latency, spdlog::async_wait_strategy::timed_batch)
+        ->UseManualTime();
+
     benchmark::Initialize(&argc, argv);
     benchmark::RunSpecifiedBenchmarks();
 }
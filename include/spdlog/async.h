@@ -59,6 +59,7 @@ struct async_factory_impl
 
 using async_factory = async_factory_impl<async_overflow_policy::block>;
 using async_factory_nonblock = async_factory_impl<async_overflow_policy::overrun_oldest>;
+using async_factory_discard = async_factory_impl<async_overflow_policy::discard_new>;
 
 template<typename Sink, typename... SinkArgs>
 inline std::shared_ptr<spdlog::logger> create_async(std::string logger_name, SinkArgs &&... sink_args)
@@ -72,6 +73,12 @@ inline std::shared_ptr<spdlog::logger> create_async_nb(std::string logger_name,
     return async_factory_nonblock::create<Sink>(std::move(logger_name), std::forward<SinkArgs>(sink_args)...);
 }
 
+template<typename Sink, typename... SinkArgs>
+inline std::shared_ptr<spdlog::logger> create_async_discard(std::string logger_name, SinkArgs &&... sink_args)
+{
+    return async_factory_discard::create<Sink>(std::move(logger_name), std::forward<SinkArgs>(sink_args)...);
+}
+
 // set global thread pool.
 inline void init_thread_pool(size_t q_size, size_t thread_count, std::function<void()> on_thread_start, std::function<void()> on_thread_stop)
 {
@@ -89,6 +96,13 @@ inline void init_thread_pool(size_t q_size, size_t thread_count)
     init_thread_pool(q_size, thread_count, [] {}, [] {});
 }
 
+// set global thread pool with the given queue topology and worker threads.
+inline void init_thread_pool(const thread_pool_options &options)
+{
+    auto tp = std::make_shared<details::thread_pool>(options);
+    details::registry::instance().set_tp(std::move(tp));
+}
+
 // get the global thread pool.
 inline std::shared_ptr<spdlog::details::thread_pool> thread_pool()
 {
@@ -10,6 +10,7 @@
 #include <spdlog/sinks/sink.h>
 #include <spdlog/details/thread_pool.h>
 
+#include <algorithm>
 #include <memory>
 #include <string>
 
@@ -23,12 +24,39 @@ SPDLOG_INLINE spdlog::async_logger::async_logger(
     : async_logger(std::move(logger_name), {std::move(single_sink)}, std::move(tp), overflow_policy)
 {}
 
+SPDLOG_INLINE spdlog::async_logger::~async_logger()
+{
+    if (auto pool_ptr = thread_pool_.lock())
+    {
+        SPDLOG_TRY
+        {
+            // through the pool, before retiring: ~logger() can only write them to the sinks directly
+            log_pending_suppressed_();
+            pool_ptr->retire(this);
+        }
+        SPDLOG_CATCH_STD
+    }
+}
+
 // send the log message to the thread pool
 SPDLOG_INLINE void spdlog::async_logger::sink_it_(const details::log_msg &msg)
 {
     if (auto pool_ptr = thread_pool_.lock())
     {
-        pool_ptr->post_log(shared_from_this(), msg, overflow_policy_);
+        pool_ptr->post_log(this, msg, overflow_policy_);
+    }
+    else
+    {
+        throw_spdlog_ex("async log: thread pool doesn't exist anymore");
+    }
+}
+
+// the load shedding dropped the message before it was formatted
+SPDLOG_INLINE void spdlog::async_logger::count_drop_(level::level_enum lvl)
+{
+    if (auto pool_ptr = thread_pool_.lock())
+    {
+        pool_ptr->count_shed(this, lvl);
     }
     else
     {
@@ -41,7 +69,27 @@ SPDLOG_INLINE void spdlog::async_logger::flush_()
 {
     if (auto pool_ptr = thread_pool_.lock())
     {
-        pool_ptr->post_flush(shared_from_this(), overflow_policy_);
+        pool_ptr->post_flush(this, overflow_policy_);
+    }
+    else
+    {
+        throw_spdlog_ex("async flush: thread pool doesn't exist anymore");
+    }
+}
+
+SPDLOG_INLINE std::future<void> spdlog::async_logger::flush_async()
+{
+    auto flushed = std::make_shared<std::promise<void>>();
+    auto future = flushed->get_future();
+    flush_async([flushed] { flushed->set_value(); });
+    return future;
+}
+
+SPDLOG_INLINE void spdlog::async_logger::flush_async(std::function<void()> on_flushed)
+{
+    if (auto pool_ptr = thread_pool_.lock())
+    {
+        pool_ptr->post_flush(this, std::move(on_flushed));
     }
     else
     {
@@ -54,19 +102,69 @@ SPDLOG_INLINE void spdlog::async_logger::flush_()
 //
 SPDLOG_INLINE void spdlog::async_logger::backend_sink_it_(const details::log_msg &msg)
 {
+    details::msg_derived derived{msg};
+    // format threads may have attached the output already
+    if (sinks_.size() > 1 && msg.shared_output == nullptr)
+    {
+        details::output_cache_scope shared_output{msg};
+        sink_to_all_(msg);
+    }
+    else
+    {
+        sink_to_all_(msg);
+    }
+
+    if (should_flush_(msg))
+    {
+        backend_flush_();
+    }
+}
+
+// pass a batch of messages to every sink at once: one sink lock per batch instead of one per message
+SPDLOG_INLINE void spdlog::async_logger::backend_sink_batch_(const details::log_msg *msgs, size_t count)
+{
+    if (count == 1)
+    {
+        backend_sink_it_(msgs[0]);
+        return;
+    }
+
+    auto min_level = level::off;
+    bool flush = false;
+    for (size_t i = 0; i < count; i++)
+    {
+        min_level = std::min(min_level, msgs[i].level);
+        flush = flush || should_flush_(msgs[i]);
+    }
+
+    details::msg_derived_batch_scope derived{msgs, count};
+    details::output_cache_batch_scope shared_output{msgs, sinks_.size() > 1 && msgs[0].shared_output == nullptr ? count : 0};
     for (auto &sink : sinks_)
     {
-        if (sink->should_log(msg.level))
+        if (sink->should_log(min_level))
         {
             SPDLOG_TRY
             {
-                sink->log(msg);
+                sink->log_batch(msgs, count);
+            }
+            SPDLOG_LOGGER_CATCH(msgs[0].source)
+            continue;
+        }
+        // the sink filters some of the messages
+        for (size_t i = 0; i < count; i++)
+        {
+            if (sink->should_log(msgs[i].level))
+            {
+                SPDLOG_TRY
+                {
+                    sink->log(msgs[i]);
+                }
+                SPDLOG_LOGGER_CATCH(msgs[i].source)
             }
-            SPDLOG_LOGGER_CATCH(msg.source)
         }
     }
 
-    if (should_flush_(msg))
+    if (flush)
     {
         backend_flush_();
     }
@@ -88,5 +186,38 @@ SPDLOG_INLINE std::shared_ptr<spdlog::logger> spdlog::async_logger::clone(std::s
 {
     auto cloned = std::make_shared<spdlog::async_logger>(*this);
     cloned->name_ = std::move(new_name);
+    cloned->watch_shed_level_();
     return cloned;
 }
+
+SPDLOG_INLINE void spdlog::async_logger::watch_shed_level_()
+{
+    auto pool_ptr = thread_pool_.lock();
+    shed_level_ = pool_ptr ? pool_ptr->shed_level_source() : nullptr;
+    drop_level_ = shed_level_.get();
+}
+
+SPDLOG_INLINE void spdlog::async_logger::set_priority_lane(bool enabled)
+{
+    priority_lane_ = enabled;
+}
+
+SPDLOG_INLINE bool spdlog::async_logger::priority_lane() const
+{
+    return priority_lane_;
+}
+
+SPDLOG_INLINE size_t spdlog::async_logger::dropped() const
+{
+    size_t total = 0;
+    for (auto &count : drops_.total)
+    {
+        total += count.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+SPDLOG_INLINE size_t spdlog::async_logger::dropped(level::level_enum lvl) const
+{
+    return drops_.total[lvl].load(std::memory_order_relaxed);
+}
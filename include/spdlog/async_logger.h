@@ -11,24 +11,86 @@
 //    1. Checks if its log level is enough to log the message
 //    2. Push a new copy of the message to a queue (or block the caller until
 //    space is available in the queue)
-// Upon destruction, logs all remaining messages in the queue before
-// destructing..
+// Upon destruction, waits for the back thread(s) to log all its remaining
+// messages in the queue before destructing (the queued messages don't keep
+// the logger alive).
 
 #include <spdlog/logger.h>
 
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <future>
+
 namespace spdlog {
 
 // Async overflow policy - block by default.
 enum class async_overflow_policy
 {
-    block,         // Block until message can be enqueued
-    overrun_oldest // Discard oldest message in the queue if full when trying to
-                   // add new item.
+    block,          // Block until message can be enqueued
+    overrun_oldest, // Discard oldest message in the queue if full when trying to
+                    // add new item.
+    discard_new,    // Discard the new message if the queue is full, without waiting.
+                    // counted per logger and level (async_logger::dropped()) and reported
+                    // by a warning through the logger's sinks once the queue drained.
+    spill           // Write the message to the thread pool's spill file if the queue is full
+                    // (thread_pool_options::spill_path). Block if the pool has none.
 };
 
 namespace details {
 class thread_pool;
-}
+
+// place of an async logger in a sharded thread pool (see async_queue_topology::sharded)
+struct async_shard
+{
+    static const uint32_t unassigned = 0xffffffffu;
+    static const uint32_t moving = 0xfffffffeu;
+
+    async_shard() = default;
+    // a copy (clone) gets a place of its own
+    async_shard(const async_shard &) {}
+    async_shard &operator=(const async_shard &)
+    {
+        return *this;
+    }
+
+    char pad0_[64];
+    std::atomic<uint32_t> index{unassigned}; // read by the logging threads
+    char pad1_[64];
+    std::atomic<size_t> processed{0}; // written by the worker thread of the shard
+    char pad2_[64];
+};
+
+// messages of an async logger dropped by the discard_new policy
+struct async_drops
+{
+    async_drops() = default;
+    // a copy (clone) counts its own
+    async_drops(const async_drops &) {}
+    async_drops &operator=(const async_drops &)
+    {
+        return *this;
+    }
+
+    std::atomic<size_t> total[level::n_levels]{};
+    std::atomic<size_t> unreported[level::n_levels]{}; // since the last report
+    std::atomic<bool> report_pending{false};           // the thread pool knows there is something to report
+};
+
+// an async logger written by the worker threads since the last thread_pool::flush_barrier()
+struct async_unflushed
+{
+    async_unflushed() = default;
+    // a copy (clone) tracks its own writes
+    async_unflushed(const async_unflushed &) {}
+    async_unflushed &operator=(const async_unflushed &)
+    {
+        return *this;
+    }
+
+    std::atomic<bool> value{false};
+};
+} // namespace details
 
 class SPDLOG_API async_logger final : public std::enable_shared_from_this<async_logger>, public logger
 {
@@ -41,7 +103,9 @@ public:
         : logger(std::move(logger_name), begin, end)
         , thread_pool_(std::move(tp))
         , overflow_policy_(overflow_policy)
-    {}
+    {
+        watch_shed_level_();
+    }
 
     async_logger(std::string logger_name, sinks_init_list sinks_list, std::weak_ptr<details::thread_pool> tp,
         async_overflow_policy overflow_policy = async_overflow_policy::block);
@@ -49,17 +113,46 @@ public:
     async_logger(std::string logger_name, sink_ptr single_sink, std::weak_ptr<details::thread_pool> tp,
         async_overflow_policy overflow_policy = async_overflow_policy::block);
 
+    // wait until the thread pool is done with the queued messages of this logger
+    ~async_logger() override;
+
     std::shared_ptr<logger> clone(std::string new_name) override;
 
+    // let the messages at the thread pool's priority level or above overtake the others through the priority
+    // lane (the default). disable it to keep all the messages of this logger in the order they were logged.
+    // set it before logging.
+    void set_priority_lane(bool enabled);
+    bool priority_lane() const;
+
+    // messages dropped by the discard_new overflow policy or the thread pool's load shedding (of the given level)
+    size_t dropped() const;
+    size_t dropped(level::level_enum lvl) const;
+
+    // flush without waiting: the future is ready (on_flushed is called by a worker thread) once the messages
+    // logged before the call are written and the sinks flushed. requests coming together share one flush.
+    // the request is never dropped: overrun_oldest posts of other loggers put it back in the queue.
+    std::future<void> flush_async();
+    void flush_async(std::function<void()> on_flushed);
+
 protected:
     void sink_it_(const details::log_msg &msg) override;
+    void count_drop_(level::level_enum lvl) override;
     void flush_() override;
     void backend_sink_it_(const details::log_msg &incoming_log_msg);
+    void backend_sink_batch_(const details::log_msg *msgs, size_t count);
     void backend_flush_();
 
 private:
     std::weak_ptr<details::thread_pool> thread_pool_;
+    // the pool's load shedding level, checked by should_process_() (see drop_level_)
+    std::shared_ptr<const level_t> shed_level_;
     async_overflow_policy overflow_policy_;
+    bool priority_lane_ = true;
+    details::async_shard shard_;
+    details::async_drops drops_;
+    details::async_unflushed unflushed_;
+
+    void watch_shed_level_();
 };
 } // namespace spdlog
 
@@ -17,6 +17,9 @@
 // turn off all logging except for logger1 and logger2:
 // example.exe "SPDLOG_LEVEL=off,logger1=debug,logger2=info"
 
+// Init call site modes using each argv entry that starts with "SPDLOG_CALLSITES="
+// example.exe "SPDLOG_CALLSITES=parser.cpp=on,handle_*()=on"
+
 namespace spdlog {
 namespace cfg {
 
@@ -40,5 +43,24 @@ inline void load_argv_levels(int argc, char **argv)
     load_argv_levels(argc, const_cast<const char **>(argv));
 }
 
+// search for SPDLOG_CALLSITES= in the args and use it to init the call site modes
+inline void load_argv_callsite_modes(int argc, const char **argv)
+{
+    const std::string spdlog_callsites_prefix = "SPDLOG_CALLSITES=";
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg.find(spdlog_callsites_prefix) == 0)
+        {
+            helpers::load_callsite_modes(arg.substr(spdlog_callsites_prefix.size()));
+        }
+    }
+}
+
+inline void load_argv_callsite_modes(int argc, char **argv)
+{
+    load_argv_callsite_modes(argc, const_cast<const char **>(argv));
+}
+
 } // namespace cfg
 } // namespace spdlog
@@ -22,6 +22,11 @@
 
 // turn off all logging except for logger1 and logger2:
 // export SPDLOG_LEVEL="off,logger1=debug,logger2=info"
+//
+// Init call site modes from the env variable SPDLOG_CALLSITES (see spdlog::set_callsite_mode())
+//
+// turn on all sites in parser.cpp and silence line 120 of conn.cpp:
+// export SPDLOG_CALLSITES="parser.cpp=on,conn.cpp:120=off"
 
 namespace spdlog {
 namespace cfg {
@@ -34,5 +39,14 @@ inline void load_env_levels()
     }
 }
 
+inline void load_env_callsite_modes()
+{
+    auto env_val = details::os::getenv("SPDLOG_CALLSITES");
+    if (!env_val.empty())
+    {
+        helpers::load_callsite_modes(env_val);
+    }
+}
+
 } // namespace cfg
 } // namespace spdlog
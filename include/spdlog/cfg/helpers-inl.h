@@ -115,6 +115,41 @@ SPDLOG_INLINE void load_levels(const std::string &input)
     details::registry::instance().set_levels(std::move(levels), global_level_found ? &global_level : nullptr);
 }
 
+SPDLOG_INLINE void load_callsite_modes(const std::string &input)
+{
+    if (input.empty() || input.size() > 4096)
+    {
+        return;
+    }
+
+    std::string token;
+    std::istringstream token_stream(input);
+    while (std::getline(token_stream, token, ','))
+    {
+        auto kv = extract_kv_('=', token);
+        auto &selector = kv.first;
+        auto mode_name = to_lower_(kv.second);
+        // ignore the selectors that can't match (empty, line number out of range)
+        if (!details::callsite::valid_selector(selector))
+        {
+            continue;
+        }
+        if (mode_name == "on")
+        {
+            set_callsite_mode(selector, callsite_mode::on);
+        }
+        else if (mode_name == "off")
+        {
+            set_callsite_mode(selector, callsite_mode::off);
+        }
+        else if (mode_name == "default")
+        {
+            set_callsite_mode(selector, callsite_mode::by_level);
+        }
+        // ignore unrecognized mode names
+    }
+}
+
 } // namespace helpers
 } // namespace cfg
 } // namespace spdlog
@@ -19,6 +19,17 @@ namespace helpers {
 // turn off all logging except for logger1 and logger2: "off,logger1=debug,logger2=info"
 //
 SPDLOG_API void load_levels(const std::string &txt);
+
+//
+// Init call site modes from given string (see spdlog::set_callsite_mode())
+// Entries are applied in order, later entries take precedence.
+//
+// Examples:
+//
+// turn on the sites in parser.cpp: "parser.cpp=on"
+// turn on one function and silence one line: "handle_*()=on,net/conn.cpp:120=off"
+//
+SPDLOG_API void load_callsite_modes(const std::string &txt);
 } // namespace helpers
 
 } // namespace cfg
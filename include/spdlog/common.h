@@ -271,6 +271,16 @@ enum class pattern_time_type
     utc    // log utc
 };
 
+//
+// Formatter sharing - whether sinks with equivalent formatters format a message once.
+//
+enum class formatter_sharing
+{
+    automatic, // share when the formatters are known to be equivalent (same pattern, same json fields)
+    always,    // the sinks set in the same call share the output, even for custom formatters
+    never      // every sink formats on its own
+};
+
 //
 // Log exception
 //
@@ -288,6 +298,10 @@ private:
 [[noreturn]] SPDLOG_API void throw_spdlog_ex(const std::string &msg, int last_errno);
 [[noreturn]] SPDLOG_API void throw_spdlog_ex(std::string msg);
 
+namespace details {
+class callsite;
+}
+
 struct source_loc
 {
     SPDLOG_CONSTEXPR source_loc() = default;
@@ -304,6 +318,8 @@ struct source_loc
     const char *filename{nullptr};
     int line{0};
     const char *funcname{nullptr};
+    // static descriptor of the logging macro that produced this location (if any)
+    details::callsite *site{nullptr};
 };
 
 struct file_event_handlers
@@ -6,35 +6,200 @@
 #ifndef SPDLOG_HEADER_ONLY
 #    include <spdlog/details/backtracer.h>
 #endif
+
+#include <spdlog/details/msg_record.h>
+
+#include <algorithm>
+#include <cstring>
+
 namespace spdlog {
 namespace details {
+
+SPDLOG_INLINE backtrace_ring::backtrace_ring(size_t capacity, size_t max_large)
+    : max_large_{max_large}
+{
+    // power of two, so positions wrap with a mask
+    size_t rounded = 64;
+    while (rounded < capacity)
+    {
+        rounded <<= 1;
+    }
+    words_.reset(new std::atomic<uint64_t>[rounded / sizeof(uint64_t)]());
+    mask_ = rounded - 1;
+}
+
+SPDLOG_INLINE void backtrace_ring::push(const char *record, size_t size)
+{
+    if (size > capacity())
+    {
+        std::lock_guard<std::mutex> lock(large_mutex_);
+        if (max_large_ == 0)
+        {
+            return;
+        }
+        if (large_.size() == max_large_)
+        {
+            large_.pop_front();
+        }
+        large_.emplace_back(record, record + size);
+        return;
+    }
+    auto head = head_.load(std::memory_order_relaxed);
+    auto tail = tail_.load(std::memory_order_relaxed);
+    if (head + size - tail > capacity())
+    {
+        while (head + size - tail > capacity())
+        {
+            char size_buf[sizeof(uint32_t)];
+            copy_out_(tail, size_buf, sizeof(size_buf));
+            tail += msg_record::size(size_buf);
+        }
+        // publish the eviction before overwriting (seqlock style): a reader that sees any of
+        // the new bytes also sees the new tail and skips the overwritten records.
+        tail_.store(tail, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+    copy_in_(head, record, size);
+    head_.store(head + size, std::memory_order_release);
+}
+
+SPDLOG_INLINE void backtrace_ring::pop_all(std::vector<char> &dest)
+{
+    read_(dest, true);
+}
+
+SPDLOG_INLINE void backtrace_ring::copy_all(std::vector<char> &dest)
+{
+    read_(dest, false);
+}
+
+SPDLOG_INLINE void backtrace_ring::read_(std::vector<char> &dest, bool consume)
+{
+    {
+        std::lock_guard<std::mutex> lock(large_mutex_);
+        for (auto &record : large_)
+        {
+            dest.insert(dest.end(), record.begin(), record.end());
+        }
+        if (consume)
+        {
+            large_.clear();
+        }
+    }
+
+    auto head = head_.load(std::memory_order_acquire);
+    auto start = std::max(consumed_, tail_.load(std::memory_order_relaxed));
+    if (consume)
+    {
+        consumed_ = head;
+    }
+    if (start >= head)
+    {
+        return;
+    }
+
+    auto offset = dest.size();
+    auto n = static_cast<size_t>(head - start);
+    dest.resize(offset + n);
+    copy_out_(start, dest.data() + offset, n);
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    // drop what the writer overwrote while we were copying
+    auto tail = tail_.load(std::memory_order_relaxed);
+    if (tail >= head)
+    {
+        dest.resize(offset);
+    }
+    else if (tail > start)
+    {
+        auto skip = static_cast<size_t>(tail - start);
+        dest.erase(dest.begin() + static_cast<std::ptrdiff_t>(offset), dest.begin() + static_cast<std::ptrdiff_t>(offset + skip));
+    }
+}
+
+// the capacity is a multiple of the word size, so a word never wraps around the end of the ring.
+// the ring has a single writer: partial words are read, patched and stored back.
+SPDLOG_INLINE void backtrace_ring::copy_in_(uint64_t pos, const char *src, size_t n)
+{
+    while (n > 0)
+    {
+        auto index = static_cast<size_t>(pos) & mask_;
+        auto offset = index % sizeof(uint64_t);
+        auto chunk = std::min(n, sizeof(uint64_t) - offset);
+        auto &word = words_[index / sizeof(uint64_t)];
+        uint64_t value = chunk == sizeof(uint64_t) ? 0 : word.load(std::memory_order_relaxed);
+        std::memcpy(reinterpret_cast<char *>(&value) + offset, src, chunk);
+        word.store(value, std::memory_order_relaxed);
+        pos += chunk;
+        src += chunk;
+        n -= chunk;
+    }
+}
+
+SPDLOG_INLINE void backtrace_ring::copy_out_(uint64_t pos, char *dest, size_t n) const
+{
+    while (n > 0)
+    {
+        auto index = static_cast<size_t>(pos) & mask_;
+        auto offset = index % sizeof(uint64_t);
+        auto chunk = std::min(n, sizeof(uint64_t) - offset);
+        uint64_t value = words_[index / sizeof(uint64_t)].load(std::memory_order_relaxed);
+        std::memcpy(dest, reinterpret_cast<const char *>(&value) + offset, chunk);
+        pos += chunk;
+        dest += chunk;
+        n -= chunk;
+    }
+}
+
+SPDLOG_INLINE backtracer::backtracer()
+    : rings_{details::make_unique<per_thread<backtrace_ring>>()}
+{}
+
+// the copy gets its own rings, and replays the messages of other on its first pop
 SPDLOG_INLINE backtracer::backtracer(const backtracer &other)
+    : rings_{details::make_unique<per_thread<backtrace_ring>>()}
 {
     std::lock_guard<std::mutex> lock(other.mutex_);
     enabled_ = other.enabled();
-    messages_ = other.messages_;
+    messages_ = other.messages_.load(std::memory_order_relaxed);
+    copied_ = other.copied_;
+    if (other.rings_)
+    {
+        other.rings_->for_each([this](backtrace_ring &ring) { ring.copy_all(copied_); });
+    }
 }
 
 SPDLOG_INLINE backtracer::backtracer(backtracer &&other) SPDLOG_NOEXCEPT
 {
     std::lock_guard<std::mutex> lock(other.mutex_);
     enabled_ = other.enabled();
-    messages_ = std::move(other.messages_);
+    messages_ = other.messages_.load(std::memory_order_relaxed);
+    rings_ = std::move(other.rings_);
+    copied_ = std::move(other.copied_);
+    other.enabled_ = false;
 }
 
 SPDLOG_INLINE backtracer &backtracer::operator=(backtracer other)
 {
     std::lock_guard<std::mutex> lock(mutex_);
     enabled_ = other.enabled();
-    messages_ = std::move(other.messages_);
+    messages_ = other.messages_.load(std::memory_order_relaxed);
+    rings_.swap(other.rings_);
+    copied_.swap(other.copied_);
     return *this;
 }
 
 SPDLOG_INLINE void backtracer::enable(size_t size)
 {
     std::lock_guard<std::mutex> lock{mutex_};
+    if (!rings_)
+    {
+        rings_ = details::make_unique<per_thread<backtrace_ring>>();
+    }
+    messages_.store(size, std::memory_order_relaxed);
+    rings_->reset();
+    copied_.clear();
     enabled_.store(true, std::memory_order_relaxed);
-    messages_ = circular_q<log_msg_buffer>{size};
 }
 
 SPDLOG_INLINE void backtracer::disable()
@@ -48,21 +213,52 @@ SPDLOG_INLINE bool backtracer::enabled() const
     return enabled_.load(std::memory_order_relaxed);
 }
 
+SPDLOG_INLINE size_t backtracer::ring_capacity_() const
+{
+    // room for about 256 bytes per message, shared by the messages of one thread
+    return std::max(messages_.load(std::memory_order_relaxed) * 256, static_cast<size_t>(4096));
+}
+
 SPDLOG_INLINE void backtracer::push_back(const log_msg &msg)
 {
-    std::lock_guard<std::mutex> lock{mutex_};
-    messages_.push_back(log_msg_buffer{msg});
+    auto &ring = rings_->local([this] { return new backtrace_ring(ring_capacity_(), messages_.load(std::memory_order_relaxed)); });
+    memory_buf_t record;
+    msg_record::encode(msg, record);
+    ring.push(record.data(), record.size());
 }
 
 // pop all items in the q and apply the given fun on each of them.
-SPDLOG_INLINE void backtracer::foreach_pop(std::function<void(const details::log_msg &)> fun)
+SPDLOG_INLINE void backtracer::foreach_pop(string_view_t logger_name, const std::function<void(const details::log_msg &)> &fun)
 {
     std::lock_guard<std::mutex> lock{mutex_};
-    while (!messages_.empty())
+    if (!rings_)
+    {
+        return;
+    }
+
+    std::vector<char> records;
+    records.swap(copied_);
+    rings_->for_each([&records](backtrace_ring &ring) { ring.pop_all(records); });
+    rings_->release_unused();
+
+    // each ring is in time order: a stable sort merges them and keeps the order of a thread
+    std::vector<size_t> offsets;
+    for (size_t offset = 0; offset < records.size(); offset += msg_record::size(records.data() + offset))
+    {
+        offsets.push_back(offset);
+    }
+    const char *base = records.data();
+    std::stable_sort(offsets.begin(), offsets.end(),
+        [base](size_t a, size_t b) { return msg_record::time(base + a) < msg_record::time(base + b); });
+
+    auto max_messages = messages_.load(std::memory_order_relaxed);
+    auto first = offsets.size() > max_messages ? offsets.size() - max_messages : 0;
+    log_msg msg;
+    std::vector<Field> fields;
+    for (size_t i = first; i < offsets.size(); i++)
     {
-        auto &front_msg = messages_.front();
-        fun(front_msg);
-        messages_.pop_front();
+        msg_record::decode(base + offsets[i], logger_name, msg, fields);
+        fun(msg);
     }
 }
 } // namespace details
@@ -3,26 +3,76 @@
 
 #pragma once
 
-#include <spdlog/details/log_msg_buffer.h>
-#include <spdlog/details/circular_q.h>
+#include <spdlog/details/log_msg.h>
+#include <spdlog/details/per_thread.h>
 
 #include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
 #include <mutex>
 #include <functional>
+#include <vector>
 
 // Store log messages in circular buffer.
 // Useful for storing debug data in case of error/warning happens.
+//
+// Each logging thread writes compact records (see msg_record.h) to its own byte ring,
+// so push_back() takes no lock and allocates nothing after the thread's first message.
+// foreach_pop() merges the rings by time and replays the newest messages.
 
 namespace spdlog {
 namespace details {
+
+// byte ring written by a single thread. the oldest records are overwritten when it is full.
+// the reader copies the ring and keeps only the records the writer did not overwrite meanwhile.
+// the ring is made of atomic words, so a reader racing the writer reads stale bytes, never torn ones.
+// records larger than the ring are kept on the heap instead (the newest max_large of them).
+class SPDLOG_API backtrace_ring
+{
+public:
+    backtrace_ring(size_t capacity, size_t max_large);
+
+    size_t capacity() const
+    {
+        return mask_ + 1;
+    }
+
+    // writer thread only
+    void push(const char *record, size_t size);
+
+    // reader (one at a time): append the records written since the last pop to dest
+    void pop_all(std::vector<char> &dest);
+
+    // reader (one at a time): append the records not popped yet to dest, and keep them
+    void copy_all(std::vector<char> &dest);
+
+private:
+    void read_(std::vector<char> &dest, bool consume);
+    void copy_in_(uint64_t pos, const char *src, size_t n);
+    void copy_out_(uint64_t pos, char *dest, size_t n) const;
+
+    std::unique_ptr<std::atomic<uint64_t>[]> words_;
+    size_t mask_;
+    std::atomic<uint64_t> head_{0}; // end of the last complete record
+    std::atomic<uint64_t> tail_{0}; // start of the oldest record not yet overwritten
+    uint64_t consumed_ = 0;         // reader only
+
+    std::mutex large_mutex_;
+    std::deque<std::vector<char>> large_;
+    size_t max_large_;
+};
+
 class SPDLOG_API backtracer
 {
-    mutable std::mutex mutex_;
+    mutable std::mutex mutex_; // serializes the readers
     std::atomic<bool> enabled_{false};
-    circular_q<log_msg_buffer> messages_;
+    std::atomic<size_t> messages_{0};
+    std::unique_ptr<per_thread<backtrace_ring>> rings_;
+    std::vector<char> copied_; // records copied from another backtracer, replayed by the next pop
 
 public:
-    backtracer() = default;
+    backtracer();
     backtracer(const backtracer &other);
 
     backtracer(backtracer &&other) SPDLOG_NOEXCEPT;
@@ -33,8 +83,11 @@ public:
     bool enabled() const;
     void push_back(const log_msg &msg);
 
-    // pop all items in the q and apply the given fun on each of them.
-    void foreach_pop(std::function<void(const details::log_msg &)> fun);
+    // pop all items in the q and apply the given fun on each of them (oldest first).
+    void foreach_pop(string_view_t logger_name, const std::function<void(const details::log_msg &)> &fun);
+
+private:
+    size_t ring_capacity_() const;
 };
 
 } // namespace details
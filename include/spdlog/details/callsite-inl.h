@@ -0,0 +1,285 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+#ifndef SPDLOG_HEADER_ONLY
+#    include <spdlog/details/callsite.h>
+#endif
+
+#include <spdlog/details/os.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+namespace spdlog {
+namespace details {
+
+SPDLOG_INLINE callsite::callsite(const char *filename, int line, const char *funcname)
+    : loc{filename, line, funcname}
+    , short_filename{filename}
+{
+    loc.site = this;
+    if (filename != nullptr)
+    {
+        for (const char *p = filename; *p != '\0'; ++p)
+        {
+            if (std::strchr(os::folder_seps, *p) != nullptr)
+            {
+                short_filename = p + 1;
+            }
+        }
+    }
+    id_ = callsite_registry::instance().register_site(this);
+}
+
+SPDLOG_INLINE level::level_enum callsite::level() const
+{
+    return described() ? level_ : level::off;
+}
+
+SPDLOG_INLINE string_view_t callsite::fmt() const
+{
+    return described() ? string_view_t{fmt_} : string_view_t{};
+}
+
+SPDLOG_INLINE const std::vector<std::string> &callsite::field_names() const
+{
+    static const std::vector<std::string> empty;
+    return described() ? field_names_ : empty;
+}
+
+SPDLOG_INLINE void callsite::describe(level::level_enum lvl, string_view_t fmt, const Field *fields, size_t field_count)
+{
+    // only the first caller fills the description, the others keep logging without waiting for it.
+    int expected = 0;
+    if (!state_.compare_exchange_strong(expected, 1, std::memory_order_relaxed))
+    {
+        return;
+    }
+    level_ = lvl;
+    fmt_.assign(fmt.data(), fmt.size());
+    field_names_.reserve(field_count);
+    for (size_t i = 0; i < field_count; i++)
+    {
+        field_names_.emplace_back(fields[i].name.data(), fields[i].name.size());
+    }
+    state_.store(described_state, std::memory_order_release);
+}
+
+SPDLOG_INLINE bool glob_match(const char *pattern, const char *text)
+{
+    const char *star = nullptr;
+    const char *star_text = nullptr;
+    while (*text != '\0')
+    {
+        if (*pattern == '*')
+        {
+            star = pattern++;
+            star_text = text;
+        }
+        else if (*pattern == '?' || *pattern == *text)
+        {
+            pattern++;
+            text++;
+        }
+        else if (star != nullptr)
+        {
+            pattern = star + 1;
+            text = ++star_text;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    while (*pattern == '*')
+    {
+        pattern++;
+    }
+    return *pattern == '\0';
+}
+
+// "file-glob:line" selectors: return true and the line (-1 if out of range), the colon at colon
+SPDLOG_INLINE bool selector_line(const std::string &selector, size_t &colon, int &line)
+{
+    colon = selector.find_last_of(':');
+    if (colon == std::string::npos || colon + 1 == selector.size() ||
+        selector.find_first_not_of("0123456789", colon + 1) != std::string::npos)
+    {
+        return false;
+    }
+    errno = 0;
+    auto value = std::strtoul(selector.c_str() + colon + 1, nullptr, 10);
+    line = errno == ERANGE || value > static_cast<unsigned long>(std::numeric_limits<int>::max()) ? -1 : static_cast<int>(value);
+    return true;
+}
+
+SPDLOG_INLINE bool callsite::valid_selector(const std::string &selector)
+{
+    size_t colon;
+    int line;
+    return !selector.empty() && !(selector_line(selector, colon, line) && line < 0);
+}
+
+SPDLOG_INLINE bool callsite::matches(const std::string &selector) const
+{
+    if (selector.size() > 2 && selector.compare(selector.size() - 2, 2, "()") == 0)
+    {
+        auto func_glob = selector.substr(0, selector.size() - 2);
+        return loc.funcname != nullptr && glob_match(func_glob.c_str(), loc.funcname);
+    }
+
+    auto file_glob = selector;
+    size_t colon;
+    int line;
+    if (selector_line(selector, colon, line))
+    {
+        if (line != loc.line)
+        {
+            return false;
+        }
+        file_glob = selector.substr(0, colon);
+    }
+    return loc.filename != nullptr && (glob_match(file_glob.c_str(), loc.filename) || glob_match(file_glob.c_str(), short_filename));
+}
+
+SPDLOG_INLINE callsite_registry &callsite_registry::instance()
+{
+    static callsite_registry s_instance;
+    return s_instance;
+}
+
+SPDLOG_INLINE size_t callsite_registry::register_site(callsite *site)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto id = sites_.size();
+    for (auto &rule : mode_rules_)
+    {
+        if (site->matches(rule.first))
+        {
+            site->set_mode(rule.second);
+        }
+    }
+    for (auto &rule : sampling_rules_)
+    {
+        if (site->matches(rule.first))
+        {
+            apply_sampling_(*site, id, rule.second);
+        }
+    }
+    sites_.push_back(site);
+    return id;
+}
+
+SPDLOG_INLINE size_t callsite_registry::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return sites_.size();
+}
+
+SPDLOG_INLINE callsite *callsite_registry::get(size_t id) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return id < sites_.size() ? sites_[id] : nullptr;
+}
+
+SPDLOG_INLINE void callsite_registry::for_each(const std::function<void(callsite &)> &fun) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto *site : sites_)
+    {
+        fun(*site);
+    }
+}
+
+SPDLOG_INLINE void callsite_registry::set_mode(const std::string &selector, callsite_mode mode)
+{
+    if (!callsite::valid_selector(selector))
+    {
+        throw_spdlog_ex("invalid call site selector: " + selector);
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    mode_rules_.erase(std::remove_if(mode_rules_.begin(), mode_rules_.end(),
+                          [&selector](const std::pair<std::string, callsite_mode> &rule) { return rule.first == selector; }),
+        mode_rules_.end());
+    mode_rules_.emplace_back(selector, mode);
+    for (auto *site : sites_)
+    {
+        if (site->matches(selector))
+        {
+            site->set_mode(mode);
+        }
+    }
+}
+
+SPDLOG_INLINE size_t callsite_registry::mode_rules() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return mode_rules_.size();
+}
+
+SPDLOG_INLINE void callsite_registry::reset_modes()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    mode_rules_.clear();
+    for (auto *site : sites_)
+    {
+        site->set_mode(callsite_mode::by_level);
+    }
+}
+
+SPDLOG_INLINE void callsite_registry::set_sampling(const std::string &selector, sampling_policy policy)
+{
+    sampler validate{policy}; // throws on invalid policy before the rule is stored
+    (void)validate;
+    if (!callsite::valid_selector(selector))
+    {
+        throw_spdlog_ex("invalid call site selector: " + selector);
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    // the new rule replaces the one with the same selector. a kind::none rule only matters to the
+    // sites of an earlier rule.
+    sampling_rules_.erase(std::remove_if(sampling_rules_.begin(), sampling_rules_.end(),
+                              [&selector](const std::pair<std::string, sampling_policy> &rule) { return rule.first == selector; }),
+        sampling_rules_.end());
+    if (policy.type != sampling_policy::kind::none || !sampling_rules_.empty())
+    {
+        sampling_rules_.emplace_back(selector, policy);
+    }
+    for (size_t id = 0; id < sites_.size(); id++)
+    {
+        if (sites_[id]->matches(selector))
+        {
+            apply_sampling_(*sites_[id], id, policy);
+        }
+    }
+}
+
+SPDLOG_INLINE void callsite_registry::apply_sampling_(callsite &site, size_t id, const sampling_policy &policy)
+{
+    if (policy.type == sampling_policy::kind::none)
+    {
+        site.set_site_sampler(nullptr);
+        return;
+    }
+    if (id >= samplers_.size())
+    {
+        samplers_.resize(id + 1);
+    }
+    if (samplers_[id])
+    {
+        samplers_[id]->reset(policy);
+    }
+    else
+    {
+        samplers_[id] = details::make_unique<sampler>(policy);
+    }
+    site.set_site_sampler(samplers_[id].get());
+}
+
+} // namespace details
+} // namespace spdlog
@@ -0,0 +1,157 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+#include <spdlog/common.h>
+#include <spdlog/details/sampler.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Static per call site descriptors.
+// Every SPDLOG_LOGGER_CALL expansion owns one function-local callsite object.
+// It registers itself in the global callsite_registry the first time it executes
+// and gets a stable numeric id (its index in the registry) for the lifetime of the process.
+// The log_msg reaches it through msg.source.site.
+
+namespace spdlog {
+
+// Runtime switch of a single call site (see spdlog::set_callsite_mode()).
+enum class callsite_mode : int
+{
+    by_level = 0, // logged according to the logger level
+    on,           // always logged, regardless of the logger level
+    off           // never logged
+};
+
+namespace details {
+
+class SPDLOG_API callsite
+{
+public:
+    callsite(const char *filename, int line, const char *funcname);
+    callsite(const callsite &) = delete;
+    callsite &operator=(const callsite &) = delete;
+
+    // source location of this site (loc.site points back to this object)
+    source_loc loc;
+
+    // file name without the directory part, computed once
+    const char *short_filename;
+
+    // index in the callsite_registry
+    size_t id() const
+    {
+        return id_;
+    }
+
+    // level, format string and field names are captured on the first logged message
+    bool described() const
+    {
+        return state_.load(std::memory_order_acquire) == described_state;
+    }
+    level::level_enum level() const;
+    string_view_t fmt() const;
+    const std::vector<std::string> &field_names() const;
+
+    void describe(level::level_enum lvl, string_view_t fmt, const Field *fields, size_t field_count);
+
+    callsite_mode mode() const
+    {
+        return static_cast<callsite_mode>(mode_.load(std::memory_order_relaxed));
+    }
+
+    void set_mode(callsite_mode mode)
+    {
+        mode_.store(static_cast<int>(mode), std::memory_order_relaxed);
+    }
+
+    // sampling policy state of this site or nullptr
+    sampler *site_sampler() const
+    {
+        return sampler_.load(std::memory_order_relaxed);
+    }
+
+    void set_site_sampler(sampler *s)
+    {
+        sampler_.store(s, std::memory_order_relaxed);
+    }
+
+    // selector syntax:
+    //   "file-glob"         all sites in matching files (full path or file name)
+    //   "file-glob:line"    the site at the given line
+    //   "function-glob()"   all sites in matching functions
+    // globs support '*' and '?'.
+    bool matches(const std::string &selector) const;
+    // false for empty selectors and line numbers out of range
+    static bool valid_selector(const std::string &selector);
+
+private:
+    static const int described_state = 2;
+
+    size_t id_;
+    std::atomic<int> mode_{0};
+    std::atomic<sampler *> sampler_{nullptr};
+    std::atomic<int> state_{0};
+    level::level_enum level_{level::off};
+    std::string fmt_;
+    std::vector<std::string> field_names_;
+};
+
+// glob match supporting '*' and '?'
+SPDLOG_API bool glob_match(const char *pattern, const char *text);
+
+class SPDLOG_API callsite_registry
+{
+public:
+    static callsite_registry &instance();
+
+    size_t register_site(callsite *site);
+
+    // number of registered sites
+    size_t size() const;
+
+    // return the site with the given id or nullptr
+    callsite *get(size_t id) const;
+
+    void for_each(const std::function<void(callsite &)> &fun) const;
+
+    // set the mode of all matching sites, including the ones that will register later.
+    // later calls take precedence over earlier ones. the new rule replaces the one with the same selector.
+    void set_mode(const std::string &selector, callsite_mode mode);
+
+    // number of mode rules stored
+    size_t mode_rules() const;
+
+    // forget all rules and return every site to callsite_mode::by_level
+    void reset_modes();
+
+    // give every matching site (including the ones that will register later) its own sampler.
+    // sampling_policy::kind::none removes the sampling of the matching sites.
+    void set_sampling(const std::string &selector, sampling_policy policy);
+
+private:
+    callsite_registry() = default;
+
+    mutable std::mutex mutex_;
+    std::vector<callsite *> sites_;
+    std::vector<std::pair<std::string, callsite_mode>> mode_rules_;
+    std::vector<std::pair<std::string, sampling_policy>> sampling_rules_;
+    // the sampler of each site (by id), allocated by the first policy it gets and reset by the later
+    // ones: logging threads may still hold it.
+    std::vector<std::unique_ptr<sampler>> samplers_;
+
+    void apply_sampling_(callsite &site, size_t id, const sampling_policy &policy);
+};
+
+} // namespace details
+} // namespace spdlog
+
+#ifdef SPDLOG_HEADER_ONLY
+#    include "callsite-inl.h"
+#endif
@@ -55,5 +55,79 @@ SPDLOG_INLINE log_msg::log_msg(string_view_t a_logger_name, spdlog::level::level
     : log_msg(os::now(), source_loc{}, a_logger_name, lvl, msg, nullptr, 0)
 {}
 
+SPDLOG_INLINE log_msg::log_msg(const log_msg &other)
+    : logger_name(other.logger_name)
+    , level(other.level)
+    , time(other.time)
+    , thread_id(other.thread_id)
+    , color_range_start(other.color_range_start)
+    , color_range_end(other.color_range_end)
+    , source(other.source)
+    , payload(other.payload)
+#ifndef SPDLOG_NO_STRUCTURED_SPDLOG
+    , field_data(other.field_data)
+    , field_data_count(other.field_data_count)
+    , context_field_data(other.context_field_data)
+#endif
+{}
+
+SPDLOG_INLINE log_msg &log_msg::operator=(const log_msg &other)
+{
+    logger_name = other.logger_name;
+    level = other.level;
+    time = other.time;
+    thread_id = other.thread_id;
+    color_range_start = other.color_range_start;
+    color_range_end = other.color_range_end;
+    source = other.source;
+    payload = other.payload;
+    shared_output = nullptr;
+    derived = nullptr;
+#ifndef SPDLOG_NO_STRUCTURED_SPDLOG
+    field_data = other.field_data;
+    field_data_count = other.field_data_count;
+    context_field_data = other.context_field_data;
+#endif
+    return *this;
+}
+
+#if !defined(_MSC_VER) || _MSC_VER > 1800
+SPDLOG_INLINE log_msg::log_msg(log_msg &&other) SPDLOG_NOEXCEPT
+    : logger_name(other.logger_name)
+    , level(other.level)
+    , time(other.time)
+    , thread_id(other.thread_id)
+    , color_range_start(other.color_range_start)
+    , color_range_end(other.color_range_end)
+    , source(other.source)
+    , payload(other.payload)
+#ifndef SPDLOG_NO_STRUCTURED_SPDLOG
+    , field_data(other.field_data)
+    , field_data_count(other.field_data_count)
+    , context_field_data(std::move(other.context_field_data))
+#endif
+{}
+
+SPDLOG_INLINE log_msg &log_msg::operator=(log_msg &&other) SPDLOG_NOEXCEPT
+{
+    logger_name = other.logger_name;
+    level = other.level;
+    time = other.time;
+    thread_id = other.thread_id;
+    color_range_start = other.color_range_start;
+    color_range_end = other.color_range_end;
+    source = other.source;
+    payload = other.payload;
+    shared_output = nullptr;
+    derived = nullptr;
+#ifndef SPDLOG_NO_STRUCTURED_SPDLOG
+    field_data = other.field_data;
+    field_data_count = other.field_data_count;
+    context_field_data = std::move(other.context_field_data);
+#endif
+    return *this;
+}
+#endif
+
 } // namespace details
 } // namespace spdlog
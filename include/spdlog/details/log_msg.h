@@ -9,6 +9,8 @@
 namespace spdlog {
 namespace details {
 class context_data;
+class output_cache;
+class msg_derived;
 struct SPDLOG_API log_msg
 {
     log_msg() = default;
@@ -17,8 +19,15 @@ struct SPDLOG_API log_msg
     log_msg(source_loc loc, string_view_t logger_name, level::level_enum lvl, string_view_t msg, const Field * fields, size_t field_count);
     log_msg(source_loc loc, string_view_t logger_name, level::level_enum lvl, string_view_t msg);
     log_msg(string_view_t logger_name, level::level_enum lvl, string_view_t msg);
-    log_msg(const log_msg &other) = default;
-    log_msg &operator=(const log_msg &other) = default;
+    // the copies don't get shared_output and derived: they belong to the sinking in progress, which a copy
+    // may outlive (kept by a sink, queued, ..)
+    log_msg(const log_msg &other);
+    log_msg &operator=(const log_msg &other);
+#if !defined(_MSC_VER) || _MSC_VER > 1800
+    // the refcounted member (context) is moved, not copied
+    log_msg(log_msg &&other) SPDLOG_NOEXCEPT;
+    log_msg &operator=(log_msg &&other) SPDLOG_NOEXCEPT;
+#endif
 
     string_view_t logger_name;
     level::level_enum level{level::off};
@@ -32,6 +41,11 @@ struct SPDLOG_API log_msg
     source_loc source;
     string_view_t payload;
 
+    // formatted output shared by the sinks of the logger (set by the logger while sinking, not copied).
+    mutable output_cache *shared_output{nullptr};
+    // lazily computed data shared by the formatters (set by the logger while sinking, not copied).
+    mutable msg_derived *derived{nullptr};
+
 #ifndef SPDLOG_NO_STRUCTURED_SPDLOG
     Field *field_data{nullptr};
     size_t field_data_count{0};
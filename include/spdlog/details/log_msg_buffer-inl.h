@@ -7,6 +7,8 @@
 #    include <spdlog/details/log_msg_buffer.h>
 #endif
 
+#include <algorithm>
+
 namespace spdlog {
 namespace details {
 
@@ -14,8 +16,7 @@ SPDLOG_INLINE log_msg_buffer::log_msg_buffer(const log_msg &orig_msg)
     : log_msg{orig_msg}
 {
 #ifndef SPDLOG_NO_STRUCTURED_SPDLOG
-    field_buffer = std::vector<Field>(field_data, field_data + field_data_count);
-    field_data = field_buffer.data();
+    store_fields(orig_msg.field_data, orig_msg.field_data_count);
 
     // Copy strings from fields
     for (size_t i=0; i < field_data_count; i++) {
@@ -34,46 +35,84 @@ SPDLOG_INLINE log_msg_buffer::log_msg_buffer(const log_msg_buffer &other)
     : log_msg{other}
 {
 #ifndef SPDLOG_NO_STRUCTURED_SPDLOG
-    field_buffer = std::vector<Field>(field_data, field_data + field_data_count);
-    field_data = field_buffer.data();
-
-    // Copy strings from fields
-    for (size_t i=0; i < field_data_count; i++) {
-        buffer.append(field_data[i].name);
-        if (field_data[i].value_type == FieldValueType::STRING_VIEW) {
-            buffer.append(field_data[i].string_view_.begin(), field_data[i].string_view_.end());
-        }
-    }
+    store_fields(other.field_data, other.field_data_count);
 #endif
-    buffer.append(logger_name.begin(), logger_name.end());
-    buffer.append(payload.begin(), payload.end());
+    buffer.append(other.buffer.data(), other.buffer.data() + other.buffer.size());
     update_string_views();
 }
 
-SPDLOG_INLINE log_msg_buffer::log_msg_buffer(log_msg_buffer &&other) SPDLOG_NOEXCEPT : log_msg{other}, buffer{std::move(other.buffer)}, field_buffer{std::move(other.field_buffer)}
+SPDLOG_INLINE log_msg_buffer::log_msg_buffer(log_msg_buffer &&other) SPDLOG_NOEXCEPT : log_msg{other}, buffer{std::move(other.buffer)}
 {
+#ifndef SPDLOG_NO_STRUCTURED_SPDLOG
+    if (other.field_data == other.field_buffer.data() && !other.field_buffer.empty())
+    {
+        field_buffer = std::move(other.field_buffer);
+        field_data = field_buffer.data();
+    }
+    else
+    {
+        store_fields(other.field_data, other.field_data_count);
+    }
+#endif
     update_string_views();
 }
 
 SPDLOG_INLINE log_msg_buffer &log_msg_buffer::operator=(const log_msg_buffer &other)
 {
+    if (this == &other)
+    {
+        return *this;
+    }
     log_msg::operator=(other);
+#ifndef SPDLOG_NO_STRUCTURED_SPDLOG
+    store_fields(other.field_data, other.field_data_count);
+#endif
     buffer.clear();
     buffer.append(other.buffer.data(), other.buffer.data() + other.buffer.size());
-    field_buffer = other.field_buffer;
     update_string_views();
     return *this;
 }
 
 SPDLOG_INLINE log_msg_buffer &log_msg_buffer::operator=(log_msg_buffer &&other) SPDLOG_NOEXCEPT
 {
+    if (this == &other)
+    {
+        return *this;
+    }
     log_msg::operator=(other);
+#ifndef SPDLOG_NO_STRUCTURED_SPDLOG
+    if (other.field_data == other.field_buffer.data() && !other.field_buffer.empty())
+    {
+        field_buffer = std::move(other.field_buffer);
+        field_data = field_buffer.data();
+    }
+    else
+    {
+        store_fields(other.field_data, other.field_data_count);
+    }
+#endif
     buffer = std::move(other.buffer);
-    field_buffer = std::move(other.field_buffer);
     update_string_views();
     return *this;
 }
 
+#ifndef SPDLOG_NO_STRUCTURED_SPDLOG
+SPDLOG_INLINE void log_msg_buffer::store_fields(const Field *fields, size_t count)
+{
+    if (count <= inline_fields)
+    {
+        std::copy(fields, fields + count, inline_field_buffer);
+        field_buffer.clear();
+        field_data = inline_field_buffer;
+    }
+    else
+    {
+        field_buffer.assign(fields, fields + count);
+        field_data = field_buffer.data();
+    }
+}
+#endif
+
 SPDLOG_INLINE void log_msg_buffer::update_string_views()
 {
     size_t offset = 0;
@@ -7,16 +7,39 @@
 
 #include <vector>
 
+// room kept inside each log_msg_buffer before it allocates (see tweakme.h)
+#ifndef SPDLOG_MSG_BUFFER_INLINE_BYTES
+#    define SPDLOG_MSG_BUFFER_INLINE_BYTES 250
+#endif
+
+#ifndef SPDLOG_MSG_BUFFER_INLINE_FIELDS
+#    define SPDLOG_MSG_BUFFER_INLINE_FIELDS 3
+#endif
+
 namespace spdlog {
 namespace details {
 
 // Extend log_msg with internal buffer to store its payload.
 // This is needed since log_msg holds string_views that points to stack data.
+// The strings and the first fields are stored inline, so small messages are buffered without
+// allocating.
 
 class SPDLOG_API log_msg_buffer : public log_msg
 {
-    memory_buf_t buffer;
-    std::vector<Field> field_buffer;
+#ifdef SPDLOG_USE_STD_FORMAT
+    using buffer_t = std::string;
+#else
+    using buffer_t = fmt::basic_memory_buffer<char, SPDLOG_MSG_BUFFER_INLINE_BYTES>;
+#endif
+    buffer_t buffer;
+#ifndef SPDLOG_NO_STRUCTURED_SPDLOG
+    static const size_t inline_fields = SPDLOG_MSG_BUFFER_INLINE_FIELDS > 0 ? SPDLOG_MSG_BUFFER_INLINE_FIELDS : 1;
+    Field inline_field_buffer[inline_fields];
+    std::vector<Field> field_buffer; // used when the fields don't fit inline
+
+    // copy the fields into our storage and point field_data to them
+    void store_fields(const Field *fields, size_t count);
+#endif
 
     void update_string_views();
 
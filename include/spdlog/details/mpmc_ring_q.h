@@ -0,0 +1,239 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+// lock free multi producer-multi consumer bounded queue (Dmitry Vyukov's design:
+// every slot carries a sequence number telling whether it is ready to be written or read).
+// Same interface as mpmc_blocking_queue:
+// enqueue(..) - will block until room found to put the new message.
+// enqueue_nowait(..) - will overrun the oldest message if no room left in the queue.
+// enqueue_or_overrun(..) - like enqueue_nowait(..) but hands the overrun message to the caller.
+// try_enqueue(..) - will drop the new message (return false) if no room left in the queue.
+// dequeue_for(..) - will block until the queue is not empty or timeout have
+// passed.
+// try_dequeue(..) - will return false right away if the queue is empty.
+// The capacity is rounded up to a power of two (at least 2).
+// Blocked threads sleep in a waiter, which producers/consumers notify only when someone is parked.
+
+#include <spdlog/details/waiter.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+namespace spdlog {
+namespace details {
+
+template<typename T>
+class mpmc_ring_queue
+{
+public:
+    using item_type = T;
+    explicit mpmc_ring_queue(size_t max_items)
+        : capacity_{round_up_(max_items)}
+        , mask_{capacity_ - 1}
+        , cells_{new cell[capacity_]}
+    {
+        for (size_t i = 0; i < capacity_; i++)
+        {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    mpmc_ring_queue(const mpmc_ring_queue &) = delete;
+    mpmc_ring_queue &operator=(const mpmc_ring_queue &) = delete;
+
+    // try to enqueue and block if no room left
+    void enqueue(T &&item)
+    {
+        if (!try_enqueue_(item))
+        {
+            not_full_.wait([this, &item] { return this->try_enqueue_(item); });
+        }
+        not_empty_.notify_one();
+    }
+
+    // enqueue immediately. overrun oldest message in the queue if no room left.
+    void enqueue_nowait(T &&item)
+    {
+        while (!try_enqueue_(item))
+        {
+            T oldest;
+            if (try_dequeue_(oldest))
+            {
+                overrun_counter_.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        not_empty_.notify_one();
+    }
+
+    // enqueue immediately. if no room left, move the oldest message out to oldest instead and return false
+    // (the item is left alone): the caller deals with it and tries again. not counted as an overrun.
+    bool enqueue_or_overrun(T &&item, T &oldest)
+    {
+        while (!try_enqueue_(item))
+        {
+            if (try_dequeue_(oldest))
+            {
+                return false;
+            }
+        }
+        not_empty_.notify_one();
+        return true;
+    }
+
+    // enqueue immediately, without ever waiting. return false (and drop the item) if no room left.
+    bool try_enqueue(T &&item)
+    {
+        if (!try_enqueue_(item))
+        {
+            return false;
+        }
+        not_empty_.notify_one();
+        return true;
+    }
+
+    // try to dequeue item. if no item found. wait up to timeout and try again
+    // Return true, if succeeded dequeue item, false otherwise
+    bool dequeue_for(T &popped_item, std::chrono::milliseconds wait_duration)
+    {
+        if (!try_dequeue_(popped_item) &&
+            !not_empty_.wait_for([this, &popped_item] { return this->try_dequeue_(popped_item); }, wait_duration))
+        {
+            return false;
+        }
+        not_full_.notify_one();
+        return true;
+    }
+
+    // dequeue without waiting. return false if the queue is empty.
+    bool try_dequeue(T &popped_item)
+    {
+        if (!try_dequeue_(popped_item))
+        {
+            return false;
+        }
+        not_full_.notify_one();
+        return true;
+    }
+
+    size_t overrun_counter()
+    {
+        return overrun_counter_.load(std::memory_order_relaxed);
+    }
+
+    size_t size()
+    {
+        auto dequeue_pos = dequeue_pos_.load(std::memory_order_acquire);
+        auto enqueue_pos = enqueue_pos_.load(std::memory_order_acquire);
+        return enqueue_pos > dequeue_pos ? enqueue_pos - dequeue_pos : 0;
+    }
+
+    // same as size() with relaxed reads: may be a little off while items move
+    size_t approx_size() const
+    {
+        auto dequeue_pos = dequeue_pos_.load(std::memory_order_relaxed);
+        auto enqueue_pos = enqueue_pos_.load(std::memory_order_relaxed);
+        return enqueue_pos > dequeue_pos ? enqueue_pos - dequeue_pos : 0;
+    }
+
+    size_t capacity() const
+    {
+        return capacity_;
+    }
+
+private:
+    static constexpr size_t cache_line = 64;
+
+    struct cell
+    {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    static size_t round_up_(size_t n)
+    {
+        size_t rounded = 2;
+        while (rounded < n)
+        {
+            rounded <<= 1;
+        }
+        return rounded;
+    }
+
+    bool try_enqueue_(T &item)
+    {
+        auto pos = enqueue_pos_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            auto &c = cells_[pos & mask_];
+            auto seq = c.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0)
+            {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    c.data = std::move(item);
+                    c.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false; // full
+            }
+            else
+            {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool try_dequeue_(T &item)
+    {
+        auto pos = dequeue_pos_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            auto &c = cells_[pos & mask_];
+            auto seq = c.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+            if (diff == 0)
+            {
+                if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    item = std::move(c.data);
+                    c.sequence.store(pos + capacity_, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false; // empty
+            }
+            else
+            {
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    const size_t capacity_;
+    const size_t mask_;
+    std::unique_ptr<cell[]> cells_;
+
+    // keep the producer and consumer positions on their own cache lines
+    char pad0_[cache_line];
+    std::atomic<size_t> enqueue_pos_{0};
+    char pad1_[cache_line - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> dequeue_pos_{0};
+    char pad2_[cache_line - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> overrun_counter_{0};
+
+    waiter not_empty_;
+    waiter not_full_;
+};
+} // namespace details
+} // namespace spdlog
@@ -0,0 +1,169 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+#ifndef SPDLOG_HEADER_ONLY
+#    include <spdlog/details/mpsc_byte_ring.h>
+#endif
+
+#include <cstring>
+
+namespace spdlog {
+namespace details {
+
+inline size_t byte_ring_capacity(size_t capacity)
+{
+    size_t rounded = 1024;
+    while (rounded < capacity)
+    {
+        rounded <<= 1;
+    }
+    return rounded;
+}
+
+SPDLOG_INLINE mpsc_byte_ring::mpsc_byte_ring(size_t capacity)
+    : capacity_{byte_ring_capacity(capacity)}
+    , mask_{capacity_ - 1}
+    , storage_{new uint64_t[capacity_ / sizeof(uint64_t)]()}
+    , buffer_{reinterpret_cast<char *>(storage_.get())}
+{
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "record headers are read in place");
+    if (capacity_ > (size_t{1} << 31))
+    {
+        throw_spdlog_ex("mpsc_byte_ring: capacity must not exceed 2GB");
+    }
+}
+
+SPDLOG_INLINE std::atomic<uint32_t> &mpsc_byte_ring::header_(size_t pos)
+{
+    return *reinterpret_cast<std::atomic<uint32_t> *>(buffer_ + (pos & mask_));
+}
+
+SPDLOG_INLINE char *mpsc_byte_ring::try_reserve(size_t size)
+{
+    if (size > max_record_size())
+    {
+        return nullptr;
+    }
+    auto record_size = (size + header_size + 7) & ~size_t{7};
+    auto pos = write_pos_.load(std::memory_order_relaxed);
+    size_t needed;
+    for (;;)
+    {
+        auto offset = pos & mask_;
+        // a record never wraps: skip the end of the ring if it does not fit there
+        needed = offset + record_size > capacity_ ? capacity_ - offset + record_size : record_size;
+        if (pos + needed - release_pos_.load(std::memory_order_acquire) > capacity_)
+        {
+            // pos may be stale (and even behind the released position)
+            auto current = write_pos_.load(std::memory_order_relaxed);
+            if (current != pos)
+            {
+                pos = current;
+                continue;
+            }
+            return nullptr; // full
+        }
+        if (write_pos_.compare_exchange_weak(pos, pos + needed, std::memory_order_relaxed))
+        {
+            break;
+        }
+    }
+
+    if (needed != record_size)
+    {
+        header_(pos).store(static_cast<uint32_t>(needed - record_size) | padding_flag, std::memory_order_release);
+        pos += needed - record_size;
+    }
+    // the size is kept in the second word until commit() publishes it in the first
+    auto *record = buffer_ + (pos & mask_);
+    auto size32 = static_cast<uint32_t>(record_size);
+    std::memcpy(record + sizeof(uint32_t), &size32, sizeof(size32));
+    return record + header_size;
+}
+
+SPDLOG_INLINE char *mpsc_byte_ring::reserve(size_t size)
+{
+    auto *record = try_reserve(size);
+    if (record == nullptr && size <= max_record_size())
+    {
+        not_full_.wait([this, size, &record] {
+            record = this->try_reserve(size);
+            return record != nullptr;
+        });
+    }
+    return record;
+}
+
+SPDLOG_INLINE void mpsc_byte_ring::commit(char *record)
+{
+    auto *header = record - header_size;
+    uint32_t record_size;
+    std::memcpy(&record_size, header + sizeof(uint32_t), sizeof(record_size));
+    reinterpret_cast<std::atomic<uint32_t> *>(header)->store(record_size, std::memory_order_release);
+    not_empty_.notify_one();
+}
+
+SPDLOG_INLINE char *mpsc_byte_ring::read()
+{
+    while (readable())
+    {
+        auto value = header_(read_pos_).load(std::memory_order_relaxed); // acquired by readable()
+        auto *record = buffer_ + (read_pos_ & mask_);
+        read_pos_ += value & ~padding_flag;
+        if ((value & padding_flag) == 0)
+        {
+            return record + header_size;
+        }
+    }
+    return nullptr;
+}
+
+SPDLOG_INLINE bool mpsc_byte_ring::readable()
+{
+    // a whole ring read but not released yet: read_pos_ wrapped onto the first unreleased record
+    if (read_pos_ - release_pos_.load(std::memory_order_relaxed) >= capacity_)
+    {
+        return false;
+    }
+    return header_(read_pos_).load(std::memory_order_acquire) != 0;
+}
+
+SPDLOG_INLINE bool mpsc_byte_ring::wait_for(std::chrono::milliseconds timeout)
+{
+    return readable() || not_empty_.wait_for([this] { return this->readable(); }, timeout);
+}
+
+SPDLOG_INLINE void mpsc_byte_ring::release()
+{
+    auto pos = release_pos_.load(std::memory_order_relaxed);
+    if (pos == read_pos_)
+    {
+        return;
+    }
+    // zero the released bytes so stale sizes are never taken for committed records
+    auto offset = pos & mask_;
+    auto n = read_pos_ - pos;
+    if (offset + n > capacity_)
+    {
+        std::memset(buffer_ + offset, 0, capacity_ - offset);
+        std::memset(buffer_, 0, offset + n - capacity_);
+    }
+    else
+    {
+        std::memset(buffer_ + offset, 0, n);
+    }
+    release_pos_.store(read_pos_, std::memory_order_release);
+    not_full_.notify_all();
+}
+
+SPDLOG_INLINE size_t mpsc_byte_ring::size() const
+{
+    auto release_pos = release_pos_.load(std::memory_order_acquire);
+    auto write_pos = write_pos_.load(std::memory_order_acquire);
+    return write_pos > release_pos ? write_pos - release_pos : 0;
+}
+
+} // namespace details
+} // namespace spdlog
@@ -0,0 +1,98 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+// multi producer-single consumer ring of variable length records, stored in place.
+// A producer reserves room for its record with a single compare and swap, writes the record
+// right into the ring and commits it. The consumer reads the committed records where they are
+// and releases them in order; released bytes are zeroed, so the first word of a record is
+// non zero only once it is committed.
+// Records are 8 bytes aligned and never wrap: a record that does not fit before the end of the
+// ring is preceded by a padding record. A record takes at most max_record_size() bytes.
+// A full ring cannot be overrun by the producers (only the consumer may release records).
+
+#include <spdlog/common.h>
+#include <spdlog/details/waiter.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+namespace spdlog {
+namespace details {
+
+class SPDLOG_API mpsc_byte_ring
+{
+public:
+    // capacity in bytes, rounded up to a power of two (at least 1024)
+    explicit mpsc_byte_ring(size_t capacity);
+    mpsc_byte_ring(const mpsc_byte_ring &) = delete;
+    mpsc_byte_ring &operator=(const mpsc_byte_ring &) = delete;
+
+    // producer: room for a record of size bytes (8 bytes aligned), or nullptr if no room left
+    char *try_reserve(size_t size);
+
+    // producer: room for a record of size bytes. block until room found.
+    char *reserve(size_t size);
+
+    // producer: publish a record returned by try_reserve() / reserve()
+    void commit(char *record);
+
+    // consumer: next committed record after the ones already read, or nullptr.
+    // the record stays valid until release().
+    char *read();
+
+    // consumer: is there a record to read (without waiting)
+    bool readable();
+
+    // consumer: wait up to timeout for a record to read. return false on timeout.
+    bool wait_for(std::chrono::milliseconds timeout);
+
+    // consumer: give back the room of all the records read so far
+    void release();
+
+    size_t capacity() const
+    {
+        return capacity_;
+    }
+
+    // largest record that fits in the ring
+    size_t max_record_size() const
+    {
+        return capacity_ / 2 - header_size;
+    }
+
+    // bytes used by the records not released yet
+    size_t size() const;
+
+private:
+    static const size_t header_size = 8;
+    static const uint32_t padding_flag = 0x80000000u;
+
+    std::atomic<uint32_t> &header_(size_t pos);
+
+    const size_t capacity_;
+    const size_t mask_;
+    std::unique_ptr<uint64_t[]> storage_;
+    char *buffer_;
+
+    static constexpr size_t cache_line = 64;
+    char pad0_[cache_line];
+    std::atomic<size_t> write_pos_{0};
+    char pad1_[cache_line - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> release_pos_{0};
+    size_t read_pos_ = 0; // consumer only: end of the records read so far
+    char pad2_[cache_line - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+
+    waiter not_empty_;
+    waiter not_full_;
+};
+
+} // namespace details
+} // namespace spdlog
+
+#ifdef SPDLOG_HEADER_ONLY
+#    include "mpsc_byte_ring-inl.h"
+#endif
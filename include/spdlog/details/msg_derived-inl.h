@@ -0,0 +1,199 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+#ifndef SPDLOG_HEADER_ONLY
+#    include <spdlog/details/msg_derived.h>
+#endif
+
+#include <spdlog/details/callsite.h>
+#include <spdlog/details/fmt_helper.h>
+#include <spdlog/details/os.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+namespace spdlog {
+namespace details {
+
+SPDLOG_INLINE msg_derived::msg_derived(const log_msg &msg)
+{
+    attach_(msg);
+}
+
+SPDLOG_INLINE msg_derived::~msg_derived()
+{
+    detach_();
+}
+
+SPDLOG_INLINE void msg_derived::attach_(const log_msg &msg)
+{
+    msg_ = &msg;
+    computed_ = 0;
+    attached_ = msg.derived == nullptr;
+    if (attached_)
+    {
+        msg.derived = this;
+    }
+}
+
+SPDLOG_INLINE void msg_derived::detach_()
+{
+    if (attached_)
+    {
+        msg_->derived = nullptr;
+        attached_ = false;
+    }
+}
+
+SPDLOG_INLINE const std::tm &msg_derived::tm(pattern_time_type time_type)
+{
+    if (time_type == pattern_time_type::local)
+    {
+        if ((computed_ & has_local_tm) == 0)
+        {
+            local_tm_ = os::localtime(log_clock::to_time_t(msg_->time));
+            computed_ |= has_local_tm;
+        }
+        return local_tm_;
+    }
+    if ((computed_ & has_utc_tm) == 0)
+    {
+        utc_tm_ = os::gmtime(log_clock::to_time_t(msg_->time));
+        computed_ |= has_utc_tm;
+    }
+    return utc_tm_;
+}
+
+SPDLOG_INLINE int msg_derived::utc_offset_minutes(pattern_time_type time_type)
+{
+    auto flag = time_type == pattern_time_type::local ? has_local_offset : has_utc_offset;
+    auto &offset = time_type == pattern_time_type::local ? local_offset_ : utc_offset_;
+    if ((computed_ & flag) == 0)
+    {
+        offset = os::utc_minutes_offset(tm(time_type));
+        computed_ |= flag;
+    }
+    return offset;
+}
+
+SPDLOG_INLINE string_view_t msg_derived::date_prefix(pattern_time_type time_type)
+{
+    bool local = time_type == pattern_time_type::local;
+    auto flag = local ? has_local_prefix : has_utc_prefix;
+    char *prefix = local ? local_prefix_ : utc_prefix_;
+    auto &prefix_size = local ? local_prefix_size_ : utc_prefix_size_;
+    if ((computed_ & flag) == 0)
+    {
+        const auto &tm_time = tm(time_type);
+        memory_buf_t buf;
+        buf.push_back('[');
+        fmt_helper::append_int(tm_time.tm_year + 1900, buf);
+        buf.push_back('-');
+        fmt_helper::pad2(tm_time.tm_mon + 1, buf);
+        buf.push_back('-');
+        fmt_helper::pad2(tm_time.tm_mday, buf);
+        buf.push_back(' ');
+        fmt_helper::pad2(tm_time.tm_hour, buf);
+        buf.push_back(':');
+        fmt_helper::pad2(tm_time.tm_min, buf);
+        buf.push_back(':');
+        fmt_helper::pad2(tm_time.tm_sec, buf);
+        buf.push_back('.');
+        prefix_size = std::min(buf.size(), sizeof(local_prefix_));
+        std::memcpy(prefix, buf.data(), prefix_size);
+        computed_ |= flag;
+    }
+    return string_view_t{prefix, prefix_size};
+}
+
+SPDLOG_INLINE const char *msg_derived::short_filename()
+{
+    if ((computed_ & has_short_filename) == 0)
+    {
+        if (msg_->source.site != nullptr)
+        {
+            short_filename_ = msg_->source.site->short_filename;
+        }
+        else if (msg_->source.filename != nullptr)
+        {
+            short_filename_ = basename(msg_->source.filename);
+        }
+        computed_ |= has_short_filename;
+    }
+    return short_filename_;
+}
+
+#ifdef _MSC_VER
+#    pragma warning(push)
+#    pragma warning(disable : 4127) // consider using 'if constexpr' instead
+#endif                              // _MSC_VER
+SPDLOG_INLINE const char *msg_derived::basename(const char *filename)
+{
+    // if the size is 2 (1 character + null terminator) we can use the more efficient strrchr
+    // the branch will be elided by optimizations
+    if (sizeof(os::folder_seps) == 2)
+    {
+        const char *rv = std::strrchr(filename, os::folder_seps[0]);
+        return rv != nullptr ? rv + 1 : filename;
+    }
+    else
+    {
+        const std::reverse_iterator<const char *> begin(filename + std::strlen(filename));
+        const std::reverse_iterator<const char *> end(filename);
+
+        const auto it = std::find_first_of(begin, end, std::begin(os::folder_seps), std::end(os::folder_seps) - 1);
+        return it != end ? it.base() : filename;
+    }
+}
+#ifdef _MSC_VER
+#    pragma warning(pop)
+#endif // _MSC_VER
+
+SPDLOG_INLINE string_view_t msg_derived::thread_id()
+{
+    if ((computed_ & has_thread_id) == 0)
+    {
+        memory_buf_t buf;
+        fmt_helper::append_int(msg_->thread_id, buf);
+        thread_id_size_ = std::min(buf.size(), sizeof(thread_id_));
+        std::memcpy(thread_id_, buf.data(), thread_id_size_);
+        computed_ |= has_thread_id;
+    }
+    return string_view_t{thread_id_, thread_id_size_};
+}
+
+SPDLOG_INLINE msg_derived_batch_scope::msg_derived_batch_scope(const log_msg *msgs, size_t count)
+    : derived_(nullptr)
+    , count_(count)
+{
+    if (count_ == 0)
+    {
+        return;
+    }
+    thread_local std::unique_ptr<msg_derived[]> derived;
+    thread_local size_t capacity = 0;
+    if (capacity < count_)
+    {
+        derived.reset(new msg_derived[count_]);
+        capacity = count_;
+    }
+    derived_ = derived.get();
+    for (size_t i = 0; i < count_; i++)
+    {
+        derived_[i].attach_(msgs[i]);
+    }
+}
+
+SPDLOG_INLINE msg_derived_batch_scope::~msg_derived_batch_scope()
+{
+    for (size_t i = 0; i < count_; i++)
+    {
+        derived_[i].detach_();
+    }
+}
+
+} // namespace details
+} // namespace spdlog
@@ -0,0 +1,101 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+#include <spdlog/common.h>
+#include <spdlog/details/log_msg.h>
+
+#include <ctime>
+
+// Data derived from a log message (broken down time, utc offset, date prefix, short filename
+// and thread id text), computed on first use and shared by all the formatters and sinks
+// handling the message.
+// The logger creates one on its stack while passing a message to its sinks; it attaches itself
+// to the message (log_msg::derived) for its lifetime unless the message already has one.
+// Formatters keep their own per second caches and use it to refresh them.
+
+namespace spdlog {
+namespace details {
+
+class SPDLOG_API msg_derived
+{
+public:
+    explicit msg_derived(const log_msg &msg);
+    ~msg_derived();
+    msg_derived(const msg_derived &) = delete;
+    msg_derived &operator=(const msg_derived &) = delete;
+
+    const std::tm &tm(pattern_time_type time_type);
+
+    // offset from utc of the message time, in minutes
+    int utc_offset_minutes(pattern_time_type time_type);
+
+    // "[YYYY-MM-DD HH:MM:SS." as printed by the default pattern
+    string_view_t date_prefix(pattern_time_type time_type);
+
+    // file name of the source location without its folders ("" if no source location)
+    const char *short_filename();
+
+    string_view_t thread_id();
+
+    // file name without its folders
+    static const char *basename(const char *filename);
+
+private:
+    friend class msg_derived_batch_scope;
+
+    // not attached to a message yet (msg_derived_batch_scope)
+    msg_derived() = default;
+    void attach_(const log_msg &msg);
+    void detach_();
+
+    enum : unsigned
+    {
+        has_local_tm = 1u << 0,
+        has_utc_tm = 1u << 1,
+        has_local_offset = 1u << 2,
+        has_utc_offset = 1u << 3,
+        has_local_prefix = 1u << 4,
+        has_utc_prefix = 1u << 5,
+        has_short_filename = 1u << 6,
+        has_thread_id = 1u << 7
+    };
+
+    const log_msg *msg_ = nullptr;
+    bool attached_ = false;
+    unsigned computed_ = 0;
+    std::tm local_tm_;
+    std::tm utc_tm_;
+    int local_offset_ = 0;
+    int utc_offset_ = 0;
+    char local_prefix_[32];
+    size_t local_prefix_size_ = 0;
+    char utc_prefix_[32];
+    size_t utc_prefix_size_ = 0;
+    const char *short_filename_ = "";
+    char thread_id_[24];
+    size_t thread_id_size_ = 0;
+};
+
+// attach a msg_derived to each of count messages for the lifetime of the scope (same as the logger
+// does for a single message). the objects belong to the calling thread and are reused by its next batches.
+class SPDLOG_API msg_derived_batch_scope
+{
+public:
+    msg_derived_batch_scope(const log_msg *msgs, size_t count);
+    ~msg_derived_batch_scope();
+    msg_derived_batch_scope(const msg_derived_batch_scope &) = delete;
+    msg_derived_batch_scope &operator=(const msg_derived_batch_scope &) = delete;
+
+private:
+    msg_derived *derived_;
+    size_t count_;
+};
+
+} // namespace details
+} // namespace spdlog
+
+#ifdef SPDLOG_HEADER_ONLY
+#    include "msg_derived-inl.h"
+#endif
@@ -0,0 +1,234 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+#ifndef SPDLOG_HEADER_ONLY
+#    include <spdlog/details/msg_record.h>
+#endif
+
+#include <spdlog/structured_spdlog.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+namespace spdlog {
+namespace details {
+namespace msg_record {
+
+// record header, stored unaligned
+struct header
+{
+    uint32_t size;
+    uint32_t payload_size;
+    int64_t time_ns;
+    uint64_t thread_id;
+    source_loc source;
+    uint32_t field_count;
+    uint8_t level;
+};
+
+template<typename T>
+inline void put(char *&dest, const T &value)
+{
+    std::memcpy(dest, &value, sizeof(T));
+    dest += sizeof(T);
+}
+
+inline void put_bytes(char *&dest, const char *src, size_t n)
+{
+    if (n > 0)
+    {
+        std::memcpy(dest, src, n);
+        dest += n;
+    }
+}
+
+template<typename T>
+inline T get(const char *&src)
+{
+    T value;
+    std::memcpy(&value, src, sizeof(T));
+    src += sizeof(T);
+    return value;
+}
+
+inline size_t value_size(FieldValueType type)
+{
+    switch (type)
+    {
+    case FieldValueType::STRING_VIEW:
+        return 0;
+    case FieldValueType::SHORT:
+    case FieldValueType::USHORT:
+        return sizeof(short);
+    case FieldValueType::INT:
+    case FieldValueType::UINT:
+        return sizeof(int);
+    case FieldValueType::LONG:
+    case FieldValueType::ULONG:
+        return sizeof(long);
+    case FieldValueType::LONGLONG:
+    case FieldValueType::ULONGLONG:
+        return sizeof(long long);
+    case FieldValueType::BOOL:
+        return sizeof(bool);
+    case FieldValueType::CHAR:
+    case FieldValueType::UCHAR:
+        return sizeof(char);
+    case FieldValueType::WCHAR:
+        return sizeof(wchar_t);
+    case FieldValueType::FLOAT:
+        return sizeof(float);
+    case FieldValueType::DOUBLE:
+        return sizeof(double);
+    case FieldValueType::LONGDOUBLE:
+        return sizeof(long double);
+    }
+    return 0;
+}
+
+inline size_t field_size(const Field &field)
+{
+    size_t n = sizeof(uint8_t) + sizeof(uint32_t) + field.name.size();
+    if (field.value_type == FieldValueType::STRING_VIEW)
+    {
+        return n + sizeof(uint32_t) + field.string_view_.size();
+    }
+    return n + value_size(field.value_type);
+}
+
+inline void put_field(char *&dest, const Field &field)
+{
+    put(dest, static_cast<uint8_t>(field.value_type));
+    put(dest, static_cast<uint32_t>(field.name.size()));
+    put_bytes(dest, field.name.data(), field.name.size());
+    if (field.value_type == FieldValueType::STRING_VIEW)
+    {
+        put(dest, static_cast<uint32_t>(field.string_view_.size()));
+        put_bytes(dest, field.string_view_.data(), field.string_view_.size());
+    }
+    else
+    {
+        // all the union members start at the same address
+        put_bytes(dest, reinterpret_cast<const char *>(&field.short_), value_size(field.value_type));
+    }
+}
+
+SPDLOG_INLINE size_t encoded_size(const log_msg &msg, size_t max_payload)
+{
+    size_t n = sizeof(header) + std::min(msg.payload.size(), max_payload);
+#ifndef SPDLOG_NO_STRUCTURED_SPDLOG
+    for (size_t i = 0; i < msg.field_data_count; i++)
+    {
+        n += field_size(msg.field_data[i]);
+    }
+    if (msg.context_field_data)
+    {
+        for (auto &field : *msg.context_field_data)
+        {
+            n += field_size(field);
+        }
+    }
+#endif
+    return n;
+}
+
+SPDLOG_INLINE void encode_to(const log_msg &msg, char *dest, size_t max_payload)
+{
+    auto *start = dest;
+    header hdr{};
+    hdr.payload_size = static_cast<uint32_t>(std::min(msg.payload.size(), max_payload));
+    hdr.time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(msg.time.time_since_epoch()).count();
+    hdr.thread_id = msg.thread_id;
+    hdr.source = msg.source;
+    hdr.level = static_cast<uint8_t>(msg.level);
+    put(dest, hdr);
+    put_bytes(dest, msg.payload.data(), hdr.payload_size);
+
+    uint32_t field_count = 0;
+#ifndef SPDLOG_NO_STRUCTURED_SPDLOG
+    for (size_t i = 0; i < msg.field_data_count; i++)
+    {
+        put_field(dest, msg.field_data[i]);
+    }
+    field_count += static_cast<uint32_t>(msg.field_data_count);
+    if (msg.context_field_data)
+    {
+        for (auto &field : *msg.context_field_data)
+        {
+            put_field(dest, field);
+            field_count++;
+        }
+    }
+#endif
+
+    // patch the sizes now that they are known
+    auto record_size = static_cast<uint32_t>(dest - start);
+    std::memcpy(start + offsetof(header, size), &record_size, sizeof(record_size));
+    std::memcpy(start + offsetof(header, field_count), &field_count, sizeof(field_count));
+}
+
+SPDLOG_INLINE void encode(const log_msg &msg, memory_buf_t &dest, size_t max_payload)
+{
+    auto start = dest.size();
+    dest.resize(start + encoded_size(msg, max_payload));
+    encode_to(msg, dest.data() + start, max_payload);
+}
+
+SPDLOG_INLINE uint32_t size(const char *src)
+{
+    uint32_t record_size;
+    std::memcpy(&record_size, src + offsetof(header, size), sizeof(record_size));
+    return record_size;
+}
+
+SPDLOG_INLINE log_clock::time_point time(const char *src)
+{
+    int64_t time_ns;
+    std::memcpy(&time_ns, src + offsetof(header, time_ns), sizeof(time_ns));
+    return log_clock::time_point{std::chrono::duration_cast<log_clock::duration>(std::chrono::nanoseconds{time_ns})};
+}
+
+SPDLOG_INLINE void decode(const char *src, string_view_t logger_name, log_msg &msg, std::vector<Field> &fields)
+{
+    auto hdr = get<header>(src);
+    msg = log_msg{};
+    msg.logger_name = logger_name;
+    msg.level = static_cast<level::level_enum>(hdr.level);
+    msg.time = log_clock::time_point{std::chrono::duration_cast<log_clock::duration>(std::chrono::nanoseconds{hdr.time_ns})};
+    msg.thread_id = static_cast<size_t>(hdr.thread_id);
+    msg.source = hdr.source;
+    msg.payload = string_view_t{src, hdr.payload_size};
+    src += hdr.payload_size;
+
+    fields.resize(hdr.field_count);
+    for (auto &field : fields)
+    {
+        field.value_type = static_cast<FieldValueType>(get<uint8_t>(src));
+        auto name_size = get<uint32_t>(src);
+        field.name = string_view_t{src, name_size};
+        src += name_size;
+        if (field.value_type == FieldValueType::STRING_VIEW)
+        {
+            auto string_size = get<uint32_t>(src);
+            field.string_view_ = string_view_t{src, string_size};
+            src += string_size;
+        }
+        else
+        {
+            auto n = value_size(field.value_type);
+            std::memcpy(&field.short_, src, n);
+            src += n;
+        }
+    }
+#ifndef SPDLOG_NO_STRUCTURED_SPDLOG
+    msg.field_data = fields.data();
+    msg.field_data_count = fields.size();
+#endif
+}
+
+} // namespace msg_record
+} // namespace details
+} // namespace spdlog
@@ -0,0 +1,47 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+#include <spdlog/common.h>
+#include <spdlog/details/log_msg.h>
+
+#include <cstdint>
+#include <vector>
+
+// Compact binary form of a log_msg, for keeping messages as raw bytes.
+// A record starts with its total size (uint32_t) and holds the time, level, thread id,
+// source location, payload and fields. Context fields are flattened after the message fields.
+// The logger name is not stored, and the source location pointers are stored as is
+// (they point to static strings).
+
+namespace spdlog {
+namespace details {
+namespace msg_record {
+
+// append the record of msg to dest. the payload is cut to max_payload bytes.
+SPDLOG_API void encode(const log_msg &msg, memory_buf_t &dest, size_t max_payload = static_cast<size_t>(-1));
+
+// size of the record of msg, its payload cut to max_payload bytes
+SPDLOG_API size_t encoded_size(const log_msg &msg, size_t max_payload = static_cast<size_t>(-1));
+
+// write the record of msg to dest, which must have room for encoded_size(msg, max_payload) bytes.
+SPDLOG_API void encode_to(const log_msg &msg, char *dest, size_t max_payload = static_cast<size_t>(-1));
+
+// size of the record starting at src
+SPDLOG_API uint32_t size(const char *src);
+
+// time of the record starting at src
+SPDLOG_API log_clock::time_point time(const char *src);
+
+// decode the record starting at src into msg. fields receives the field table.
+// msg strings point into src, which must outlive msg.
+SPDLOG_API void decode(const char *src, string_view_t logger_name, log_msg &msg, std::vector<Field> &fields);
+
+} // namespace msg_record
+} // namespace details
+} // namespace spdlog
+
+#ifdef SPDLOG_HEADER_ONLY
+#    include "msg_record-inl.h"
+#endif
@@ -43,6 +43,7 @@
 #    include <unistd.h>
 
 #    ifdef __linux__
+#        include <sched.h>       // for sched_setaffinity
 #        include <sys/syscall.h> //Use gettid() syscall under linux to get thread id
 
 #    elif defined(_AIX)
@@ -371,6 +372,29 @@ SPDLOG_INLINE size_t thread_id() SPDLOG_NOEXCEPT
 #endif
 }
 
+SPDLOG_INLINE bool set_thread_affinity(size_t cpu) SPDLOG_NOEXCEPT
+{
+#ifdef _WIN32
+    if (cpu >= sizeof(DWORD_PTR) * 8)
+    {
+        return false;
+    }
+    return ::SetThreadAffinityMask(::GetCurrentThread(), static_cast<DWORD_PTR>(1) << cpu) != 0;
+#elif defined(__linux__)
+    if (cpu >= static_cast<size_t>(CPU_SETSIZE))
+    {
+        return false;
+    }
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    return ::sched_setaffinity(0, sizeof(cpus), &cpus) == 0; // 0: the calling thread
+#else // not supported
+    (void)cpu;
+    return false;
+#endif
+}
+
 // This is avoid msvc issue in sleep_for that happens if the clock changes.
 // See https://github.com/gabime/spdlog/issues/609
 SPDLOG_INLINE void sleep_for_millis(unsigned int milliseconds) SPDLOG_NOEXCEPT
@@ -72,6 +72,9 @@ SPDLOG_API size_t _thread_id() SPDLOG_NOEXCEPT;
 // Return current thread id as size_t (from thread local storage)
 SPDLOG_API size_t thread_id() SPDLOG_NOEXCEPT;
 
+// Pin the calling thread to the given cpu. Return false if it failed (or is not supported).
+SPDLOG_API bool set_thread_affinity(size_t cpu) SPDLOG_NOEXCEPT;
+
 // This is avoid msvc issue in sleep_for that happens if the clock changes.
 // See https://github.com/gabime/spdlog/issues/609
 SPDLOG_API void sleep_for_millis(unsigned int milliseconds) SPDLOG_NOEXCEPT;
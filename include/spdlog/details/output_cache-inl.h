@@ -0,0 +1,162 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+#ifndef SPDLOG_HEADER_ONLY
+#    include <spdlog/details/output_cache.h>
+#endif
+
+#include <spdlog/details/fmt_helper.h>
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace spdlog {
+namespace details {
+
+SPDLOG_INLINE bool output_cache::fetch(size_t key, const log_msg &msg, memory_buf_t &dest) const
+{
+    for (size_t i = 0; i < count_; i++)
+    {
+        auto &e = entries_[i];
+        if (e.key == key)
+        {
+            dest.append(e.formatted.data(), e.formatted.data() + e.formatted.size());
+            msg.color_range_start = e.color_range_start;
+            msg.color_range_end = e.color_range_end;
+            return true;
+        }
+    }
+    return false;
+}
+
+SPDLOG_INLINE void output_cache::store(size_t key, const log_msg &msg, const memory_buf_t &formatted)
+{
+    if (count_ == max_entries)
+    {
+        return;
+    }
+    auto &e = entries_[count_++];
+    e.key = key;
+    e.color_range_start = msg.color_range_start;
+    e.color_range_end = msg.color_range_end;
+    e.formatted.clear();
+    e.formatted.append(formatted.data(), formatted.data() + formatted.size());
+}
+
+SPDLOG_INLINE output_cache_scope::output_cache_scope(const log_msg &msg)
+    : msg_(msg)
+{
+    msg_.shared_output = &cache_;
+}
+
+SPDLOG_INLINE output_cache_scope::~output_cache_scope()
+{
+    msg_.shared_output = nullptr;
+}
+
+SPDLOG_INLINE output_cache_batch_scope::output_cache_batch_scope(const log_msg *msgs, size_t count)
+    : msgs_(msgs)
+    , count_(count)
+{
+    if (count_ == 0)
+    {
+        return;
+    }
+    thread_local std::unique_ptr<output_cache[]> caches;
+    thread_local size_t capacity = 0;
+    if (capacity < count_)
+    {
+        caches.reset(new output_cache[count_]);
+        capacity = count_;
+    }
+    for (size_t i = 0; i < count_; i++)
+    {
+        caches[i].clear();
+        msgs_[i].shared_output = &caches[i];
+    }
+}
+
+SPDLOG_INLINE output_cache_batch_scope::~output_cache_batch_scope()
+{
+    for (size_t i = 0; i < count_; i++)
+    {
+        msgs_[i].shared_output = nullptr;
+    }
+}
+
+struct format_share_keys
+{
+    std::mutex mutex;
+    std::unordered_map<std::string, size_t> keys;
+    size_t next = 1;
+};
+
+inline format_share_keys &format_share_keys_instance()
+{
+    static format_share_keys s_instance;
+    return s_instance;
+}
+
+SPDLOG_INLINE size_t format_share_key(const std::string &description)
+{
+    auto &instance = format_share_keys_instance();
+    std::lock_guard<std::mutex> lock(instance.mutex);
+    auto it = instance.keys.find(description);
+    if (it != instance.keys.end())
+    {
+        return it->second;
+    }
+    auto key = instance.next++;
+    instance.keys.emplace(description, key);
+    return key;
+}
+
+SPDLOG_INLINE size_t unique_format_share_key()
+{
+    auto &instance = format_share_keys_instance();
+    std::lock_guard<std::mutex> lock(instance.mutex);
+    return instance.next++;
+}
+
+SPDLOG_INLINE shared_formatter::shared_formatter(std::unique_ptr<formatter> inner, size_t key)
+    : inner_(std::move(inner))
+    , key_(key)
+{}
+
+SPDLOG_INLINE void shared_formatter::format(const log_msg &msg, memory_buf_t &dest)
+{
+    auto *cache = dest.size() == 0 ? msg.shared_output : nullptr;
+    if (cache != nullptr && key_ != 0 && cache->fetch(key_, msg, dest))
+    {
+        return;
+    }
+
+    // hide the cache from the wrapped formatter: this key replaces its own
+    struct hide_cache
+    {
+        const log_msg &msg;
+        output_cache *saved;
+        ~hide_cache()
+        {
+            msg.shared_output = saved;
+        }
+    } hide{msg, msg.shared_output};
+    msg.shared_output = nullptr;
+    inner_->format(msg, dest);
+
+    if (cache != nullptr && key_ != 0)
+    {
+        cache->store(key_, msg, dest);
+    }
+}
+
+SPDLOG_INLINE std::unique_ptr<formatter> shared_formatter::clone() const
+{
+    return details::make_unique<shared_formatter>(inner_->clone(), key_);
+}
+
+} // namespace details
+} // namespace spdlog
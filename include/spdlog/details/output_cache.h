@@ -0,0 +1,114 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+#include <spdlog/common.h>
+#include <spdlog/details/log_msg.h>
+#include <spdlog/formatter.h>
+
+#include <memory>
+#include <string>
+
+// Formatted output of one message, shared by the sinks whose formatters have the same
+// share key (see formatter::share_key()), so a logger with several sinks using the same
+// pattern formats each message once.
+// The logger attaches it to the message (log_msg::shared_output) while passing the message to its sinks.
+
+namespace spdlog {
+namespace details {
+
+class SPDLOG_API output_cache
+{
+public:
+    output_cache() = default;
+    output_cache(const output_cache &) = delete;
+    output_cache &operator=(const output_cache &) = delete;
+
+    // append the output stored under key to dest and restore the message color range.
+    // return false if nothing is stored under key.
+    bool fetch(size_t key, const log_msg &msg, memory_buf_t &dest) const;
+
+    // store the output of msg formatted by a formatter with the given key
+    void store(size_t key, const log_msg &msg, const memory_buf_t &formatted);
+
+    // forget the stored outputs (and keep their memory)
+    void clear()
+    {
+        count_ = 0;
+    }
+
+private:
+    struct entry
+    {
+        size_t key = 0;
+        size_t color_range_start = 0;
+        size_t color_range_end = 0;
+        memory_buf_t formatted;
+    };
+
+    static const size_t max_entries = 4;
+    size_t count_ = 0;
+    entry entries_[max_entries];
+};
+
+// attach an output_cache to msg for the lifetime of the scope
+class SPDLOG_API output_cache_scope
+{
+public:
+    explicit output_cache_scope(const log_msg &msg);
+    ~output_cache_scope();
+    output_cache_scope(const output_cache_scope &) = delete;
+    output_cache_scope &operator=(const output_cache_scope &) = delete;
+
+private:
+    const log_msg &msg_;
+    output_cache cache_;
+};
+
+// attach an output_cache to each of count messages for the lifetime of the scope.
+// the caches belong to the calling thread and are reused by its next batches.
+class SPDLOG_API output_cache_batch_scope
+{
+public:
+    output_cache_batch_scope(const log_msg *msgs, size_t count);
+    ~output_cache_batch_scope();
+    output_cache_batch_scope(const output_cache_batch_scope &) = delete;
+    output_cache_batch_scope &operator=(const output_cache_batch_scope &) = delete;
+
+private:
+    const log_msg *msgs_;
+    size_t count_;
+};
+
+// key of the formatters described by the given text: equal descriptions get equal keys
+SPDLOG_API size_t format_share_key(const std::string &description);
+
+// key no other formatter has
+SPDLOG_API size_t unique_format_share_key();
+
+// wraps a formatter and shares its output under the given key (0: never share).
+// used by logger::set_formatter() / set_pattern() with an explicit formatter_sharing.
+class SPDLOG_API shared_formatter final : public formatter
+{
+public:
+    shared_formatter(std::unique_ptr<formatter> inner, size_t key);
+
+    void format(const log_msg &msg, memory_buf_t &dest) override;
+    std::unique_ptr<formatter> clone() const override;
+    size_t share_key() const override
+    {
+        return key_;
+    }
+
+private:
+    std::unique_ptr<formatter> inner_;
+    size_t key_;
+};
+
+} // namespace details
+} // namespace spdlog
+
+#ifdef SPDLOG_HEADER_ONLY
+#    include "output_cache-inl.h"
+#endif
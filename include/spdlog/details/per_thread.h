@@ -0,0 +1,139 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// One lazily created object per (thread, owner).
+// The calling thread reaches its object through a thread local cache, so the owner's mutex
+// is taken only the first time a thread asks for it (and when the owner walks the objects).
+// Objects outlive their thread until the owner releases them, so their content can still be
+// read after the thread exits.
+
+namespace spdlog {
+namespace details {
+
+template<typename T>
+class per_thread
+{
+public:
+    per_thread()
+        : id_{next_id_()}
+    {}
+
+    per_thread(const per_thread &) = delete;
+    per_thread &operator=(const per_thread &) = delete;
+
+    // object of the calling thread, created with make() on first use.
+    template<typename Make>
+    T &local(Make &&make)
+    {
+        auto id = id_.load(std::memory_order_acquire);
+        auto &cache = thread_cache_();
+        for (auto &entry : cache)
+        {
+            if (entry.first == id)
+            {
+                return *entry.second;
+            }
+        }
+
+        // drop the objects of owners that forgot them (destroyed or reset)
+        cache.erase(std::remove_if(cache.begin(), cache.end(),
+                        [](const std::pair<uint64_t, std::shared_ptr<T>> &entry) { return entry.second.use_count() == 1; }),
+            cache.end());
+
+        std::shared_ptr<T> obj{make()};
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            id = id_.load(std::memory_order_relaxed); // may have been reset meanwhile
+            objects_.push_back(obj);
+            version_.fetch_add(1, std::memory_order_release);
+        }
+        cache.emplace_back(id, obj);
+        return *obj;
+    }
+
+    // apply fun on every object created so far
+    template<typename Fun>
+    void for_each(Fun &&fun)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto &obj : objects_)
+        {
+            fun(*obj);
+        }
+    }
+
+    // copy of the object list, for owners that walk it too often to take the mutex every time.
+    // version() tells when the copy is out of date.
+    std::vector<std::shared_ptr<T>> snapshot()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return objects_;
+    }
+
+    // changes whenever an object is added or forgotten
+    uint64_t version() const
+    {
+        return version_.load(std::memory_order_acquire);
+    }
+
+    // forget all the objects. threads get new ones on their next local() call.
+    void reset()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        id_.store(next_id_(), std::memory_order_release);
+        objects_.clear();
+        version_.fetch_add(1, std::memory_order_release);
+    }
+
+    // forget the objects whose thread has exited
+    void release_unused()
+    {
+        release_unused_if([](const T &) { return true; });
+    }
+
+    // forget the objects whose thread has exited and for which pred() returns true.
+    // objects still held in a snapshot are kept.
+    template<typename Pred>
+    void release_unused_if(Pred &&pred)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto last = std::remove_if(objects_.begin(), objects_.end(),
+            [&pred](const std::shared_ptr<T> &obj) { return obj.use_count() == 1 && pred(*obj); });
+        if (last != objects_.end())
+        {
+            objects_.erase(last, objects_.end());
+            version_.fetch_add(1, std::memory_order_release);
+        }
+    }
+
+private:
+    static uint64_t next_id_()
+    {
+        static std::atomic<uint64_t> s_counter{0};
+        return s_counter.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+    static std::vector<std::pair<uint64_t, std::shared_ptr<T>>> &thread_cache_()
+    {
+        thread_local std::vector<std::pair<uint64_t, std::shared_ptr<T>>> cache;
+        return cache;
+    }
+
+    std::atomic<uint64_t> id_;
+    std::atomic<uint64_t> version_{0};
+    std::mutex mutex_;
+    std::vector<std::shared_ptr<T>> objects_;
+};
+
+} // namespace details
+} // namespace spdlog
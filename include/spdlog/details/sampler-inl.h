@@ -0,0 +1,126 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+#ifndef SPDLOG_HEADER_ONLY
+#    include <spdlog/details/sampler.h>
+#endif
+
+#include <algorithm>
+
+namespace spdlog {
+namespace details {
+
+SPDLOG_INLINE sampler::sampler(sampling_policy policy)
+{
+    reset(policy);
+}
+
+SPDLOG_INLINE sampling_policy sampler::policy() const
+{
+    return sampling_policy{static_cast<sampling_policy::kind>(type_.load(std::memory_order_relaxed)), n_.load(std::memory_order_relaxed),
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::nanoseconds(interval_ns_.load(std::memory_order_relaxed)))};
+}
+
+SPDLOG_INLINE void sampler::reset(sampling_policy policy)
+{
+    auto interval_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(policy.interval).count();
+    if (policy.type != sampling_policy::kind::none && policy.n == 0)
+    {
+        throw_spdlog_ex("sampler: n must be greater than 0");
+    }
+    if ((policy.type == sampling_policy::kind::token_bucket || policy.type == sampling_policy::kind::first_n) && interval_ns <= 0)
+    {
+        throw_spdlog_ex("sampler: interval must be greater than 0");
+    }
+    type_.store(static_cast<int>(policy.type), std::memory_order_relaxed);
+    n_.store(policy.n, std::memory_order_relaxed);
+    interval_ns_.store(interval_ns, std::memory_order_relaxed);
+    emission_ns_.store(policy.n > 0 ? interval_ns / static_cast<int64_t>(policy.n) : interval_ns, std::memory_order_relaxed);
+    counter_.store(0, std::memory_order_relaxed);
+    time_ns_.store(0, std::memory_order_relaxed);
+    suppressed_.store(0, std::memory_order_relaxed);
+}
+
+SPDLOG_INLINE bool sampler::allow(log_clock::time_point now, size_t &suppressed)
+{
+    suppressed = 0;
+    auto now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count();
+    // a concurrent reset() may mix the fields of two policies: n is 0 only for kind::none
+    auto n = n_.load(std::memory_order_relaxed);
+    if (n == 0)
+    {
+        return true;
+    }
+    auto interval_ns = interval_ns_.load(std::memory_order_relaxed);
+
+    switch (static_cast<sampling_policy::kind>(type_.load(std::memory_order_relaxed)))
+    {
+    case sampling_policy::kind::none:
+        return true;
+
+    case sampling_policy::kind::every_nth:
+        return counter_.fetch_add(1, std::memory_order_relaxed) % n == 0;
+
+    case sampling_policy::kind::token_bucket:
+    {
+        // generic cell rate algorithm: a token bucket kept as a single "theoretical arrival time".
+        auto tat = time_ns_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            auto new_tat = std::max(tat, now_ns) + emission_ns_.load(std::memory_order_relaxed);
+            if (new_tat - now_ns > interval_ns)
+            {
+                suppressed_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            if (time_ns_.compare_exchange_weak(tat, new_tat, std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        if (suppressed_.load(std::memory_order_relaxed) > 0)
+        {
+            suppressed = suppressed_.exchange(0, std::memory_order_relaxed);
+        }
+        return true;
+    }
+
+    case sampling_policy::kind::first_n:
+    {
+        auto window_start = time_ns_.load(std::memory_order_relaxed);
+        if (now_ns < window_start || now_ns - window_start >= interval_ns)
+        {
+            // the thread that opens the new window reports the previous one
+            if (time_ns_.compare_exchange_strong(window_start, now_ns, std::memory_order_relaxed))
+            {
+                counter_.store(0, std::memory_order_relaxed);
+                suppressed = suppressed_.exchange(0, std::memory_order_relaxed);
+            }
+        }
+        if (counter_.fetch_add(1, std::memory_order_relaxed) < n)
+        {
+            return true;
+        }
+        // dropped (by a thread that filled the new window first): the summary of the previous one
+        // is still reported now
+        suppressed_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    }
+    return true;
+}
+
+SPDLOG_INLINE size_t sampler::take_suppressed(const void *owner, level::level_enum &lvl)
+{
+    if (suppressed_.load(std::memory_order_relaxed) == 0 || owner_.load(std::memory_order_relaxed) != owner)
+    {
+        return 0;
+    }
+    lvl = static_cast<level::level_enum>(level_.load(std::memory_order_relaxed));
+    return suppressed_.exchange(0, std::memory_order_relaxed);
+}
+
+} // namespace details
+} // namespace spdlog
@@ -0,0 +1,112 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+#include <spdlog/common.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Lock free sampling and rate limiting of log messages.
+// Used per call site (spdlog::set_callsite_sampling()) and per logger (logger::set_sampling()).
+// Windowed policies report how many messages they dropped with the first message let through
+// after the window closed (first_n: with the first message after the window, even if dropped),
+// so the summary shows up when the site logs again. logger::flush() and the logger's destructor
+// log the summaries still pending.
+
+namespace spdlog {
+
+struct sampling_policy
+{
+    enum class kind
+    {
+        none,
+        every_nth,    // log one message out of every n
+        token_bucket, // log at most n messages per interval, refilled continuously
+        first_n       // log the first n messages of every interval
+    };
+
+    sampling_policy() = default;
+    sampling_policy(kind type_in, size_t n_in, std::chrono::milliseconds interval_in)
+        : type(type_in)
+        , n(n_in)
+        , interval(interval_in)
+    {}
+
+    // log one message out of every n
+    static sampling_policy every_nth(size_t n)
+    {
+        return sampling_policy{kind::every_nth, n, std::chrono::milliseconds::zero()};
+    }
+
+    // log at most max_messages per interval (bursts up to max_messages)
+    static sampling_policy rate_limit(size_t max_messages, std::chrono::milliseconds interval)
+    {
+        return sampling_policy{kind::token_bucket, max_messages, interval};
+    }
+
+    // log the first n messages of every interval and summarize the rest
+    static sampling_policy first_n(size_t n, std::chrono::milliseconds interval)
+    {
+        return sampling_policy{kind::first_n, n, interval};
+    }
+
+    kind type = kind::none;
+    size_t n = 0;
+    std::chrono::milliseconds interval{0};
+};
+
+namespace details {
+
+class SPDLOG_API sampler
+{
+public:
+    explicit sampler(sampling_policy policy);
+    sampler(const sampler &) = delete;
+    sampler &operator=(const sampler &) = delete;
+
+    sampling_policy policy() const;
+
+    // switch to another policy and start over. may run while other threads call allow(): they see
+    // either policy for a message or two, never an invalid one. throws on an invalid policy.
+    void reset(sampling_policy policy);
+
+    // return true if a message logged at the given time should be logged.
+    // suppressed is set to the number of messages dropped since the last summary when the summary
+    // is due (always 0 for every_nth, whose drop rate is known).
+    bool allow(log_clock::time_point now, size_t &suppressed);
+
+    // record who dropped the last message (allow() returned false), and at which level
+    void suppressed_by(const void *owner, level::level_enum lvl)
+    {
+        owner_.store(owner, std::memory_order_relaxed);
+        level_.store(static_cast<int>(lvl), std::memory_order_relaxed);
+    }
+
+    // the messages dropped since the last summary, if owner dropped the last one, and their level.
+    // they are not reported again.
+    size_t take_suppressed(const void *owner, level::level_enum &lvl);
+
+private:
+    std::atomic<int> type_{0};
+    std::atomic<size_t> n_{0};
+    std::atomic<int64_t> interval_ns_{0};
+    std::atomic<int64_t> emission_ns_{0}; // token_bucket: time worth of one token
+
+    // every_nth: message counter. first_n: messages in the current window.
+    std::atomic<uint64_t> counter_{0};
+    // token_bucket: theoretical arrival time. first_n: start of the current window.
+    std::atomic<int64_t> time_ns_{0};
+    std::atomic<size_t> suppressed_{0};
+    std::atomic<const void *> owner_{nullptr};
+    std::atomic<int> level_{0};
+};
+
+} // namespace details
+} // namespace spdlog
+
+#ifdef SPDLOG_HEADER_ONLY
+#    include "sampler-inl.h"
+#endif
@@ -0,0 +1,187 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+#ifndef SPDLOG_HEADER_ONLY
+#    include <spdlog/details/spill_file.h>
+#endif
+
+#include <spdlog/details/os.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#ifdef _WIN32
+#    include <spdlog/details/windows_include.h>
+#else
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <unistd.h>
+#endif
+
+namespace spdlog {
+namespace details {
+
+SPDLOG_INLINE spill_file::spill_file(filename_t base_filename, size_t segment_size, size_t budget)
+    : base_filename_(std::move(base_filename))
+    , segment_size_((std::max(segment_size, size_t{1}) + 4095) & ~size_t{4095})
+    , max_segments_(std::max(budget / segment_size_, size_t{1}))
+{
+    os::create_dir(os::dir_name(base_filename_));
+}
+
+SPDLOG_INLINE spill_file::~spill_file()
+{
+    for (auto &seg : segments_)
+    {
+        unmap_(seg);
+        os::remove(seg.filename);
+    }
+}
+
+SPDLOG_INLINE char *spill_file::append(size_t size)
+{
+    auto record_size = (size + header_size + 7) & ~size_t{7};
+    if (record_size > segment_size_)
+    {
+        return nullptr;
+    }
+    if (segments_.empty() || segments_.back().write_pos + record_size > segment_size_)
+    {
+        if (segments_.size() >= max_segments_)
+        {
+            return nullptr;
+        }
+        segment seg;
+        seg.filename = fmt_lib::format(SPDLOG_FILENAME_T("{}.{}"), base_filename_, next_index_++);
+        map_(seg);
+        segments_.push_back(std::move(seg));
+    }
+
+    auto &seg = segments_.back();
+    auto *record = seg.data + seg.write_pos;
+    auto size32 = static_cast<uint32_t>(record_size);
+    std::memcpy(record, &size32, sizeof(size32));
+    seg.write_pos += record_size;
+    return record + header_size;
+}
+
+SPDLOG_INLINE bool spill_file::readable() const
+{
+    // a segment after the one being read always holds a record
+    return read_segment_ < segments_.size() &&
+           (read_pos_ < segments_[read_segment_].write_pos || read_segment_ + 1 < segments_.size());
+}
+
+SPDLOG_INLINE char *spill_file::read()
+{
+    while (read_segment_ < segments_.size())
+    {
+        auto &seg = segments_[read_segment_];
+        if (read_pos_ < seg.write_pos)
+        {
+            uint32_t record_size;
+            std::memcpy(&record_size, seg.data + read_pos_, sizeof(record_size));
+            auto *record = seg.data + read_pos_ + header_size;
+            read_pos_ += record_size;
+            return record;
+        }
+        if (read_segment_ + 1 == segments_.size())
+        {
+            return nullptr;
+        }
+        read_segment_++;
+        read_pos_ = 0;
+    }
+    return nullptr;
+}
+
+SPDLOG_INLINE void spill_file::release()
+{
+    for (; read_segment_ > 0; read_segment_--)
+    {
+        unmap_(segments_.front());
+        os::remove(segments_.front().filename);
+        segments_.pop_front();
+    }
+    // all read: the last segment starts over
+    if (segments_.size() == 1 && read_pos_ == segments_.front().write_pos)
+    {
+        segments_.front().write_pos = 0;
+        read_pos_ = 0;
+    }
+}
+
+#ifdef _WIN32
+SPDLOG_INLINE void spill_file::map_(segment &seg)
+{
+#    ifdef SPDLOG_WCHAR_FILENAMES
+    HANDLE file = ::CreateFileW(seg.filename.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY, nullptr);
+#    else
+    HANDLE file = ::CreateFileA(seg.filename.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY, nullptr);
+#    endif
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        throw_spdlog_ex("spill_file: failed creating " + os::filename_to_str(seg.filename), static_cast<int>(::GetLastError()));
+    }
+    auto size = static_cast<uint64_t>(segment_size_);
+    HANDLE mapping = ::CreateFileMappingW(file, nullptr, PAGE_READWRITE, static_cast<DWORD>(size >> 32), static_cast<DWORD>(size), nullptr);
+    void *data = mapping != nullptr ? ::MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, segment_size_) : nullptr;
+    if (data == nullptr)
+    {
+        auto err = static_cast<int>(::GetLastError());
+        if (mapping != nullptr)
+        {
+            ::CloseHandle(mapping);
+        }
+        ::CloseHandle(file);
+        os::remove(seg.filename);
+        throw_spdlog_ex("spill_file: failed mapping " + os::filename_to_str(seg.filename), err);
+    }
+    seg.file = file;
+    seg.mapping = mapping;
+    seg.data = static_cast<char *>(data);
+}
+
+SPDLOG_INLINE void spill_file::unmap_(segment &seg)
+{
+    ::UnmapViewOfFile(seg.data);
+    ::CloseHandle(seg.mapping);
+    ::CloseHandle(seg.file);
+    seg.data = nullptr;
+}
+#else
+SPDLOG_INLINE void spill_file::map_(segment &seg)
+{
+    int fd = ::open(seg.filename.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1)
+    {
+        throw_spdlog_ex("spill_file: failed creating " + os::filename_to_str(seg.filename), errno);
+    }
+    void *data = MAP_FAILED;
+    if (::ftruncate(fd, static_cast<off_t>(segment_size_)) == 0)
+    {
+        data = ::mmap(nullptr, segment_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    auto err = errno;
+    ::close(fd);
+    if (data == MAP_FAILED)
+    {
+        os::remove(seg.filename);
+        throw_spdlog_ex("spill_file: failed mapping " + os::filename_to_str(seg.filename), err);
+    }
+    seg.data = static_cast<char *>(data);
+}
+
+SPDLOG_INLINE void spill_file::unmap_(segment &seg)
+{
+    ::munmap(seg.data, segment_size_);
+    seg.data = nullptr;
+}
+#endif
+
+} // namespace details
+} // namespace spdlog
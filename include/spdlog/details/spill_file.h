@@ -0,0 +1,84 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+// Append only log of variable length records kept in memory mapped segment files
+// (<base_filename>.<n>), where the async thread pool spills the messages its queue has no room for.
+// Records are appended at the end of the last segment and read in order from the first one; the
+// segments read entirely are unmapped and removed. The files are not meant to survive the process.
+// Not thread safe: the thread pool guards it with a mutex (the records read stay valid until release()).
+
+#include <spdlog/common.h>
+
+#include <deque>
+
+namespace spdlog {
+namespace details {
+
+class SPDLOG_API spill_file
+{
+public:
+    // segment_size rounded up to a multiple of 4KB. at most budget bytes of segments (at least one segment).
+    spill_file(filename_t base_filename, size_t segment_size, size_t budget);
+    ~spill_file();
+    spill_file(const spill_file &) = delete;
+    spill_file &operator=(const spill_file &) = delete;
+
+    // room for a record of size bytes (8 bytes aligned) at the end of the log,
+    // or nullptr if a new segment is needed and the budget is used up
+    char *append(size_t size);
+
+    // is there a record to read
+    bool readable() const;
+
+    // next record after the ones already read, or nullptr
+    char *read();
+
+    // remove the segments read entirely (the records read so far become invalid)
+    void release();
+
+    // largest record that fits in a segment
+    size_t max_record_size() const
+    {
+        return segment_size_ - header_size;
+    }
+
+    // bytes of segment files
+    size_t disk_size() const
+    {
+        return segments_.size() * segment_size_;
+    }
+
+private:
+    static const size_t header_size = 8;
+
+    struct segment
+    {
+        filename_t filename;
+        char *data = nullptr;
+        size_t write_pos = 0;
+#ifdef _WIN32
+        void *file = nullptr;
+        void *mapping = nullptr;
+#endif
+    };
+
+    void map_(segment &seg);
+    void unmap_(segment &seg);
+
+    filename_t base_filename_;
+    size_t segment_size_;
+    size_t max_segments_;
+    size_t next_index_ = 0;
+    std::deque<segment> segments_;
+    size_t read_segment_ = 0; // index in segments_
+    size_t read_pos_ = 0;
+};
+
+} // namespace details
+} // namespace spdlog
+
+#ifdef SPDLOG_HEADER_ONLY
+#    include "spill_file-inl.h"
+#endif
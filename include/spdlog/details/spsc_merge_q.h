@@ -0,0 +1,313 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+// multi producer-single consumer queue made of one bounded SPSC ring per producing thread.
+// A producer only writes its own ring (created on its first enqueue), so producers never share
+// a cache line. The consumer pops the head with the oldest enqueue stamp among all the rings,
+// which keeps the global order of the messages (every thread's messages stay in order; messages
+// of different threads published at nearly the same moment may be seen slightly out of order).
+// Same interface as mpmc_blocking_queue, with these differences:
+// enqueue_nowait(..) - drops the NEW message if the thread's ring is full: only the consumer may pop
+// from a ring, so the oldest one cannot be overrun.
+// dequeue_for(..) - must be called from a single consumer thread.
+// max_items is the capacity of each thread's ring, rounded up to a power of two (at least 2).
+
+#include <spdlog/details/per_thread.h>
+#include <spdlog/details/waiter.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace spdlog {
+namespace details {
+
+template<typename T>
+class spsc_merge_queue
+{
+public:
+    using item_type = T;
+    explicit spsc_merge_queue(size_t max_items)
+        : ring_capacity_{round_up_(max_items)}
+    {}
+
+    spsc_merge_queue(const spsc_merge_queue &) = delete;
+    spsc_merge_queue &operator=(const spsc_merge_queue &) = delete;
+
+    // try to enqueue and block if no room left in the calling thread's ring
+    void enqueue(T &&item)
+    {
+        auto &r = local_ring_();
+        auto stamp = now_();
+        if (!r.try_push(item, stamp))
+        {
+            not_full_.wait([&r, &item, stamp] { return r.try_push(item, stamp); });
+        }
+        not_empty_.notify_one();
+    }
+
+    // enqueue immediately. drop the message if no room left in the calling thread's ring.
+    void enqueue_nowait(T &&item)
+    {
+        if (!local_ring_().try_push(item, now_()))
+        {
+            overrun_counter_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        not_empty_.notify_one();
+    }
+
+    // only the consumer may pop: drops the new message like enqueue_nowait(..), never returns false
+    bool enqueue_or_overrun(T &&item, T &)
+    {
+        enqueue_nowait(std::move(item));
+        return true;
+    }
+
+    // enqueue immediately. return false (and drop the item, without counting it) if no room left in the calling thread's ring.
+    bool try_enqueue(T &&item)
+    {
+        if (!local_ring_().try_push(item, now_()))
+        {
+            return false;
+        }
+        not_empty_.notify_one();
+        return true;
+    }
+
+    // try to dequeue item. if no item found. wait up to timeout and try again
+    // Return true, if succeeded dequeue item, false otherwise
+    bool dequeue_for(T &popped_item, std::chrono::milliseconds wait_duration)
+    {
+        if (!try_dequeue_(popped_item) &&
+            !not_empty_.wait_for([this, &popped_item] { return this->try_dequeue_(popped_item); }, wait_duration))
+        {
+            release_exited_();
+            return false;
+        }
+        // producers blocked on different rings share the waiter: wake them all
+        not_full_.notify_all();
+        return true;
+    }
+
+    // dequeue without waiting. return false if the queue is empty.
+    bool try_dequeue(T &popped_item)
+    {
+        if (!try_dequeue_(popped_item))
+        {
+            return false;
+        }
+        not_full_.notify_all();
+        return true;
+    }
+
+    size_t overrun_counter()
+    {
+        return overrun_counter_.load(std::memory_order_relaxed);
+    }
+
+    size_t size()
+    {
+        size_t total = 0;
+        rings_.for_each([&total](ring &r) { total += r.size(); });
+        return total;
+    }
+
+    // consumer only: items in the rings the consumer knows of, without locking the list of rings
+    size_t approx_size()
+    {
+        size_t total = 0;
+        for (auto &r : snapshot_)
+        {
+            total += r->size();
+        }
+        return total;
+    }
+
+    // capacity of each thread's ring
+    size_t capacity() const
+    {
+        return ring_capacity_;
+    }
+
+    // number of rings (threads that enqueued and whose ring was not released yet)
+    size_t rings()
+    {
+        return rings_.snapshot().size();
+    }
+
+private:
+    static constexpr size_t cache_line = 64;
+
+    struct cell
+    {
+        uint64_t stamp;
+        T data;
+    };
+
+    class ring
+    {
+    public:
+        explicit ring(size_t capacity)
+            : mask_{capacity - 1}
+            , cells_{new cell[capacity]}
+        {}
+
+        // producer side
+        bool try_push(T &item, uint64_t stamp)
+        {
+            auto tail = tail_.load(std::memory_order_relaxed);
+            if (tail - head_cache_ > mask_)
+            {
+                head_cache_ = head_.load(std::memory_order_acquire);
+                if (tail - head_cache_ > mask_)
+                {
+                    return false; // full
+                }
+            }
+            auto &c = cells_[tail & mask_];
+            c.stamp = stamp;
+            c.data = std::move(item);
+            tail_.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        // consumer side: oldest cell or nullptr if empty
+        cell *front()
+        {
+            auto head = head_.load(std::memory_order_relaxed);
+            if (head == tail_cache_)
+            {
+                tail_cache_ = tail_.load(std::memory_order_acquire);
+                if (head == tail_cache_)
+                {
+                    return nullptr;
+                }
+            }
+            return &cells_[head & mask_];
+        }
+
+        void pop()
+        {
+            head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        size_t size() const
+        {
+            auto head = head_.load(std::memory_order_acquire);
+            auto tail = tail_.load(std::memory_order_acquire);
+            return tail > head ? tail - head : 0;
+        }
+
+    private:
+        const size_t mask_;
+        std::unique_ptr<cell[]> cells_;
+
+        // producer's line: its position and the last consumer position it saw
+        char pad0_[cache_line];
+        std::atomic<size_t> tail_{0};
+        size_t head_cache_ = 0;
+        // consumer's line
+        char pad1_[cache_line - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+        std::atomic<size_t> head_{0};
+        size_t tail_cache_ = 0;
+        char pad2_[cache_line - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+    };
+
+    static size_t round_up_(size_t n)
+    {
+        size_t rounded = 2;
+        while (rounded < n)
+        {
+            rounded <<= 1;
+        }
+        return rounded;
+    }
+
+    static uint64_t now_()
+    {
+        return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+    }
+
+    ring &local_ring_()
+    {
+        auto capacity = ring_capacity_;
+        return rings_.local([capacity] { return new ring(capacity); });
+    }
+
+    // consumer side: pop the oldest head of all the rings.
+    // only the rings without a cached head stamp are looked at: the others keep theirs until popped.
+    bool try_dequeue_(T &item)
+    {
+        auto version = rings_.version();
+        if (version != snapshot_version_)
+        {
+            snapshot_ = rings_.snapshot();
+            snapshot_version_ = version;
+            head_stamps_.assign(snapshot_.size(), no_stamp);
+        }
+
+        size_t oldest = snapshot_.size();
+        uint64_t oldest_stamp = no_stamp;
+        for (size_t i = 0; i < snapshot_.size(); i++)
+        {
+            auto stamp = head_stamps_[i];
+            if (stamp == no_stamp)
+            {
+                auto *c = snapshot_[i]->front();
+                if (c == nullptr)
+                {
+                    continue;
+                }
+                stamp = head_stamps_[i] = c->stamp;
+            }
+            if (stamp < oldest_stamp)
+            {
+                oldest = i;
+                oldest_stamp = stamp;
+            }
+        }
+        if (oldest == snapshot_.size())
+        {
+            return false;
+        }
+        auto &r = *snapshot_[oldest];
+        item = std::move(r.front()->data);
+        r.pop();
+        head_stamps_[oldest] = no_stamp;
+        return true;
+    }
+
+    // forget the drained rings of the threads that exited (called by the consumer when idle)
+    void release_exited_()
+    {
+        snapshot_.clear();
+        rings_.release_unused_if([](const ring &r) { return r.size() == 0; });
+        snapshot_version_ = 0;
+    }
+
+    const size_t ring_capacity_;
+    per_thread<ring> rings_;
+    std::atomic<size_t> overrun_counter_{0};
+
+    // consumer only
+    std::vector<std::shared_ptr<ring>> snapshot_;
+    uint64_t snapshot_version_ = 0;
+    // stamp of the head of each snapshot ring (no_stamp: not looked at since the last pop)
+    static constexpr uint64_t no_stamp = ~uint64_t{0};
+    std::vector<uint64_t> head_stamps_;
+
+    waiter not_empty_;
+    waiter not_full_;
+};
+
+template<typename T>
+constexpr uint64_t spsc_merge_queue<T>::no_stamp;
+} // namespace details
+} // namespace spdlog
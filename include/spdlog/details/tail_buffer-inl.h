@@ -0,0 +1,89 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+#ifndef SPDLOG_NO_STRUCTURED_SPDLOG
+
+#    ifndef SPDLOG_HEADER_ONLY
+#        include <spdlog/details/tail_buffer.h>
+#    endif
+
+namespace spdlog {
+namespace details {
+
+SPDLOG_INLINE tail_buffer::tail_buffer(
+    size_t max_messages, level::level_enum capture_level, level::level_enum trigger_level, tail_buffer *parent)
+    : max_messages_(max_messages)
+    , capture_level_(capture_level)
+    , trigger_level_(trigger_level)
+    , parent_(parent)
+{
+    live_count_().fetch_add(1, std::memory_order_relaxed);
+}
+
+SPDLOG_INLINE tail_buffer::~tail_buffer()
+{
+    live_count_().fetch_sub(1, std::memory_order_relaxed);
+}
+
+SPDLOG_INLINE void tail_buffer::push_back(logger *owner, sink_fn sink, const log_msg &msg)
+{
+    if (max_messages_ == 0)
+    {
+        dropped_++;
+        return;
+    }
+    if (messages_.size() < max_messages_)
+    {
+        if (messages_.capacity() == 0)
+        {
+            messages_.reserve(max_messages_);
+        }
+        messages_.push_back(entry{owner, sink, log_msg_buffer{msg}});
+        return;
+    }
+    // full: overwrite the oldest
+    auto &slot = messages_[head_];
+    slot.owner = owner;
+    slot.sink = sink;
+    slot.msg = log_msg_buffer{msg};
+    head_ = (head_ + 1) % max_messages_;
+    dropped_++;
+}
+
+SPDLOG_INLINE void tail_buffer::promote()
+{
+    if (parent_ != nullptr)
+    {
+        parent_->promote();
+    }
+    promoted_ = true;
+    // move out first: a sink may log on this thread while we flush.
+    std::vector<entry> messages;
+    messages.swap(messages_);
+    auto head = head_;
+    head_ = 0;
+    for (size_t i = 0; i < messages.size(); i++)
+    {
+        auto &e = messages[(head + i) % messages.size()];
+        e.sink(e.owner, e.msg);
+    }
+}
+
+SPDLOG_INLINE void tail_buffer::discard()
+{
+    messages_.clear();
+    head_ = 0;
+}
+
+SPDLOG_INLINE tail_buffer *&threadlocal_tail_buffer()
+{
+    thread_local tail_buffer *current = nullptr;
+    return current;
+}
+
+} // namespace details
+} // namespace spdlog
+
+#endif // SPDLOG_NO_STRUCTURED_SPDLOG
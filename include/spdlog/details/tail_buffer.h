@@ -0,0 +1,118 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+#ifndef SPDLOG_NO_STRUCTURED_SPDLOG
+
+#    include <spdlog/common.h>
+#    include <spdlog/details/log_msg_buffer.h>
+
+#    include <atomic>
+#    include <vector>
+
+// Per thread buffer of the messages logged below their logger level while a
+// spdlog::tail_sampling_context is alive (see structured_spdlog.h).
+// Only the owning thread touches it, so no locking is needed.
+
+namespace spdlog {
+class logger;
+
+namespace details {
+class tail_buffer;
+
+// active tail buffer of the current thread or nullptr
+SPDLOG_API tail_buffer *&threadlocal_tail_buffer();
+
+class SPDLOG_API tail_buffer
+{
+public:
+    tail_buffer(size_t max_messages, level::level_enum capture_level, level::level_enum trigger_level, tail_buffer *parent);
+    ~tail_buffer();
+    tail_buffer(const tail_buffer &) = delete;
+    tail_buffer &operator=(const tail_buffer &) = delete;
+
+    // active tail buffer of the current thread or nullptr.
+    // skips the thread local lookup while no tail buffer is alive in the process.
+    static tail_buffer *current()
+    {
+        return live_count_().load(std::memory_order_relaxed) != 0 ? threadlocal_tail_buffer() : nullptr;
+    }
+
+    bool should_capture(level::level_enum lvl) const
+    {
+        return lvl >= capture_level_;
+    }
+
+    bool should_trigger(level::level_enum lvl) const
+    {
+        return lvl >= trigger_level_;
+    }
+
+    bool promoted() const
+    {
+        return promoted_;
+    }
+
+    size_t size() const
+    {
+        return messages_.size();
+    }
+
+    // number of messages lost because the buffer was full
+    size_t dropped() const
+    {
+        return dropped_;
+    }
+
+    tail_buffer *parent() const
+    {
+        return parent_;
+    }
+
+    // sends a promoted message to the sinks of its logger
+    using sink_fn = void (*)(logger *owner, const log_msg &msg);
+
+    void push_back(logger *owner, sink_fn sink, const log_msg &msg);
+
+    // send the buffered messages (the enclosing buffers first) to the sinks of their loggers.
+    // from now on messages at capture level or above are sent directly.
+    void promote();
+
+    // drop the buffered messages
+    void discard();
+
+private:
+    struct entry
+    {
+        logger *owner;
+        sink_fn sink;
+        log_msg_buffer msg;
+    };
+
+    // number of tail buffers alive in the process
+    static std::atomic<size_t> &live_count_()
+    {
+        static std::atomic<size_t> count{0};
+        return count;
+    }
+
+    size_t max_messages_;
+    level::level_enum capture_level_;
+    level::level_enum trigger_level_;
+    tail_buffer *parent_;
+    bool promoted_ = false;
+    size_t dropped_ = 0;
+    // ring of the captured messages, allocated on the first capture. the oldest is at head_.
+    std::vector<entry> messages_;
+    size_t head_ = 0;
+};
+
+} // namespace details
+} // namespace spdlog
+
+#    ifdef SPDLOG_HEADER_ONLY
+#        include "tail_buffer-inl.h"
+#    endif
+
+#endif // SPDLOG_NO_STRUCTURED_SPDLOG
@@ -8,27 +8,151 @@
 #endif
 
 #include <spdlog/common.h>
+#include <spdlog/details/fmt_helper.h>
+#include <spdlog/details/msg_record.h>
+#include <algorithm>
 #include <cassert>
+#include <new>
 
 namespace spdlog {
 namespace details {
 
-SPDLOG_INLINE thread_pool::thread_pool(size_t q_max_items, size_t threads_n, std::function<void()> on_thread_start, std::function<void()> on_thread_stop)
-    : q_(q_max_items)
+// start of a byte_ring record. log messages are followed by their msg_record, but for the ones
+// too large for the ring: they are buffered on the heap instead (heap_msg, owned by the record).
+struct async_record
 {
-    if (threads_n == 0 || threads_n > 1000)
+    async_logger *worker_ptr;
+    async_msg_type msg_type;
+    uint32_t generation;
+    log_msg_buffer *heap_msg;
+};
+
+static const size_t async_record_size = (sizeof(async_record) + 7) & ~size_t{7};
+
+// a worker thread stops its batch at these: the messages behind belong to the other worker threads
+inline bool ends_batch(async_msg_type msg_type)
+{
+    return msg_type == async_msg_type::terminate || msg_type == async_msg_type::retire;
+}
+
+// posts the messages of the loggers (msg: the log message, null for the others) and the pool's own
+// control messages, one for each worker thread i
+class thread_pool::front_end
+{
+public:
+    explicit front_end(thread_pool &pool)
+        : pool_(pool)
+    {}
+    virtual ~front_end() = default;
+    front_end(const front_end &) = delete;
+    front_end &operator=(const front_end &) = delete;
+
+    virtual bool post(async_logger *worker_ptr, async_msg_type msg_type, const log_msg *msg, async_overflow_policy overflow_policy,
+        uint32_t generation) = 0;
+    virtual bool post_control(size_t i, async_msg_type msg_type, async_overflow_policy overflow_policy, uint32_t generation) = 0;
+
+protected:
+    static async_msg make_msg_(async_logger *worker_ptr, async_msg_type msg_type, const log_msg *msg, uint32_t generation)
     {
-        throw_spdlog_ex("spdlog::thread_pool(): invalid threads_n param (valid "
-                        "range is 1-1000)");
+        async_msg new_msg = msg != nullptr ? async_msg(worker_ptr, msg_type, *msg) : async_msg(worker_ptr, msg_type);
+        new_msg.generation = generation;
+        return new_msg;
+    }
+
+    thread_pool &pool_;
+};
+
+class thread_pool::queue_front_end final : public thread_pool::front_end
+{
+public:
+    using front_end::front_end;
+
+    bool post(async_logger *worker_ptr, async_msg_type msg_type, const log_msg *msg, async_overflow_policy overflow_policy,
+        uint32_t generation) override
+    {
+        return pool_.post_async_msg_(*pool_.q_, make_msg_(worker_ptr, msg_type, msg, generation), overflow_policy);
     }
-    for (size_t i = 0; i < threads_n; i++)
+
+    bool post_control(size_t, async_msg_type msg_type, async_overflow_policy overflow_policy, uint32_t generation) override
     {
-        threads_.emplace_back([this, on_thread_start, on_thread_stop] {
-            on_thread_start();
-            this->thread_pool::worker_loop_();
-            on_thread_stop();
-        });
+        return pool_.post_async_msg_(*pool_.q_, make_msg_(nullptr, msg_type, nullptr, generation), overflow_policy);
+    }
+};
+
+class thread_pool::sharded_front_end final : public thread_pool::front_end
+{
+public:
+    using front_end::front_end;
+
+    bool post(async_logger *worker_ptr, async_msg_type msg_type, const log_msg *msg, async_overflow_policy overflow_policy,
+        uint32_t generation) override
+    {
+        auto new_msg = make_msg_(worker_ptr, msg_type, msg, generation);
+        auto &slot = pool_.posting_.local([] { return new posting_slot(); });
+        for (;;)
+        {
+            auto sequence = slot.sequence.load(std::memory_order_relaxed);
+            slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+            // pairs with the fence in move_(): either it waits for this post or we see the logger moving
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            auto index = worker_ptr->shard_.index.load(std::memory_order_acquire);
+            if (index < pool_.shards_.size())
+            {
+                auto queued = pool_.post_async_msg_(*pool_.shards_[index], std::move(new_msg), overflow_policy);
+                slot.sequence.store(sequence + 2, std::memory_order_release);
+                return queued;
+            }
+            slot.sequence.store(sequence + 2, std::memory_order_release);
+            if (index == async_shard::unassigned)
+            {
+                pool_.assign_shard_(worker_ptr);
+            }
+            else
+            {
+                std::this_thread::yield(); // moving
+            }
+        }
+    }
+
+    bool post_control(size_t i, async_msg_type msg_type, async_overflow_policy overflow_policy, uint32_t generation) override
+    {
+        auto &shard = *pool_.shards_[i % pool_.shards_.size()];
+        return pool_.post_async_msg_(shard, make_msg_(nullptr, msg_type, nullptr, generation), overflow_policy);
     }
+};
+
+class thread_pool::record_front_end final : public thread_pool::front_end
+{
+public:
+    using front_end::front_end;
+
+    bool post(async_logger *worker_ptr, async_msg_type msg_type, const log_msg *msg, async_overflow_policy overflow_policy,
+        uint32_t generation) override
+    {
+        return pool_.post_record_(msg_type, worker_ptr, msg, overflow_policy, generation);
+    }
+
+    bool post_control(size_t, async_msg_type msg_type, async_overflow_policy overflow_policy, uint32_t generation) override
+    {
+        return pool_.post_record_(msg_type, nullptr, nullptr, overflow_policy, generation);
+    }
+};
+
+SPDLOG_INLINE thread_pool::thread_pool(const thread_pool_options &options)
+    : topology_(options.topology)
+{
+    start_(options);
+}
+
+SPDLOG_INLINE thread_pool::thread_pool(size_t q_max_items, size_t threads_n, std::function<void()> on_thread_start, std::function<void()> on_thread_stop)
+    : topology_(async_queue_topology::shared)
+{
+    thread_pool_options options;
+    options.queue_size = q_max_items;
+    options.threads = threads_n;
+    options.on_thread_start = std::move(on_thread_start);
+    options.on_thread_stop = std::move(on_thread_stop);
+    start_(options);
 }
 
 SPDLOG_INLINE thread_pool::thread_pool(size_t q_max_items, size_t threads_n, std::function<void()> on_thread_start)
@@ -44,11 +168,27 @@ SPDLOG_INLINE thread_pool::~thread_pool()
 {
     SPDLOG_TRY
     {
-        for (size_t i = 0; i < threads_.size(); i++)
+        rebalancer_.reset();
+        {
+            std::lock_guard<std::mutex> lock(retired_mutex_);
+            retirer_stop_ = true;
+        }
+        retired_cv_.notify_all();
+        if (retirer_.joinable())
         {
-            post_async_msg_(async_msg(async_msg_type::terminate), async_overflow_policy::block);
+            retirer_.join();
+        }
+        // format_threads: each format thread ends at one, the worker thread once it wrote them all
+        auto terminates = format_threads_n_ > 0 ? format_threads_n_ : threads_.size();
+        for (size_t i = 0; i < terminates; i++)
+        {
+            front_->post_control(i, async_msg_type::terminate, async_overflow_policy::block, 0);
         }
 
+        for (auto &t : format_threads_)
+        {
+            t.join();
+        }
         for (auto &t : threads_)
         {
             t.join();
@@ -57,77 +197,1682 @@ SPDLOG_INLINE thread_pool::~thread_pool()
     SPDLOG_CATCH_STD
 }
 
-void SPDLOG_INLINE thread_pool::post_log(async_logger_ptr &&worker_ptr, const details::log_msg &msg, async_overflow_policy overflow_policy)
+void SPDLOG_INLINE thread_pool::post_log(async_logger *worker_ptr, const details::log_msg &msg, async_overflow_policy overflow_policy)
+{
+    if (msg.level < shed_level_->load(std::memory_order_relaxed))
+    {
+        count_drop_(worker_ptr, msg.level);
+        return;
+    }
+    if (retired_n_.load(std::memory_order_relaxed) != 0)
+    {
+        wait_retired_(worker_ptr);
+    }
+    bool queued;
+    if (priority_q_ && msg.level >= priority_level_ && worker_ptr->priority_lane())
+    {
+        queued = post_async_msg_(*priority_q_, async_msg(worker_ptr, async_msg_type::log, msg), overflow_policy);
+    }
+    else
+    {
+        queued = front_->post(worker_ptr, async_msg_type::log, &msg, overflow_policy, 0);
+    }
+    if (!queued && overflow_policy == async_overflow_policy::discard_new)
+    {
+        count_drop_(worker_ptr, msg.level);
+    }
+}
+
+void SPDLOG_INLINE thread_pool::post_flush(async_logger *worker_ptr, async_overflow_policy overflow_policy)
+{
+    if (retired_n_.load(std::memory_order_relaxed) != 0)
+    {
+        wait_retired_(worker_ptr);
+    }
+    front_->post(worker_ptr, async_msg_type::flush, nullptr, overflow_policy, 0);
+}
+
+void SPDLOG_INLINE thread_pool::post_flush(async_logger *worker_ptr, std::function<void()> on_flushed)
+{
+    // the other worker threads may still hold earlier messages of the logger
+    if (topology_ == async_queue_topology::shared && threads_.size() > 1)
+    {
+        flush_barrier(std::move(on_flushed));
+        return;
+    }
+    uint32_t ticket;
+    {
+        std::lock_guard<std::mutex> lock(flush_mutex_);
+        ticket = ++flush_ticket_ != 0 ? flush_ticket_ : ++flush_ticket_;
+        flush_callbacks_.emplace_back(ticket, std::move(on_flushed));
+    }
+    // blocking: someone waits for it
+    front_->post(worker_ptr, async_msg_type::flush, nullptr, async_overflow_policy::block, ticket);
+}
+
+void SPDLOG_INLINE thread_pool::flush_barrier(std::function<void()> on_flushed)
+{
+    std::lock_guard<std::mutex> serial(retire_mutex_);
+    std::unique_lock<std::mutex> lock(barrier_mutex_);
+    open_barrier_(lock, std::move(on_flushed));
+}
+
+std::future<void> SPDLOG_INLINE thread_pool::flush_barrier()
+{
+    auto flushed = std::make_shared<std::promise<void>>();
+    auto future = flushed->get_future();
+    flush_barrier([flushed] { flushed->set_value(); });
+    return future;
+}
+
+// every worker thread takes one retire message, after all the messages posted before it, and waits
+// there for the others: once they all arrived, no worker thread holds an earlier message anymore.
+void SPDLOG_INLINE thread_pool::retire_barrier()
+{
+    std::lock_guard<std::mutex> serial(retire_mutex_);
+    std::unique_lock<std::mutex> lock(barrier_mutex_);
+    auto generation = open_barrier_(lock, nullptr);
+    wait_barrier_(lock, generation);
+}
+
+uint32_t SPDLOG_INLINE thread_pool::open_barrier_(std::unique_lock<std::mutex> &lock, std::function<void()> on_flushed)
+{
+    // a flush barrier may still be in progress
+    if (barrier_generation_ != 0)
+    {
+        wait_barrier_(lock, barrier_generation_);
+    }
+    auto generation = ++barrier_generation_;
+    barrier_arrived_ = 0;
+    barrier_flushed_ = std::move(on_flushed);
+    lock.unlock();
+    auto overruns = overrun_counter();
+    post_retire_(generation, threads_.size());
+    lock.lock();
+    barrier_overruns_ = overruns;
+    return generation;
+}
+
+void SPDLOG_INLINE thread_pool::wait_barrier_(std::unique_lock<std::mutex> &lock, uint32_t generation)
+{
+    while (!barrier_cv_.wait_for(lock, std::chrono::milliseconds(100), [this] { return barrier_arrived_ == threads_.size(); }))
+    {
+        // overrun_oldest may have dropped some of them: post the missing ones again (extra ones are ignored).
+        // sharded: which shards miss one is unknown, so all get one.
+        auto current_overruns = overrun_counter();
+        if (current_overruns != barrier_overruns_)
+        {
+            barrier_overruns_ = current_overruns;
+            auto missing = shards_.empty() ? threads_.size() - barrier_arrived_ : shards_.size();
+            lock.unlock();
+            post_retire_(generation, missing);
+            lock.lock();
+        }
+    }
+}
+
+SPDLOG_INLINE void thread_pool::retire(async_logger *worker_ptr)
 {
-    async_msg async_m(std::move(worker_ptr), async_msg_type::log, msg);
-    post_async_msg_(std::move(async_m), overflow_policy);
+    // the worker threads may wait for this one
+    bool on_pool_thread = this_thread_().pool == this;
+    if (on_pool_thread)
+    {
+        retire_later_(worker_ptr);
+    }
+    if (!shards_.empty())
+    {
+        std::lock_guard<std::mutex> lock(shard_mutex_);
+        sharded_loggers_.erase(std::remove_if(sharded_loggers_.begin(), sharded_loggers_.end(),
+                                   [worker_ptr](const sharded_logger &entry) { return entry.logger == worker_ptr; }),
+            sharded_loggers_.end());
+    }
+    bool dropped;
+    {
+        std::lock_guard<std::mutex> lock(drops_mutex_);
+        auto it = std::find(dropping_.begin(), dropping_.end(), worker_ptr);
+        dropped = it != dropping_.end();
+        if (dropped)
+        {
+            dropping_.erase(it);
+        }
+    }
+    if (!on_pool_thread)
+    {
+        retire_barrier();
+    }
+    {
+        // no more writes of the logger: forget it (after any flush barrier running)
+        std::lock_guard<std::mutex> lock(unflushed_mutex_);
+        unflushed_.erase(std::remove(unflushed_.begin(), unflushed_.end(), worker_ptr), unflushed_.end());
+    }
+    if (dropped)
+    {
+        report_drops_of_(worker_ptr);
+    }
 }
 
-void SPDLOG_INLINE thread_pool::post_flush(async_logger_ptr &&worker_ptr, async_overflow_policy overflow_policy)
+SPDLOG_INLINE bool thread_pool::rebalance()
 {
-    post_async_msg_(async_msg(std::move(worker_ptr), async_msg_type::flush), overflow_policy);
+    if (shards_.size() < 2)
+    {
+        return false;
+    }
+    std::lock_guard<std::mutex> serial(retire_mutex_);
+    size_t hot = 0;
+    size_t cold = 0;
+    std::vector<size_t> sizes(shards_.size());
+    for (size_t i = 0; i < shards_.size(); i++)
+    {
+        sizes[i] = shards_[i]->size();
+        hot = sizes[i] > sizes[hot] ? i : hot;
+        cold = sizes[i] < sizes[cold] ? i : cold;
+    }
+    if (sizes[hot] <= 2 * sizes[cold] + max_batch_)
+    {
+        return false;
+    }
+
+    async_logger *moved = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(shard_mutex_);
+        // the logger of the hot shard with the most messages processed since the last time.
+        // a logger alone in its shard stays: moving it would only move the load.
+        sharded_logger *busiest = nullptr;
+        size_t busiest_load = 0;
+        size_t on_hot = 0;
+        for (auto &entry : sharded_loggers_)
+        {
+            auto processed = entry.logger->shard_.processed.load(std::memory_order_relaxed);
+            auto load = processed - entry.last_processed;
+            entry.last_processed = processed;
+            if (entry.shard == hot)
+            {
+                on_hot++;
+                if (busiest == nullptr || load > busiest_load)
+                {
+                    busiest = &entry;
+                    busiest_load = load;
+                }
+            }
+        }
+        if (on_hot < 2)
+        {
+            return false;
+        }
+        busiest->shard = cold;
+        moved = busiest->logger;
+    }
+    move_(moved, hot, cold);
+    return true;
 }
 
 size_t SPDLOG_INLINE thread_pool::overrun_counter()
 {
-    return q_.overrun_counter();
+    size_t total = records_overrun_.load(std::memory_order_relaxed);
+    if (records_)
+    {
+        return total + ring_full_drops_.load(std::memory_order_relaxed);
+    }
+    total += overruns_.load(std::memory_order_relaxed);
+    if (priority_q_)
+    {
+        total += priority_q_->overrun_counter();
+    }
+    if (q_)
+    {
+        return total + q_->overrun_counter();
+    }
+    for (auto &shard : shards_)
+    {
+        total += shard->overrun_counter();
+    }
+    return total;
 }
 
 size_t SPDLOG_INLINE thread_pool::queue_size()
 {
-    return q_.size();
+    if (records_)
+    {
+        return records_->size();
+    }
+    if (q_)
+    {
+        return q_->size();
+    }
+    size_t total = 0;
+    for (auto &shard : shards_)
+    {
+        total += shard->size();
+    }
+    return total;
 }
 
-void SPDLOG_INLINE thread_pool::post_async_msg_(async_msg &&new_msg, async_overflow_policy overflow_policy)
+// pinned worker threads start in two steps: each one pins itself and the first one allocates the queue
+// (the memory goes to the NUMA node of the thread touching it first), then they all wait for start_()
+// to check that every one of them succeeded.
+struct worker_startup
 {
-    if (overflow_policy == async_overflow_policy::block)
+    explicit worker_startup(const thread_pool_options &opts)
+        : options(opts)
+    {}
+
+    thread_pool_options options;
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t ready = 0;
+    bool failed = false;
+    bool released = false;
+};
+
+void SPDLOG_INLINE thread_pool::start_(const thread_pool_options &options)
+{
+    auto threads_n = options.threads;
+    if (threads_n == 0 || threads_n > 1000)
     {
-        q_.enqueue(std::move(new_msg));
+        throw_spdlog_ex("spdlog::thread_pool(): invalid threads_n param (valid "
+                        "range is 1-1000)");
     }
-    else
+    // per_thread: the rings are merged by a single consumer.
+    // byte_ring: records are released in order, by their only reader.
+    if (options.topology == async_queue_topology::per_thread && threads_n != 1)
+    {
+        throw_spdlog_ex("spdlog::thread_pool(): the per_thread queue topology needs exactly one worker thread");
+    }
+    if (options.topology == async_queue_topology::byte_ring && threads_n != 1)
+    {
+        throw_spdlog_ex("spdlog::thread_pool(): the byte_ring queue topology needs exactly one worker thread");
+    }
+    // format_threads: the formatted batches are written in order by a single worker thread
+    if (options.format_threads > 1000)
+    {
+        throw_spdlog_ex("spdlog::thread_pool(): invalid format_threads param (valid range is 0-1000)");
+    }
+    if (options.format_threads > 0 && (options.topology != async_queue_topology::shared || threads_n != 1))
+    {
+        throw_spdlog_ex("spdlog::thread_pool(): format threads need the shared queue topology and exactly one worker thread");
+    }
+    if (options.format_threads > 0 && options.priority_level != level::off)
+    {
+        throw_spdlog_ex("spdlog::thread_pool(): format threads keep a single order, they can't have a priority lane");
+    }
+    // priority lane: a single worker thread drains it, or a logger's lane messages would run beside its other
+    // ones (on another worker thread, out of order)
+    if (options.priority_level != level::off && threads_n != 1)
+    {
+        throw_spdlog_ex("spdlog::thread_pool(): a priority lane needs exactly one worker thread");
+    }
+    // spill: the spilled messages are read back in order, by the only worker thread
+    if (!options.spill_path.empty() &&
+        (options.topology != async_queue_topology::shared || threads_n != 1 || options.format_threads > 0 || options.priority_level != level::off))
+    {
+        throw_spdlog_ex("spdlog::thread_pool(): a spill file needs the shared queue topology and exactly one worker thread, "
+                        "without format threads nor priority lane");
+    }
+    for (size_t i = 0; i < options.load_shedding.size(); i++)
+    {
+        auto &step = options.load_shedding[i];
+        bool ordered = i == 0 || (step.high > options.load_shedding[i - 1].high && step.level >= options.load_shedding[i - 1].level);
+        if (step.low > step.high || !ordered)
+        {
+            throw_spdlog_ex("spdlog::thread_pool(): invalid load_shedding steps (low <= high, by increasing high and level)");
+        }
+    }
+
+    max_batch_ = options.max_batch > 0 ? options.max_batch : 1;
+    wait_strategy_ = options.wait_strategy;
+    spin_budget_ = options.spin_budget;
+    batch_window_ = options.batch_window;
+    drop_report_interval_ = options.drop_report_interval;
+    priority_level_ = options.priority_level;
+    shed_steps_ = options.load_shedding;
+    on_load_shedding_ = options.on_load_shedding;
+    format_threads_n_ = options.format_threads;
+    if (threads_n + format_threads_n_ > 1)
+    {
+        in_flight_n_ = threads_n + format_threads_n_;
+        in_flight_.reset(new std::atomic<async_logger *>[in_flight_n_]);
+        for (size_t i = 0; i < in_flight_n_; i++)
+        {
+            in_flight_[i].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+    reorder_.resize(2 * format_threads_n_);
+    for (auto &slot : reorder_)
+    {
+        slot.msgs.resize(max_batch_);
+        slot.outputs.reset(new output_cache[max_batch_]);
+    }
+    std::function<void()> on_thread_start = options.on_thread_start ? options.on_thread_start : [] {};
+    std::function<void()> on_thread_stop = options.on_thread_stop ? options.on_thread_stop : [] {};
+    if (options.worker_cpus.empty())
+    {
+        create_queue_(options);
+        for (size_t i = 0; i < threads_n; i++)
+        {
+            threads_.emplace_back([this, i, on_thread_start, on_thread_stop] {
+                this->enter_thread_(i);
+                on_thread_start();
+                this->thread_pool::worker_loop_(i);
+                on_thread_stop();
+            });
+        }
+        start_format_threads_(on_thread_start, on_thread_stop);
+        start_rebalancer_(options);
+        return;
+    }
+
+    auto startup = std::make_shared<worker_startup>(options);
+#ifndef SPDLOG_NO_EXCEPTIONS
+    try
+#endif
+    {
+        for (size_t i = 0; i < threads_n; i++)
+        {
+            auto cpu = options.worker_cpus[i % options.worker_cpus.size()];
+            threads_.emplace_back([this, i, cpu, startup, on_thread_start, on_thread_stop] {
+                this->enter_thread_(i);
+                bool ok = os::set_thread_affinity(cpu);
+                if (ok && i == 0)
+                {
+                    SPDLOG_TRY
+                    {
+                        this->create_queue_(startup->options);
+                    }
+                    SPDLOG_CATCH_STD
+                    ok = this->q_ || this->records_ || !this->shards_.empty();
+                }
+                {
+                    std::unique_lock<std::mutex> lock(startup->mutex);
+                    startup->failed = startup->failed || !ok;
+                    startup->ready++;
+                    startup->cv.notify_all();
+                    startup->cv.wait(lock, [&startup] { return startup->released; });
+                    if (startup->failed)
+                    {
+                        return;
+                    }
+                }
+                on_thread_start();
+                this->thread_pool::worker_loop_(i);
+                on_thread_stop();
+            });
+        }
+    }
+#ifndef SPDLOG_NO_EXCEPTIONS
+    catch (...)
+    {
+        // a thread could not be created: let the started ones go (they see the failure) before rethrowing,
+        // or they would wait at the gate forever and their std::thread would terminate the process.
+        {
+            std::lock_guard<std::mutex> lock(startup->mutex);
+            startup->failed = true;
+            startup->released = true;
+        }
+        startup->cv.notify_all();
+        for (auto &t : threads_)
+        {
+            t.join();
+        }
+        threads_.clear();
+        throw;
+    }
+#endif
+
+    bool failed;
     {
-        q_.enqueue_nowait(std::move(new_msg));
+        std::unique_lock<std::mutex> lock(startup->mutex);
+        startup->cv.wait(lock, [&startup, threads_n] { return startup->ready == threads_n; });
+        startup->released = true;
+        failed = startup->failed;
+        startup->cv.notify_all();
+    }
+    if (failed)
+    {
+        for (auto &t : threads_)
+        {
+            t.join();
+        }
+        threads_.clear();
+        throw_spdlog_ex("spdlog::thread_pool(): cannot start the worker threads on the given cpus");
     }
+    start_format_threads_(on_thread_start, on_thread_stop);
+    start_rebalancer_(options);
 }
 
-void SPDLOG_INLINE thread_pool::worker_loop_()
+void SPDLOG_INLINE thread_pool::start_format_threads_(const std::function<void()> &on_thread_start, const std::function<void()> &on_thread_stop)
 {
-    while (process_next_msg_()) {}
+    for (size_t i = 0; i < format_threads_n_; i++)
+    {
+        format_threads_.emplace_back([this, i, on_thread_start, on_thread_stop] {
+            this->enter_thread_(threads_.size() + i);
+            on_thread_start();
+            this->thread_pool::format_loop_();
+            on_thread_stop();
+        });
+    }
 }
 
-// process next message in the queue
-// return true if this thread should still be active (while no terminate msg
-// was received)
-bool SPDLOG_INLINE thread_pool::process_next_msg_()
+void SPDLOG_INLINE thread_pool::start_rebalancer_(const thread_pool_options &options)
 {
-    async_msg incoming_async_msg;
-    bool dequeued = q_.dequeue_for(incoming_async_msg, std::chrono::seconds(10));
-    if (!dequeued)
+    if (!shards_.empty() && options.rebalance_interval > std::chrono::seconds::zero())
     {
-        return true;
+        rebalancer_ = details::make_unique<periodic_worker>([this] { this->rebalance(); }, options.rebalance_interval);
     }
+}
 
-    switch (incoming_async_msg.msg_type)
+void SPDLOG_INLINE thread_pool::create_queue_(const thread_pool_options &options)
+{
+    if (options.priority_level != level::off)
     {
-    case async_msg_type::log: {
-        incoming_async_msg.worker_ptr->backend_sink_it_(incoming_async_msg);
-        return true;
+        priority_q_ = details::make_unique<async_queue_impl<mpmc_ring_queue<async_msg>>>(options.priority_queue_size);
     }
-    case async_msg_type::flush: {
-        incoming_async_msg.worker_ptr->backend_flush_();
-        return true;
+    if (options.topology == async_queue_topology::per_thread)
+    {
+        q_ = details::make_unique<async_queue_impl<spsc_merge_queue<async_msg>>>(options.per_thread_queue_size);
     }
-
-    case async_msg_type::terminate: {
-        return false;
+    else if (options.topology == async_queue_topology::byte_ring)
+    {
+        records_ = details::make_unique<mpsc_byte_ring>(options.queue_bytes);
+    }
+    else if (options.topology == async_queue_topology::sharded)
+    {
+        for (size_t i = 0; i < options.threads; i++)
+        {
+            shards_.push_back(details::make_unique<async_queue_impl<mpmc_ring_queue<async_msg>>>(options.queue_size));
+        }
+    }
+    else
+    {
+        q_ = details::make_unique<async_queue_impl<mpmc_ring_queue<async_msg>>>(options.queue_size);
+    }
+    if (!options.spill_path.empty())
+    {
+        spill_ = details::make_unique<spill_file>(options.spill_path, options.spill_segment_size, options.spill_budget);
+        spill_fields_.resize(max_batch_);
+    }
+    if (records_)
+    {
+        front_ = details::make_unique<record_front_end>(*this);
+    }
+    else if (!shards_.empty())
+    {
+        front_ = details::make_unique<sharded_front_end>(*this);
+    }
+    else
+    {
+        front_ = details::make_unique<queue_front_end>(*this);
     }
+}
 
-    default: {
-        assert(false);
+bool SPDLOG_INLINE thread_pool::post_async_msg_(async_queue &q, async_msg &&new_msg, async_overflow_policy overflow_policy)
+{
+    bool queued = true;
+    if (spill_ && spilling_.load(std::memory_order_acquire))
+    {
+        // behind the messages already spilled
+        queued = spill_msg_(q, std::move(new_msg));
+    }
+    else if (spill_ && overflow_policy == async_overflow_policy::spill)
+    {
+        queued = post_spilling_(q, std::move(new_msg));
     }
+    else
+    {
+        switch (overflow_policy)
+        {
+        case async_overflow_policy::discard_new:
+            queued = post_discarding_(q, std::move(new_msg));
+            break;
+        case async_overflow_policy::overrun_oldest:
+            queued = post_overrunning_(q, std::move(new_msg));
+            break;
+        default: // block, and spill without a spill file
+            post_blocking_(q, std::move(new_msg));
+            break;
+        }
     }
+    wake_workers_();
+    return queued;
+}
 
-    return true;
+void SPDLOG_INLINE thread_pool::post_blocking_(async_queue &q, async_msg &&new_msg)
+{
+    q.enqueue(std::move(new_msg));
+}
+
+// the drops are counted by logger instead
+bool SPDLOG_INLINE thread_pool::post_discarding_(async_queue &q, async_msg &&new_msg)
+{
+    return q.try_enqueue(std::move(new_msg));
+}
+
+// the overrun log messages are lost. the other ones (flush requests, barriers, terminate) go back in at
+// the end, still after the messages they follow, so nobody waits for them in vain.
+bool SPDLOG_INLINE thread_pool::post_overrunning_(async_queue &q, async_msg &&new_msg)
+{
+    async_msg oldest;
+    std::vector<async_msg> requeued;
+    auto overrun = [this, &oldest, &requeued] {
+        if (oldest.msg_type == async_msg_type::log)
+        {
+            overruns_.fetch_add(1, std::memory_order_relaxed);
+        }
+        else
+        {
+            requeued.push_back(std::move(oldest));
+        }
+    };
+    while (!q.enqueue_or_overrun(std::move(new_msg), oldest))
+    {
+        overrun();
+    }
+    for (size_t i = 0; i < requeued.size(); i++)
+    {
+        auto msg = std::move(requeued[i]);
+        while (!q.enqueue_or_overrun(std::move(msg), oldest))
+        {
+            overrun();
+        }
+    }
+    return true;
+}
+
+// what does not fit the queue goes to the spill file
+bool SPDLOG_INLINE thread_pool::post_spilling_(async_queue &q, async_msg &&new_msg)
+{
+    // a failed try_enqueue() leaves the message alone
+    if (!q.try_enqueue(std::move(new_msg)))
+    {
+        return spill_msg_(q, std::move(new_msg));
+    }
+    return true;
+}
+
+// with a priority lane (or a spill file) the worker threads wait for both at once
+void SPDLOG_INLINE thread_pool::wake_workers_()
+{
+    if (!priority_q_ && !spill_)
+    {
+        return;
+    }
+    // sharded: the message may be for any of them
+    if (shards_.empty())
+    {
+        work_waiter_.notify_one();
+    }
+    else
+    {
+        work_waiter_.notify_all();
+    }
+}
+
+void SPDLOG_INLINE thread_pool::drain_priority_lane_()
+{
+    if (!priority_q_)
+    {
+        return;
+    }
+    thread_local std::vector<async_msg> lane;
+    thread_local std::vector<log_msg> msgs;
+    lane.resize(max_batch_);
+    for (;;)
+    {
+        size_t count = 0;
+        while (count < lane.size() && priority_q_->try_dequeue(lane[count]))
+        {
+            count++;
+        }
+        if (count == 0)
+        {
+            return;
+        }
+        process_batch_(lane, count, msgs);
+    }
+}
+
+// a new logger goes to the shard with the fewest loggers
+void SPDLOG_INLINE thread_pool::assign_shard_(async_logger *worker_ptr)
+{
+    std::lock_guard<std::mutex> lock(shard_mutex_);
+    if (worker_ptr->shard_.index.load(std::memory_order_relaxed) != async_shard::unassigned)
+    {
+        return;
+    }
+    std::vector<size_t> loggers(shards_.size());
+    for (auto &entry : sharded_loggers_)
+    {
+        loggers[entry.shard]++;
+    }
+    auto shard = static_cast<size_t>(std::min_element(loggers.begin(), loggers.end()) - loggers.begin());
+    sharded_loggers_.push_back(sharded_logger{worker_ptr, shard, 0});
+    worker_ptr->shard_.index.store(static_cast<uint32_t>(shard), std::memory_order_release);
+}
+
+// the logger waits (as moving) until the posts that may have read its old shard are done, then a handoff
+// message goes behind its last message in the old shard and an await_handoff message in the new one,
+// before its new messages: the worker thread of the new shard waits there until the handoff is reached.
+void SPDLOG_INLINE thread_pool::move_(async_logger *worker_ptr, size_t from, size_t to)
+{
+    worker_ptr->shard_.index.store(async_shard::moving, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    for (auto &slot : posting_.snapshot())
+    {
+        auto sequence = slot->sequence.load(std::memory_order_acquire);
+        while (sequence % 2 == 1 && slot->sequence.load(std::memory_order_acquire) == sequence)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    uint32_t generation;
+    {
+        std::lock_guard<std::mutex> lock(barrier_mutex_);
+        generation = ++handoff_generation_;
+        handoff_pending_ = generation;
+    }
+    auto overruns = shards_[from]->overrun_counter();
+    async_msg handoff_msg(async_msg_type::handoff);
+    handoff_msg.generation = generation;
+    post_async_msg_(*shards_[from], std::move(handoff_msg), async_overflow_policy::block);
+    async_msg await_msg(async_msg_type::await_handoff);
+    await_msg.generation = generation;
+    post_async_msg_(*shards_[to], std::move(await_msg), async_overflow_policy::block);
+    worker_ptr->shard_.index.store(static_cast<uint32_t>(to), std::memory_order_release);
+
+    std::unique_lock<std::mutex> lock(barrier_mutex_);
+    while (!barrier_cv_.wait_for(lock, std::chrono::milliseconds(100), [this, generation] { return handoff_pending_ != generation; }))
+    {
+        // overrun_oldest may have dropped it: post it again
+        auto current_overruns = shards_[from]->overrun_counter();
+        if (current_overruns != overruns)
+        {
+            overruns = current_overruns;
+            lock.unlock();
+            async_msg again(async_msg_type::handoff);
+            again.generation = generation;
+            post_async_msg_(*shards_[from], std::move(again), async_overflow_policy::block);
+            lock.lock();
+        }
+    }
+}
+
+bool SPDLOG_INLINE thread_pool::post_record_(
+    async_msg_type msg_type, async_logger *worker_ptr, const log_msg *msg, async_overflow_policy overflow_policy, uint32_t generation)
+{
+    // discard_new drops are counted by logger instead
+    bool count_overrun = overflow_policy != async_overflow_policy::discard_new;
+    size_t size = async_record_size;
+    std::unique_ptr<log_msg_buffer> heap_msg;
+    if (msg != nullptr)
+    {
+        auto msg_size = msg_record::encoded_size(*msg);
+        if (msg_size > records_->max_record_size() - async_record_size)
+        {
+            heap_msg.reset(new log_msg_buffer(*msg));
+        }
+        else
+        {
+            size += msg_size;
+        }
+    }
+
+    // a full ring can't be overrun by the producers: overrun_oldest drops the new message
+    bool blocking = overflow_policy == async_overflow_policy::block || overflow_policy == async_overflow_policy::spill;
+    auto *record = blocking ? records_->reserve(size) : records_->try_reserve(size);
+    if (record == nullptr)
+    {
+        if (count_overrun)
+        {
+            ring_full_drops_.fetch_add(1, std::memory_order_relaxed);
+        }
+        return false;
+    }
+    new (record) async_record{worker_ptr, msg_type, generation, heap_msg.release()};
+    if (msg != nullptr && size > async_record_size)
+    {
+        msg_record::encode_to(*msg, record + async_record_size);
+    }
+    records_->commit(record);
+    wake_workers_();
+    return true;
+}
+
+bool SPDLOG_INLINE thread_pool::spill_msg_(async_queue &q, async_msg &&msg)
+{
+    // same record as in the byte_ring
+    size_t size = async_record_size;
+    if (msg.msg_type == async_msg_type::log)
+    {
+        size += msg_record::encoded_size(msg);
+    }
+    if (size > spill_->max_record_size())
+    {
+        // too large for a segment: queue it behind the spilled messages instead
+        {
+            std::unique_lock<std::mutex> lock(spill_mutex_);
+            spill_room_.wait(lock, [this] { return !spilling_.load(std::memory_order_relaxed); });
+        }
+        post_blocking_(q, std::move(msg));
+        return true;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(spill_mutex_);
+        char *record = nullptr;
+        spill_room_.wait(lock, [this, size, &record] {
+            record = spill_->append(size);
+            return record != nullptr;
+        });
+        // set with the record: the worker thread may have found the spill file empty meanwhile
+        spilling_.store(true, std::memory_order_release);
+        new (record) async_record{msg.worker_ptr, msg.msg_type, msg.generation, nullptr};
+        if (msg.msg_type == async_msg_type::log)
+        {
+            msg_record::encode_to(msg, record + async_record_size);
+        }
+    }
+    wake_workers_();
+    return true;
+}
+
+void SPDLOG_INLINE thread_pool::post_retire_(uint32_t generation, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        front_->post_control(i, async_msg_type::retire, async_overflow_policy::block, generation);
+    }
+}
+
+void SPDLOG_INLINE thread_pool::update_load_shedding_()
+{
+    if (shed_steps_.empty())
+    {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(shed_mutex_, std::try_to_lock);
+    if (!lock.owns_lock())
+    {
+        return; // another worker thread is at it
+    }
+    size_t depth;
+    if (records_)
+    {
+        depth = records_->size();
+    }
+    else if (q_)
+    {
+        depth = q_->approx_size();
+    }
+    else
+    {
+        depth = 0;
+        for (auto &shard : shards_)
+        {
+            depth += shard->approx_size();
+        }
+    }
+
+    auto step = shed_step_;
+    while (step < shed_steps_.size() && depth > shed_steps_[step].high)
+    {
+        step++;
+    }
+    while (step > 0 && depth < shed_steps_[step - 1].low)
+    {
+        step--;
+    }
+    if (step == shed_step_)
+    {
+        return;
+    }
+    shed_step_ = step;
+    auto new_level = step == 0 ? level::trace : shed_steps_[step - 1].level;
+    shed_level_->store(new_level, std::memory_order_relaxed);
+    if (on_load_shedding_)
+    {
+        SPDLOG_TRY
+        {
+            on_load_shedding_(new_level);
+        }
+        SPDLOG_CATCH_STD
+    }
+}
+
+// only the first drop since the last report of the logger takes a lock
+void SPDLOG_INLINE thread_pool::count_shed(async_logger *worker_ptr, level::level_enum lvl)
+{
+    count_drop_(worker_ptr, lvl);
+}
+
+void SPDLOG_INLINE thread_pool::count_drop_(async_logger *worker_ptr, level::level_enum lvl)
+{
+    auto &drops = worker_ptr->drops_;
+    drops.total[lvl].fetch_add(1, std::memory_order_relaxed);
+    drops.unreported[lvl].fetch_add(1);
+    if (!drops.report_pending.load() && !drops.report_pending.exchange(true))
+    {
+        std::lock_guard<std::mutex> lock(drops_mutex_);
+        dropping_.push_back(worker_ptr);
+        drops_pending_.store(true, std::memory_order_relaxed);
+    }
+}
+
+void SPDLOG_INLINE thread_pool::report_drops_()
+{
+    if (!drops_pending_.load(std::memory_order_relaxed) || queue_size() != 0)
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(drops_mutex_);
+    auto now = std::chrono::steady_clock::now();
+    if (dropping_.empty() || now - last_drop_report_ < drop_report_interval_)
+    {
+        return;
+    }
+    last_drop_report_ = now;
+    // held lock: a logger reporting its last drops in retire() waits for this
+    for (auto *worker_ptr : dropping_)
+    {
+        report_drops_of_(worker_ptr);
+    }
+    dropping_.clear();
+    drops_pending_.store(false, std::memory_order_relaxed);
+}
+
+SPDLOG_INLINE void thread_pool::report_drops_of_(async_logger *worker_ptr)
+{
+    auto &drops = worker_ptr->drops_;
+    // before taking the counts: a drop after them registers the logger again
+    drops.report_pending.store(false);
+    size_t total = 0;
+    memory_buf_t by_level;
+    for (int i = 0; i < level::n_levels; i++)
+    {
+        auto count = drops.unreported[i].exchange(0);
+        if (count == 0)
+        {
+            continue;
+        }
+        if (total != 0)
+        {
+            fmt_helper::append_string_view(", ", by_level);
+        }
+        fmt_helper::append_string_view(level::to_string_view(static_cast<level::level_enum>(i)), by_level);
+        fmt_helper::append_string_view(": ", by_level);
+        fmt_helper::append_int(count, by_level);
+        total += count;
+    }
+    if (total == 0)
+    {
+        return;
+    }
+    memory_buf_t payload;
+    fmt_helper::append_string_view("dropped ", payload);
+    fmt_helper::append_int(total, payload);
+    fmt_helper::append_string_view(" messages (", payload);
+    fmt_helper::append_string_view(string_view_t(by_level.data(), by_level.size()), payload);
+    fmt_helper::append_string_view(")", payload);
+    log_msg msg(worker_ptr->name(), level::warn, string_view_t(payload.data(), payload.size()));
+    worker_ptr->backend_sink_it_(msg);
+}
+
+void SPDLOG_INLINE thread_pool::arrive_(uint32_t generation)
+{
+    std::unique_lock<std::mutex> lock(barrier_mutex_);
+    // left over from a completed retire_barrier() call
+    if (generation != barrier_generation_ || barrier_arrived_ == threads_.size())
+    {
+        return;
+    }
+    if (++barrier_arrived_ == threads_.size())
+    {
+        // flush barrier: the other worker threads wait while the loggers are flushed
+        auto on_flushed = std::move(barrier_flushed_);
+        barrier_flushed_ = nullptr;
+        if (on_flushed)
+        {
+            std::lock_guard<std::mutex> unflushed_lock(unflushed_mutex_);
+            for (auto *worker_ptr : unflushed_)
+            {
+                worker_ptr->unflushed_.value.store(false, std::memory_order_relaxed);
+                worker_ptr->backend_flush_();
+            }
+            unflushed_.clear();
+        }
+        barrier_cv_.notify_all();
+        lock.unlock();
+        if (on_flushed)
+        {
+            SPDLOG_TRY
+            {
+                on_flushed();
+            }
+            SPDLOG_CATCH_STD
+        }
+        return;
+    }
+    barrier_cv_.wait(lock, [this, generation] { return barrier_generation_ != generation || barrier_arrived_ == threads_.size(); });
+}
+
+SPDLOG_INLINE thread_pool::pool_thread &thread_pool::this_thread_()
+{
+    thread_local pool_thread current;
+    return current;
+}
+
+void SPDLOG_INLINE thread_pool::enter_thread_(size_t slot)
+{
+    auto &current = this_thread_();
+    current.pool = this;
+    current.in_flight = slot < in_flight_n_ ? &in_flight_[slot] : nullptr;
+}
+
+bool SPDLOG_INLINE thread_pool::enter_(async_logger *worker_ptr)
+{
+    auto *in_flight = this_thread_().in_flight;
+    if (in_flight != nullptr)
+    {
+        // pairs with retire_later_(): either it waits for us or we see the logger retired
+        in_flight->store(worker_ptr, std::memory_order_seq_cst);
+    }
+    if (retired_n_.load(std::memory_order_seq_cst) == 0)
+    {
+        return true;
+    }
+    std::lock_guard<std::mutex> lock(retired_mutex_);
+    if (std::find(retired_.begin(), retired_.end(), worker_ptr) == retired_.end())
+    {
+        return true;
+    }
+    if (in_flight != nullptr)
+    {
+        in_flight->store(nullptr, std::memory_order_release);
+    }
+    return false;
+}
+
+void SPDLOG_INLINE thread_pool::leave_()
+{
+    auto *in_flight = this_thread_().in_flight;
+    if (in_flight != nullptr)
+    {
+        in_flight->store(nullptr, std::memory_order_release);
+    }
+}
+
+// the logger is gone once we return: the other threads of the pool finish what they are doing with it
+// and skip its messages from now on. the retirer thread posts the barrier the logger would have waited
+// for, and forgets it once it is passed.
+void SPDLOG_INLINE thread_pool::retire_later_(async_logger *worker_ptr)
+{
+    {
+        std::lock_guard<std::mutex> lock(retired_mutex_);
+        retired_.push_back(worker_ptr);
+        retiring_.push_back(worker_ptr);
+        retired_n_.fetch_add(1, std::memory_order_seq_cst);
+        if (!retirer_.joinable())
+        {
+            retirer_ = std::thread([this] { this->retire_loop_(); });
+        }
+    }
+    retired_cv_.notify_all();
+    auto *own = this_thread_().in_flight;
+    for (size_t i = 0; i < in_flight_n_; i++)
+    {
+        while (&in_flight_[i] != own && in_flight_[i].load(std::memory_order_seq_cst) == worker_ptr)
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void SPDLOG_INLINE thread_pool::retire_loop_()
+{
+    std::unique_lock<std::mutex> lock(retired_mutex_);
+    for (;;)
+    {
+        retired_cv_.wait(lock, [this] { return retirer_stop_ || !retiring_.empty(); });
+        if (retiring_.empty())
+        {
+            return;
+        }
+        std::vector<async_logger *> loggers;
+        loggers.swap(retiring_);
+        lock.unlock();
+        SPDLOG_TRY
+        {
+            retire_barrier();
+        }
+        SPDLOG_CATCH_STD
+        lock.lock();
+        for (auto *worker_ptr : loggers)
+        {
+            auto it = std::find(retired_.begin(), retired_.end(), worker_ptr);
+            // wait_retired_() may have forgotten it already
+            if (it != retired_.end())
+            {
+                retired_.erase(it);
+                retired_n_.fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+        retired_cv_.notify_all();
+    }
+}
+
+void SPDLOG_INLINE thread_pool::wait_retired_(async_logger *worker_ptr)
+{
+    std::unique_lock<std::mutex> lock(retired_mutex_);
+    auto it = std::find(retired_.begin(), retired_.end(), worker_ptr);
+    if (it == retired_.end())
+    {
+        return;
+    }
+    if (this_thread_().pool == this)
+    {
+        // no waiting for the worker threads here: the messages left by the old logger go to the new one
+        retired_.erase(it);
+        retired_n_.fetch_sub(1, std::memory_order_relaxed);
+        return;
+    }
+    retired_cv_.wait(lock, [this, worker_ptr] { return std::find(retired_.begin(), retired_.end(), worker_ptr) == retired_.end(); });
+}
+
+void SPDLOG_INLINE thread_pool::mark_unflushed_(async_logger *worker_ptr)
+{
+    auto &unflushed = worker_ptr->unflushed_.value;
+    if (!unflushed.load(std::memory_order_relaxed) && !unflushed.exchange(true, std::memory_order_relaxed))
+    {
+        std::lock_guard<std::mutex> lock(unflushed_mutex_);
+        unflushed_.push_back(worker_ptr);
+    }
+}
+
+void SPDLOG_INLINE thread_pool::complete_flushes_(std::vector<uint32_t> &tickets)
+{
+    std::vector<std::function<void()>> callbacks;
+    {
+        std::lock_guard<std::mutex> lock(flush_mutex_);
+        for (auto ticket : tickets)
+        {
+            auto it = std::find_if(flush_callbacks_.begin(), flush_callbacks_.end(),
+                [ticket](const std::pair<uint32_t, std::function<void()>> &entry) { return entry.first == ticket; });
+            if (it != flush_callbacks_.end())
+            {
+                callbacks.push_back(std::move(it->second));
+                flush_callbacks_.erase(it);
+            }
+        }
+    }
+    tickets.clear();
+    for (auto &callback : callbacks)
+    {
+        SPDLOG_TRY
+        {
+            callback();
+        }
+        SPDLOG_CATCH_STD
+    }
+}
+
+void SPDLOG_INLINE thread_pool::worker_loop_(size_t index)
+{
+    if (format_threads_n_ > 0)
+    {
+        commit_loop_();
+        return;
+    }
+    if (records_)
+    {
+        std::vector<char *> records;
+        records.reserve(max_batch_);
+        std::vector<log_msg> msgs;
+        msgs.reserve(max_batch_);
+        std::vector<std::vector<Field>> fields(max_batch_);
+        while (process_next_records_(records, msgs, fields))
+        {
+            update_load_shedding_();
+            report_drops_();
+        }
+        return;
+    }
+
+    auto &q = shards_.empty() ? *q_ : *shards_[index];
+    std::vector<async_msg> batch(max_batch_);
+    std::vector<log_msg> msgs;
+    msgs.reserve(max_batch_);
+    while (process_next_batch_(q, batch, msgs))
+    {
+        update_load_shedding_();
+        report_drops_();
+    }
+}
+
+void SPDLOG_INLINE thread_pool::format_loop_()
+{
+    formatted_batch batch;
+    batch.msgs.resize(max_batch_);
+    batch.outputs.reset(new output_cache[max_batch_]);
+    std::unordered_map<size_t, std::unique_ptr<formatter>> formatters;
+    for (;;)
+    {
+        uint64_t sequence;
+        {
+            // one format thread dequeues at a time, so the sequence follows the queue order
+            std::lock_guard<std::mutex> lock(dequeue_mutex_);
+            batch.count = dequeue_batch_(*q_, batch.msgs);
+            if (batch.count == 0)
+            {
+                continue;
+            }
+            sequence = next_sequence_++;
+        }
+        format_batch_(batch, formatters);
+
+        bool terminate = batch.msgs[batch.count - 1].msg_type == async_msg_type::terminate;
+        {
+            std::unique_lock<std::mutex> lock(reorder_mutex_);
+            reorder_cv_.wait(lock, [this, sequence] { return sequence - commit_sequence_ < reorder_.size(); });
+            // take the memory of the batch written last time in this slot
+            auto &slot = reorder_[sequence % reorder_.size()];
+            std::swap(slot.msgs, batch.msgs);
+            std::swap(slot.outputs, batch.outputs);
+            slot.count = batch.count;
+            slot.ready = true;
+        }
+        reorder_cv_.notify_all();
+        if (terminate)
+        {
+            return;
+        }
+    }
+}
+
+void SPDLOG_INLINE thread_pool::format_batch_(formatted_batch &batch, std::unordered_map<size_t, std::unique_ptr<formatter>> &formatters)
+{
+    // the formatters of the current logger's sinks, one per share key, with the lowest level of the sinks using it
+    struct target
+    {
+        size_t key;
+        formatter *sink_formatter;
+        level::level_enum level;
+    };
+    std::vector<target> targets;
+    async_logger *current = nullptr;
+    memory_buf_t scratch;
+    for (size_t i = 0; i < batch.count; i++)
+    {
+        auto &msg = batch.msgs[i];
+        if (msg.msg_type != async_msg_type::log)
+        {
+            continue;
+        }
+        if (msg.worker_ptr != current)
+        {
+            current = msg.worker_ptr;
+            targets.clear();
+            // the worker thread skips the messages of a retired logger
+            if (!enter_(current))
+            {
+                continue;
+            }
+            for (auto &sink : current->sinks_)
+            {
+                auto key = sink->formatter_share_key();
+                if (key == 0)
+                {
+                    continue;
+                }
+                auto sink_level = sink->level();
+                auto it = std::find_if(targets.begin(), targets.end(), [key](const target &t) { return t.key == key; });
+                if (it != targets.end())
+                {
+                    it->level = std::min(it->level, sink_level);
+                    continue;
+                }
+                auto &copy = formatters[key];
+                if (!copy)
+                {
+                    copy = sink->clone_formatter();
+                }
+                if (copy)
+                {
+                    targets.push_back(target{key, copy.get(), sink_level});
+                }
+            }
+        }
+
+        auto &output = batch.outputs[i];
+        output.clear();
+        msg.shared_output = &output;
+        for (auto &t : targets)
+        {
+            if (msg.level < t.level)
+            {
+                continue;
+            }
+            // the formatter stores its output under its key. on error the sink formats the message again and reports it.
+            scratch.clear();
+            SPDLOG_TRY
+            {
+                t.sink_formatter->format(msg, scratch);
+            }
+            SPDLOG_CATCH_STD
+        }
+    }
+    leave_();
+}
+
+void SPDLOG_INLINE thread_pool::commit_loop_()
+{
+    std::vector<log_msg> msgs;
+    msgs.reserve(max_batch_);
+    size_t terminated = 0;
+    while (terminated < format_threads_n_)
+    {
+        formatted_batch *batch;
+        {
+            std::unique_lock<std::mutex> lock(reorder_mutex_);
+            batch = &reorder_[commit_sequence_ % reorder_.size()];
+            reorder_cv_.wait(lock, [batch] { return batch->ready; });
+        }
+        if (!process_batch_(batch->msgs, batch->count, msgs))
+        {
+            terminated++;
+        }
+        {
+            std::lock_guard<std::mutex> lock(reorder_mutex_);
+            batch->ready = false;
+            commit_sequence_++;
+        }
+        reorder_cv_.notify_all();
+        update_load_shedding_();
+        report_drops_();
+    }
+}
+
+template<typename TryNext, typename Park>
+bool thread_pool::wait_next_(TryNext try_next, Park park)
+{
+    const std::chrono::milliseconds idle_timeout = std::chrono::seconds(10);
+    if (wait_strategy_ != async_wait_strategy::busy_spin && wait_strategy_ != async_wait_strategy::yield &&
+        wait_strategy_ != async_wait_strategy::spin_then_park)
+    {
+        return park(idle_timeout);
+    }
+
+    auto spin_for = wait_strategy_ == async_wait_strategy::spin_then_park
+                        ? std::chrono::duration_cast<std::chrono::steady_clock::duration>(spin_budget_)
+                        : std::chrono::duration_cast<std::chrono::steady_clock::duration>(idle_timeout);
+    auto deadline = std::chrono::steady_clock::now() + spin_for;
+    for (size_t polls = 0;; polls++)
+    {
+        if (try_next())
+        {
+            return true;
+        }
+        // reading the clock costs more than a poll
+        if (polls % 64 == 0 && std::chrono::steady_clock::now() >= deadline)
+        {
+            break;
+        }
+        if (wait_strategy_ == async_wait_strategy::yield)
+        {
+            std::this_thread::yield();
+        }
+    }
+    // the spinning strategies still go through park() once in a while: the queue does its idle time chores there
+    return park(wait_strategy_ == async_wait_strategy::spin_then_park ? idle_timeout : std::chrono::milliseconds::zero());
+}
+
+// process the next messages in the queue (up to max_batch_ of them)
+// return true if this thread should still be active (while no terminate msg
+// was received)
+bool SPDLOG_INLINE thread_pool::process_next_batch_(async_queue &q, std::vector<async_msg> &batch, std::vector<log_msg> &msgs)
+{
+    auto count = dequeue_batch_(q, batch);
+    if (count == 0)
+    {
+        return !spill_ || process_spill_(msgs);
+    }
+    return process_batch_(batch, count, msgs);
+}
+
+size_t SPDLOG_INLINE thread_pool::dequeue_batch_(async_queue &q, std::vector<async_msg> &batch)
+{
+    if (priority_q_)
+    {
+        // the priority lane first. the zero wait dequeue_for() lets the queue do its idle time chores.
+        bool from_lane = false;
+        auto try_next = [this, &q, &batch, &from_lane] {
+            from_lane = priority_q_->try_dequeue(batch[0]);
+            return from_lane || q.try_dequeue(batch[0]);
+        };
+        if (!wait_next_(try_next, [this, &q, &batch, &try_next](std::chrono::milliseconds timeout) {
+                return work_waiter_.wait_for(try_next, timeout) || q.dequeue_for(batch[0], std::chrono::milliseconds::zero());
+            }))
+        {
+            return 0;
+        }
+        if (from_lane)
+        {
+            size_t count = 1;
+            while (count < batch.size() && priority_q_->try_dequeue(batch[count]))
+            {
+                count++;
+            }
+            return count;
+        }
+    }
+    else if (spill_)
+    {
+        // the queue first: the spilled messages came after the ones in it. return 0 to read the spill file.
+        bool dequeued = false;
+        auto try_next = [this, &q, &batch, &dequeued] {
+            dequeued = q.try_dequeue(batch[0]);
+            return dequeued || spilling_.load(std::memory_order_acquire);
+        };
+        if (!wait_next_(try_next, [this, &q, &batch, &try_next, &dequeued](std::chrono::milliseconds timeout) {
+                return work_waiter_.wait_for(try_next, timeout) || (dequeued = q.dequeue_for(batch[0], std::chrono::milliseconds::zero()));
+            }) ||
+            !dequeued)
+        {
+            return 0;
+        }
+    }
+    else if (!wait_next_([&q, &batch] { return q.try_dequeue(batch[0]); },
+                 [&q, &batch](std::chrono::milliseconds timeout) { return q.dequeue_for(batch[0], timeout); }))
+    {
+        return 0;
+    }
+    size_t count = 1;
+    auto take_queued = [&q, &batch, &count] {
+        while (count < batch.size() && !ends_batch(batch[count - 1].msg_type) && q.try_dequeue(batch[count]))
+        {
+            count++;
+        }
+    };
+    take_queued();
+    // timed_batch: let more pile up only if the queue did not fill the batch already
+    if (wait_strategy_ == async_wait_strategy::timed_batch && count < batch.size() && !ends_batch(batch[count - 1].msg_type))
+    {
+        std::this_thread::sleep_for(batch_window_);
+        take_queued();
+    }
+    return count;
+}
+
+bool SPDLOG_INLINE thread_pool::process_batch_(std::vector<async_msg> &batch, size_t count, std::vector<log_msg> &msgs)
+{
+    bool active = true;
+    std::vector<uint32_t> tickets;
+    // consecutive log messages of the same logger are passed to its sinks together
+    for (size_t i = 0; i < count; i++)
+    {
+        auto &incoming_async_msg = batch[i];
+        switch (incoming_async_msg.msg_type)
+        {
+        case async_msg_type::log: {
+            // at the start of a run: its logger may be retired already
+            if (msgs.empty() && !enter_(incoming_async_msg.worker_ptr))
+            {
+                overruns_.fetch_add(1, std::memory_order_relaxed);
+                break;
+            }
+            msgs.push_back(incoming_async_msg);
+            // format threads: the output they attached (a copy doesn't carry it)
+            msgs.back().shared_output = incoming_async_msg.shared_output;
+            bool last_of_run = i + 1 == count || batch[i + 1].msg_type != async_msg_type::log ||
+                               batch[i + 1].worker_ptr != incoming_async_msg.worker_ptr;
+            if (last_of_run)
+            {
+                auto *worker_ptr = incoming_async_msg.worker_ptr;
+                // before the sinks: one of them may release the last reference to the logger
+                mark_unflushed_(worker_ptr);
+                if (!shards_.empty())
+                {
+                    worker_ptr->shard_.processed.fetch_add(msgs.size(), std::memory_order_relaxed);
+                }
+                worker_ptr->backend_sink_batch_(msgs.data(), msgs.size());
+                leave_();
+                msgs.clear();
+            }
+            break;
+        }
+        case async_msg_type::flush: {
+            if (incoming_async_msg.generation == 0)
+            {
+                if (enter_(incoming_async_msg.worker_ptr))
+                {
+                    incoming_async_msg.worker_ptr->backend_flush_();
+                    leave_();
+                }
+                break;
+            }
+            // consecutive flush requests of the same logger: one flush for all
+            tickets.push_back(incoming_async_msg.generation);
+            bool last_of_run = i + 1 == count || batch[i + 1].msg_type != async_msg_type::flush || batch[i + 1].generation == 0 ||
+                               batch[i + 1].worker_ptr != incoming_async_msg.worker_ptr;
+            if (last_of_run)
+            {
+                // the priority messages posted before are written too
+                drain_priority_lane_();
+                if (enter_(incoming_async_msg.worker_ptr))
+                {
+                    incoming_async_msg.worker_ptr->backend_flush_();
+                    leave_();
+                }
+                complete_flushes_(tickets);
+            }
+            break;
+        }
+
+        case async_msg_type::retire: {
+            // the priority messages posted before are done too
+            drain_priority_lane_();
+            arrive_(incoming_async_msg.generation);
+            break;
+        }
+
+        case async_msg_type::handoff: {
+            std::lock_guard<std::mutex> lock(barrier_mutex_);
+            if (handoff_pending_ == incoming_async_msg.generation)
+            {
+                handoff_pending_ = 0;
+                barrier_cv_.notify_all();
+            }
+            break;
+        }
+
+        case async_msg_type::await_handoff: {
+            std::unique_lock<std::mutex> lock(barrier_mutex_);
+            auto generation = incoming_async_msg.generation;
+            barrier_cv_.wait(lock, [this, generation] { return handoff_pending_ != generation; });
+            break;
+        }
+
+        case async_msg_type::terminate: {
+            drain_priority_lane_();
+            active = false;
+            break;
+        }
+
+        default: {
+            assert(false);
+        }
+        }
+    }
+    return active;
+}
+
+bool SPDLOG_INLINE thread_pool::process_next_records_(
+    std::vector<char *> &records, std::vector<log_msg> &msgs, std::vector<std::vector<Field>> &fields)
+{
+    if (priority_q_)
+    {
+        auto ready = [this] { return priority_q_->size() > 0 || records_->readable(); };
+        if (!wait_next_(ready, [this, &ready](std::chrono::milliseconds timeout) { return work_waiter_.wait_for(ready, timeout); }))
+        {
+            return true;
+        }
+        drain_priority_lane_();
+        if (!records_->readable())
+        {
+            return true;
+        }
+    }
+    else if (!wait_next_([this] { return records_->readable(); },
+                 [this](std::chrono::milliseconds timeout) { return records_->wait_for(timeout); }))
+    {
+        return true;
+    }
+    records.clear();
+    bool ended = false;
+    auto take_readable = [this, &records, &ended] {
+        char *record = nullptr;
+        while (!ended && records.size() < max_batch_ && (record = records_->read()) != nullptr)
+        {
+            records.push_back(record);
+            ended = ends_batch(reinterpret_cast<async_record *>(record)->msg_type);
+        }
+    };
+    take_readable();
+    // same as process_next_batch_(): wait for more only if the ring did not fill the batch already
+    if (wait_strategy_ == async_wait_strategy::timed_batch && !ended && records.size() < max_batch_)
+    {
+        std::this_thread::sleep_for(batch_window_);
+        take_readable();
+    }
+    auto active = process_records_(records, msgs, fields);
+    records_->release();
+    return active;
+}
+
+bool SPDLOG_INLINE thread_pool::process_records_(
+    std::vector<char *> &records, std::vector<log_msg> &msgs, std::vector<std::vector<Field>> &fields)
+{
+    bool active = true;
+    std::vector<uint32_t> tickets;
+    std::vector<std::unique_ptr<log_msg_buffer>> heap_msgs;
+    // same as process_next_batch_(), the messages pointing into the ring (or the spill file)
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        auto &incoming_record = *reinterpret_cast<async_record *>(records[i]);
+        switch (incoming_record.msg_type)
+        {
+        case async_msg_type::log: {
+            if (incoming_record.heap_msg != nullptr)
+            {
+                heap_msgs.emplace_back(incoming_record.heap_msg);
+            }
+            if (msgs.empty() && !enter_(incoming_record.worker_ptr))
+            {
+                records_overrun_.fetch_add(1, std::memory_order_relaxed);
+                break;
+            }
+            if (incoming_record.heap_msg != nullptr)
+            {
+                msgs.emplace_back(*incoming_record.heap_msg);
+            }
+            else
+            {
+                msgs.emplace_back();
+                msg_record::decode(records[i] + async_record_size, incoming_record.worker_ptr->name(), msgs.back(), fields[msgs.size() - 1]);
+            }
+            bool last_of_run = i + 1 == records.size() ||
+                               reinterpret_cast<async_record *>(records[i + 1])->msg_type != async_msg_type::log ||
+                               reinterpret_cast<async_record *>(records[i + 1])->worker_ptr != incoming_record.worker_ptr;
+            if (last_of_run)
+            {
+                mark_unflushed_(incoming_record.worker_ptr);
+                incoming_record.worker_ptr->backend_sink_batch_(msgs.data(), msgs.size());
+                leave_();
+                msgs.clear();
+            }
+            break;
+        }
+        case async_msg_type::flush: {
+            if (incoming_record.generation == 0)
+            {
+                if (enter_(incoming_record.worker_ptr))
+                {
+                    incoming_record.worker_ptr->backend_flush_();
+                    leave_();
+                }
+                break;
+            }
+            tickets.push_back(incoming_record.generation);
+            auto *next = i + 1 < records.size() ? reinterpret_cast<async_record *>(records[i + 1]) : nullptr;
+            bool last_of_run = next == nullptr || next->msg_type != async_msg_type::flush || next->generation == 0 ||
+                               next->worker_ptr != incoming_record.worker_ptr;
+            if (last_of_run)
+            {
+                drain_priority_lane_();
+                if (enter_(incoming_record.worker_ptr))
+                {
+                    incoming_record.worker_ptr->backend_flush_();
+                    leave_();
+                }
+                complete_flushes_(tickets);
+            }
+            break;
+        }
+
+        case async_msg_type::retire: {
+            // the priority messages posted before are done too
+            drain_priority_lane_();
+            arrive_(incoming_record.generation);
+            break;
+        }
+
+        case async_msg_type::terminate: {
+            drain_priority_lane_();
+            active = false;
+            break;
+        }
+
+        default: {
+            assert(false);
+        }
+        }
+    }
+
+    return active;
+}
+
+bool SPDLOG_INLINE thread_pool::process_spill_(std::vector<log_msg> &msgs)
+{
+    if (!spilling_.load(std::memory_order_acquire))
+    {
+        return true;
+    }
+    {
+        std::lock_guard<std::mutex> lock(spill_mutex_);
+        spill_records_.clear();
+        char *record = nullptr;
+        while (spill_records_.size() < max_batch_ && (record = spill_->read()) != nullptr)
+        {
+            spill_records_.push_back(record);
+            if (ends_batch(reinterpret_cast<async_record *>(record)->msg_type))
+            {
+                break;
+            }
+        }
+        if (spill_records_.empty())
+        {
+            spill_->release();
+            spilling_.store(false, std::memory_order_release);
+            spill_room_.notify_all();
+            return true;
+        }
+    }
+    // the records read stay valid while the logging threads append behind them
+    auto active = process_records_(spill_records_, msgs, spill_fields_);
+    {
+        std::lock_guard<std::mutex> lock(spill_mutex_);
+        spill_->release();
+    }
+    spill_room_.notify_all();
+    return active;
 }
 
 } // namespace details
@@ -4,35 +4,122 @@
 #pragma once
 
 #include <spdlog/details/log_msg_buffer.h>
-#include <spdlog/details/mpmc_blocking_q.h>
+#include <spdlog/details/mpmc_ring_q.h>
+#include <spdlog/details/mpsc_byte_ring.h>
 #include <spdlog/details/os.h>
+#include <spdlog/details/output_cache.h>
+#include <spdlog/details/per_thread.h>
+#include <spdlog/details/periodic_worker.h>
+#include <spdlog/details/spill_file.h>
+#include <spdlog/details/spsc_merge_q.h>
+#include <spdlog/details/waiter.h>
 
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <future>
 #include <memory>
+#include <mutex>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 #include <functional>
 
 namespace spdlog {
 class async_logger;
 
-namespace details {
+enum class async_queue_topology
+{
+    shared,    // one lock free queue shared by all the logging threads
+    per_thread, // one SPSC ring per logging thread, merged in time order by a single worker thread
+    byte_ring,  // one ring of serialized messages, read in place by a single worker thread
+    sharded     // one queue per worker thread. each async logger posts to one of them, so its messages stay in order
+};
+
+// how the worker threads wait for messages
+enum class async_wait_strategy
+{
+    park,           // sleep until a message comes (after a short spin)
+    busy_spin,      // poll the queue without ever sleeping: lowest latency, burns a core
+    yield,          // poll the queue, giving the cpu away between polls
+    spin_then_park, // poll the queue for spin_budget, then park
+    timed_batch     // park, then let the messages pile up for batch_window unless a full batch is queued
+};
+
+// load shedding watermark: once the queue holds more than high items (byte_ring topology: bytes), the
+// logging threads drop the messages below level, until the queue is back under low
+struct load_shed_step
+{
+    size_t high;
+    size_t low;
+    level::level_enum level;
+};
+
+struct thread_pool_options
+{
+    async_queue_topology topology = async_queue_topology::shared;
+    size_t queue_size = 8192;            // shared topology: items in the queue
+    size_t per_thread_queue_size = 1024; // per_thread topology: items in each logging thread's ring
+    size_t queue_bytes = 1024 * 1024;    // byte_ring topology: bytes in the ring
+    size_t threads = 1;
+    size_t max_batch = 64; // messages a worker thread dequeues at once and hands to the sinks together
+    // shared topology: threads formatting the batches for the sinks in parallel (0: none). the single
+    // worker thread then writes the formatted batches in their original order.
+    size_t format_threads = 0;
+    async_wait_strategy wait_strategy = async_wait_strategy::park;
+    std::chrono::microseconds spin_budget{100};  // spin_then_park
+    std::chrono::microseconds batch_window{100}; // timed_batch
+    // pin worker thread i to cpu worker_cpus[i % size] (empty: no pinning). the queue is then allocated
+    // by the first worker thread, so it sits on that cpu's NUMA node.
+    std::vector<size_t> worker_cpus;
+    // sharded topology: how often to move a logger off the busiest shard (0: never, see thread_pool::rebalance())
+    std::chrono::seconds rebalance_interval{0};
+    // messages at this level or above go through a lane of their own, which the worker threads drain before
+    // the queue (off: no priority lane). see async_logger::set_priority_lane(). a single worker thread, not
+    // with format_threads.
+    level::level_enum priority_level = level::off;
+    size_t priority_queue_size = 1024; // items in the priority lane
+    // watermarks by increasing high mark and level. the queue depth is sampled by the worker threads after
+    // each batch. the dropped messages are counted and reported like the discard_new ones.
+    std::vector<load_shed_step> load_shedding;
+    // called by a worker thread when the shedding level changes, with the new level (trace: nothing dropped)
+    std::function<void(level::level_enum)> on_load_shedding;
+    // discard_new policy: least time between two reports of the dropped messages
+    std::chrono::milliseconds drop_report_interval{1000};
+    // spill policy: the messages the queue has no room for go to memory mapped segment files
+    // <spill_path>.<n> (empty: no spill file), read back in order by the worker thread once the queue
+    // is empty. shared topology with a single worker thread, no format_threads nor priority lane.
+    // a message larger than a segment is not spilled: it waits for the spill file to be read back,
+    // then blocks on the queue.
+    filename_t spill_path;
+    size_t spill_segment_size = 16 * 1024 * 1024;
+    size_t spill_budget = 1024 * 1024 * 1024; // bytes of segment files. the logging threads block beyond.
+    std::function<void()> on_thread_start;
+    std::function<void()> on_thread_stop;
+};
 
-using async_logger_ptr = std::shared_ptr<spdlog::async_logger>;
+namespace details {
 
 enum class async_msg_type
 {
     log,
     flush,
-    terminate
+    terminate,
+    retire,       // wait for the other worker threads (see thread_pool::retire_barrier())
+    handoff,      // sharded: a moved logger has no more messages in this shard
+    await_handoff // sharded: wait for the handoff of a logger moved to this shard
 };
 
 // Async msg to move to/from the queue
 // Movable only. should never be copied
+// worker_ptr is a plain pointer: an async logger waits in its destructor for the
+// worker threads to be done with its messages (thread_pool::retire_barrier())
 struct async_msg : log_msg_buffer
 {
     async_msg_type msg_type{async_msg_type::log};
-    async_logger_ptr worker_ptr;
+    uint32_t generation{0}; // retire and handoff messages: the call they belong to
+    async_logger *worker_ptr{nullptr};
 
     async_msg() = default;
     ~async_msg() = default;
@@ -45,14 +132,16 @@ struct async_msg : log_msg_buffer
     async_msg(async_msg &&other)
         : log_msg_buffer(std::move(other))
         , msg_type(other.msg_type)
-        , worker_ptr(std::move(other.worker_ptr))
+        , generation(other.generation)
+        , worker_ptr(other.worker_ptr)
     {}
 
     async_msg &operator=(async_msg &&other)
     {
         *static_cast<log_msg_buffer *>(this) = std::move(other);
         msg_type = other.msg_type;
-        worker_ptr = std::move(other.worker_ptr);
+        generation = other.generation;
+        worker_ptr = other.worker_ptr;
         return *this;
     }
 #else // (_MSC_VER) && _MSC_VER <= 1800
@@ -61,16 +150,16 @@ struct async_msg : log_msg_buffer
 #endif
 
     // construct from log_msg with given type
-    async_msg(async_logger_ptr &&worker, async_msg_type the_type, const details::log_msg &m)
+    async_msg(async_logger *worker, async_msg_type the_type, const details::log_msg &m)
         : log_msg_buffer{m}
         , msg_type{the_type}
-        , worker_ptr{std::move(worker)}
+        , worker_ptr{worker}
     {}
 
-    async_msg(async_logger_ptr &&worker, async_msg_type the_type)
+    async_msg(async_logger *worker, async_msg_type the_type)
         : log_msg_buffer{}
         , msg_type{the_type}
-        , worker_ptr{std::move(worker)}
+        , worker_ptr{worker}
     {}
 
     explicit async_msg(async_msg_type the_type)
@@ -78,12 +167,87 @@ struct async_msg : log_msg_buffer
     {}
 };
 
+// queue between the async loggers and the worker threads
+class async_queue
+{
+public:
+    virtual ~async_queue() = default;
+    virtual void enqueue(async_msg &&item) = 0;
+    virtual void enqueue_nowait(async_msg &&item) = 0;
+    // enqueue, or move the overrun oldest message out to oldest and return false (the item is left alone)
+    virtual bool enqueue_or_overrun(async_msg &&item, async_msg &oldest) = 0;
+    virtual bool try_enqueue(async_msg &&item) = 0;
+    virtual bool dequeue_for(async_msg &popped_item, std::chrono::milliseconds wait_duration) = 0;
+    virtual bool try_dequeue(async_msg &popped_item) = 0;
+    virtual size_t overrun_counter() = 0;
+    virtual size_t size() = 0;
+    // cheap, possibly stale size() for the consumers
+    virtual size_t approx_size() = 0;
+};
+
+template<typename Q>
+class async_queue_impl final : public async_queue
+{
+public:
+    explicit async_queue_impl(size_t max_items)
+        : q_(max_items)
+    {}
+
+    void enqueue(async_msg &&item) override
+    {
+        q_.enqueue(std::move(item));
+    }
+
+    void enqueue_nowait(async_msg &&item) override
+    {
+        q_.enqueue_nowait(std::move(item));
+    }
+
+    bool enqueue_or_overrun(async_msg &&item, async_msg &oldest) override
+    {
+        return q_.enqueue_or_overrun(std::move(item), oldest);
+    }
+
+    bool try_enqueue(async_msg &&item) override
+    {
+        return q_.try_enqueue(std::move(item));
+    }
+
+    bool dequeue_for(async_msg &popped_item, std::chrono::milliseconds wait_duration) override
+    {
+        return q_.dequeue_for(popped_item, wait_duration);
+    }
+
+    bool try_dequeue(async_msg &popped_item) override
+    {
+        return q_.try_dequeue(popped_item);
+    }
+
+    size_t overrun_counter() override
+    {
+        return q_.overrun_counter();
+    }
+
+    size_t size() override
+    {
+        return q_.size();
+    }
+
+    size_t approx_size() override
+    {
+        return q_.approx_size();
+    }
+
+private:
+    Q q_;
+};
+
 class SPDLOG_API thread_pool
 {
 public:
     using item_type = async_msg;
-    using q_type = details::mpmc_blocking_queue<item_type>;
 
+    explicit thread_pool(const thread_pool_options &options);
     thread_pool(size_t q_max_items, size_t threads_n, std::function<void()> on_thread_start, std::function<void()> on_thread_stop);
     thread_pool(size_t q_max_items, size_t threads_n, std::function<void()> on_thread_start);
     thread_pool(size_t q_max_items, size_t threads_n);
@@ -94,23 +258,287 @@ public:
     thread_pool(const thread_pool &) = delete;
     thread_pool &operator=(thread_pool &&) = delete;
 
-    void post_log(async_logger_ptr &&worker_ptr, const details::log_msg &msg, async_overflow_policy overflow_policy);
-    void post_flush(async_logger_ptr &&worker_ptr, async_overflow_policy overflow_policy);
+    void post_log(async_logger *worker_ptr, const details::log_msg &msg, async_overflow_policy overflow_policy);
+    void post_flush(async_logger *worker_ptr, async_overflow_policy overflow_policy);
+    // flush the logger's sinks once its messages posted before are written, then call on_flushed (on a worker
+    // thread). consecutive requests of a logger share one flush. shared topology with several worker threads:
+    // same as flush_barrier().
+    void post_flush(async_logger *worker_ptr, std::function<void()> on_flushed);
+
+    // without waiting: once the worker threads are done with all the messages posted before the call, flush
+    // the loggers written since the last flush barrier and call on_flushed (on a worker thread).
+    // on_flushed must not wait for the thread pool itself (retire_barrier(), blocking posts, ..).
+    // waits for the previous barrier if it is not done yet.
+    void flush_barrier(std::function<void()> on_flushed);
+    std::future<void> flush_barrier();
+
+    // return once the worker threads are done with all the messages posted before the call.
+    // never call it from a worker thread of this pool.
+    void retire_barrier();
+
+    // called by the async loggers on destruction: forget the logger, retire_barrier() and report
+    // the messages it dropped since the last report. on a thread of the pool (a flush callback or
+    // a sink releasing the last reference), which can't wait for the worker threads: the messages
+    // of the logger still queued are skipped (counted as overruns) instead.
+    void retire(async_logger *worker_ptr);
+
+    // sharded topology: if the busiest shard has much more queued messages than the idlest one, move
+    // its busiest logger there. the messages of the logger stay in order. return true if a logger moved.
+    bool rebalance();
+
+    // messages lost to overrun_oldest (or to a logger destroyed before its messages were written).
+    // the byte_ring can't drop its oldest records: overrun_oldest drops the new message instead,
+    // counted here too (and apart in ring_full_drops()).
     size_t overrun_counter();
+    // byte_ring topology: messages dropped because the ring was full (overrun_oldest policy)
+    size_t ring_full_drops() const
+    {
+        return ring_full_drops_.load(std::memory_order_relaxed);
+    }
+    // items in the queue (byte_ring topology: bytes in the ring)
     size_t queue_size();
 
+    async_queue_topology topology() const
+    {
+        return topology_;
+    }
+
+    async_wait_strategy wait_strategy() const
+    {
+        return wait_strategy_;
+    }
+
+    // messages below this level are dropped by the load shedding (trace: none)
+    level::level_enum shed_level() const
+    {
+        return static_cast<level::level_enum>(shed_level_->load(std::memory_order_relaxed));
+    }
+
+    // shed_level() for the async loggers to check before formatting (nullptr without load shedding).
+    // it stays valid as long as it is held.
+    std::shared_ptr<const level_t> shed_level_source() const
+    {
+        return shed_steps_.empty() ? nullptr : shed_level_;
+    }
+
+    // count a message dropped by an async logger because of shed_level_source()
+    void count_shed(async_logger *worker_ptr, level::level_enum lvl);
+
 private:
-    q_type q_;
+    async_queue_topology topology_;
+    size_t max_batch_ = 1;
+    async_wait_strategy wait_strategy_ = async_wait_strategy::park;
+    std::chrono::microseconds spin_budget_{0};
+    std::chrono::microseconds batch_window_{0};
+    std::unique_ptr<async_queue> q_;
+    std::unique_ptr<mpsc_byte_ring> records_; // byte_ring topology (instead of q_)
+    std::atomic<size_t> records_overrun_{0}; // records of a destroyed logger (byte_ring or spill file)
+    std::atomic<size_t> ring_full_drops_{0};
+    std::atomic<size_t> overruns_{0}; // messages of a destroyed logger, or log messages overrun in the queues
+    std::vector<std::unique_ptr<async_queue>> shards_; // sharded topology: worker thread i reads shards_[i] (instead of q_)
+
+    // how the messages posted to the pool get into the queue(s) of its topology (set by create_queue_())
+    class front_end;
+    class queue_front_end;   // shared and per_thread topologies: q_
+    class sharded_front_end; // sharded topology: the shard of the logger
+    class record_front_end;  // byte_ring topology: records_
+    std::unique_ptr<front_end> front_;
+
+    // priority lane. the worker threads park in work_waiter_, notified by the posts to any queue.
+    std::unique_ptr<async_queue> priority_q_;
+    level::level_enum priority_level_ = level::off;
+    waiter work_waiter_;
+
+    // spill file. while spilling_, every message goes to the spill file (behind the spilled ones)
+    // until the worker thread read it all.
+    std::unique_ptr<spill_file> spill_;
+    std::mutex spill_mutex_;
+    std::condition_variable spill_room_;
+    std::atomic<bool> spilling_{false};
+    std::vector<char *> spill_records_; // worker thread only
+    std::vector<std::vector<Field>> spill_fields_;
+
+    // sharded topology: the loggers assigned so far
+    struct sharded_logger
+    {
+        async_logger *logger;
+        size_t shard;
+        size_t last_processed;
+    };
+    std::mutex shard_mutex_;
+    std::vector<sharded_logger> sharded_loggers_;
+
+    // sharded topology: odd while the thread is posting, so moving a logger can wait for
+    // the posts that may still go to its old shard
+    struct posting_slot
+    {
+        char pad0_[64];
+        std::atomic<uint64_t> sequence{0};
+        char pad1_[64];
+    };
+    per_thread<posting_slot> posting_;
+    std::unique_ptr<periodic_worker> rebalancer_;
+
+    // load shedding
+    std::vector<load_shed_step> shed_steps_;
+    std::function<void(level::level_enum)> on_load_shedding_;
+    std::mutex shed_mutex_;
+    size_t shed_step_ = 0; // steps in effect, under shed_mutex_
+    std::shared_ptr<level_t> shed_level_ = std::make_shared<level_t>(static_cast<int>(level::trace));
+
+    // discard_new policy: the loggers with drops to report
+    std::mutex drops_mutex_;
+    std::vector<async_logger *> dropping_;
+    std::atomic<bool> drops_pending_{false};
+    std::chrono::milliseconds drop_report_interval_{0};
+    std::chrono::steady_clock::time_point last_drop_report_;
 
     std::vector<std::thread> threads_;
 
-    void post_async_msg_(async_msg &&new_msg, async_overflow_policy overflow_policy);
-    void worker_loop_();
+    // format_threads: batches get a sequence number when dequeued, are formatted by the format threads and
+    // wait in the reorder buffer (slot sequence % size) until the worker thread writes them in sequence
+    struct formatted_batch
+    {
+        std::vector<async_msg> msgs;
+        std::unique_ptr<output_cache[]> outputs; // outputs[i]: the formatted output of msgs[i]
+        size_t count = 0;
+        bool ready = false;
+    };
+    std::vector<std::thread> format_threads_;
+    size_t format_threads_n_ = 0;
+    std::mutex dequeue_mutex_;
+    uint64_t next_sequence_ = 0; // under dequeue_mutex_
+    std::mutex reorder_mutex_;
+    std::condition_variable reorder_cv_;
+    std::vector<formatted_batch> reorder_;
+    uint64_t commit_sequence_ = 0; // under reorder_mutex_
+
+    // retire_barrier() handshake: every worker thread takes one retire message and waits for the others
+    std::mutex retire_mutex_; // one retire_barrier() or logger move at a time
+    std::mutex barrier_mutex_;
+    std::condition_variable barrier_cv_;
+    uint32_t barrier_generation_ = 0;
+    size_t barrier_arrived_ = 0;
+    size_t barrier_overruns_ = 0;
+    // flush_barrier(): run by the last worker thread to arrive, before letting the others go
+    std::function<void()> barrier_flushed_;
 
-    // process next message in the queue
+    // flush requests waiting for their flush message (generation: the ticket)
+    std::mutex flush_mutex_;
+    uint32_t flush_ticket_ = 0;
+    std::vector<std::pair<uint32_t, std::function<void()>>> flush_callbacks_;
+    // the loggers written since the last flush barrier
+    std::mutex unflushed_mutex_;
+    std::vector<async_logger *> unflushed_;
+    uint32_t handoff_generation_ = 0;
+    uint32_t handoff_pending_ = 0; // generation of the handoff in progress, 0 if none
+
+    // loggers retired on a thread of the pool: their messages are skipped until the retirer thread
+    // passed a retire_barrier() posted behind them
+    std::mutex retired_mutex_;
+    std::condition_variable retired_cv_;
+    std::vector<async_logger *> retired_;
+    std::vector<async_logger *> retiring_; // not in a barrier of the retirer thread yet
+    std::atomic<size_t> retired_n_{0};
+    bool retirer_stop_ = false;
+    std::thread retirer_; // started by the first of them
+    // the logger each worker thread works for right now. none when a single thread processes the messages.
+    std::unique_ptr<std::atomic<async_logger *>[]> in_flight_;
+    size_t in_flight_n_ = 0;
+
+    // the pool of the calling thread (nullptr if it is not a thread of a pool) and its in_flight_ slot
+    struct pool_thread
+    {
+        thread_pool *pool = nullptr;
+        std::atomic<async_logger *> *in_flight = nullptr;
+    };
+    static pool_thread &this_thread_();
+
+    void start_(const thread_pool_options &options);
+    void create_queue_(const thread_pool_options &options);
+    void start_rebalancer_(const thread_pool_options &options);
+    void start_format_threads_(const std::function<void()> &on_thread_start, const std::function<void()> &on_thread_stop);
+
+    // enqueue the message as the overflow policy says. return false if it was dropped.
+    bool post_async_msg_(async_queue &q, async_msg &&new_msg, async_overflow_policy overflow_policy);
+    // the overflow policies (a full queue)
+    void post_blocking_(async_queue &q, async_msg &&new_msg);
+    bool post_discarding_(async_queue &q, async_msg &&new_msg);
+    // the overrun log messages are lost, the other ones are enqueued again
+    bool post_overrunning_(async_queue &q, async_msg &&new_msg);
+    // spill policy with a spill file (while spilling_, every message goes to spill_msg_())
+    bool post_spilling_(async_queue &q, async_msg &&new_msg);
+    void assign_shard_(async_logger *worker_ptr);
+    void move_(async_logger *worker_ptr, size_t from, size_t to);
+    // byte_ring topology: serialize the message right into the ring
+    bool post_record_(async_msg_type msg_type, async_logger *worker_ptr, const log_msg *msg, async_overflow_policy overflow_policy,
+        uint32_t generation = 0);
+    // write the message at the end of the spill file. block while the budget is used up.
+    // a message larger than a segment waits for the spill file to be read back, then blocks on q.
+    bool spill_msg_(async_queue &q, async_msg &&msg);
+    void post_retire_(uint32_t generation, size_t count);
+    // post a barrier once the previous one is done (under retire_mutex_), with the flush barrier's
+    // callback if any. return its generation.
+    uint32_t open_barrier_(std::unique_lock<std::mutex> &lock, std::function<void()> on_flushed);
+    // wait for the barrier to complete, posting the retire messages overrun meanwhile again
+    void wait_barrier_(std::unique_lock<std::mutex> &lock, uint32_t generation);
+    // worker side: after writing messages of the logger
+    void mark_unflushed_(async_logger *worker_ptr);
+    // worker side: call the callbacks of the flush requests with the given tickets
+    void complete_flushes_(std::vector<uint32_t> &tickets);
+    void wake_workers_();
+    // worker side: move the shedding level along the queue depth
+    void update_load_shedding_();
+    // process the messages in the priority lane until it is empty
+    void drain_priority_lane_();
+    void count_drop_(async_logger *worker_ptr, level::level_enum lvl);
+    // worker side: once the queue drained, report the drops of the loggers in dropping_
+    void report_drops_();
+    // send a warning with the number of messages the logger dropped (by level) since the last report
+    void report_drops_of_(async_logger *worker_ptr);
+    // worker side of retire_barrier(): wait for the other worker threads
+    void arrive_(uint32_t generation);
+    // on the thread of the pool with the given slot, before anything else
+    void enter_thread_(size_t slot);
+    // worker side: before using the logger of a message. return false if it is retired (skip the message).
+    bool enter_(async_logger *worker_ptr);
+    // worker side: done with the logger
+    void leave_();
+    // retire() on a thread of the pool
+    void retire_later_(async_logger *worker_ptr);
+    void retire_loop_();
+    // posting side: a logger allocated where a retired one was waits until the old messages are gone
+    void wait_retired_(async_logger *worker_ptr);
+    void worker_loop_(size_t index);
+    void format_loop_();
+    // format_threads: write the formatted batches in sequence until every format thread terminated
+    void commit_loop_();
+
+    // wait for the next message as wait_strategy_ says: poll with try_next() and/or block in
+    // park(timeout). return false if none came (after about 10 seconds).
+    template<typename TryNext, typename Park>
+    bool wait_next_(TryNext try_next, Park park);
+
+    // dequeue the next messages (up to max_batch_ of them). return their number, 0 if none came.
+    size_t dequeue_batch_(async_queue &q, std::vector<async_msg> &batch);
+
+    // process the next messages in the queue (up to max_batch_ of them)
     // return true if this thread should still be active (while no terminate msg
     // was received)
-    bool process_next_msg_();
+    bool process_next_batch_(async_queue &q, std::vector<async_msg> &batch, std::vector<log_msg> &msgs);
+    bool process_batch_(std::vector<async_msg> &batch, size_t count, std::vector<log_msg> &msgs);
+
+    // format_threads: format the log messages of the batch for the sinks of their loggers, into batch.outputs.
+    // formatters holds this thread's copies of the sinks' formatters, by share key.
+    void format_batch_(formatted_batch &batch, std::unordered_map<size_t, std::unique_ptr<formatter>> &formatters);
+
+    // byte_ring topology: same, reading the messages in place
+    bool process_next_records_(std::vector<char *> &records, std::vector<log_msg> &msgs, std::vector<std::vector<Field>> &fields);
+    bool process_records_(std::vector<char *> &records, std::vector<log_msg> &msgs, std::vector<std::vector<Field>> &fields);
+
+    // process the next messages in the spill file (up to max_batch_ of them). once it is empty, the
+    // messages go to the queue again.
+    bool process_spill_(std::vector<log_msg> &msgs);
 };
 
 } // namespace details
@@ -0,0 +1,107 @@
+// Copyright(c) 2015-present, Gabi Melman & spdlog contributors.
+// Distributed under the MIT License (http://opensource.org/licenses/MIT)
+
+#pragma once
+
+// Park/notify helper for lock free queues.
+// Waiting threads register themselves before sleeping on a condition variable, so notify()
+// is a fence and a load when nobody is parked: the mutex and the condition variable are
+// only touched when a thread actually sleeps (like a futex wait/wake pair).
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace spdlog {
+namespace details {
+
+class waiter
+{
+public:
+    // wait until ready() returns true. ready() is called again after each wakeup.
+    template<typename Ready>
+    void wait(Ready ready)
+    {
+        if (spin_(ready))
+        {
+            return;
+        }
+        parked_.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, ready);
+        }
+        parked_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // wait until ready() returns true or timeout passed. return the last result of ready().
+    template<typename Ready>
+    bool wait_for(Ready ready, std::chrono::milliseconds timeout)
+    {
+        if (spin_(ready))
+        {
+            return true;
+        }
+        parked_.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool result;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            result = cv_.wait_for(lock, timeout, ready);
+        }
+        parked_.fetch_sub(1, std::memory_order_relaxed);
+        return result;
+    }
+
+    // wake up one parked thread, if any. call after publishing the state ready() looks at.
+    void notify_one()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (parked_.load(std::memory_order_relaxed) > 0)
+        {
+            // taking the mutex orders us after a waiter that checked ready() but is not asleep yet
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+            }
+            cv_.notify_one();
+        }
+    }
+
+    void notify_all()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (parked_.load(std::memory_order_relaxed) > 0)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+            }
+            cv_.notify_all();
+        }
+    }
+
+private:
+    // a short spin catches the common case of a wait shorter than a context switch
+    template<typename Ready>
+    static bool spin_(Ready &ready)
+    {
+        for (int i = 0; i < 16; i++)
+        {
+            if (ready())
+            {
+                return true;
+            }
+            std::this_thread::yield();
+        }
+        return false;
+    }
+
+    std::atomic<int> parked_{0};
+    std::mutex mutex_;
+    std::condition_variable cv_;
+};
+
+} // namespace details
+} // namespace spdlog
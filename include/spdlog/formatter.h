@@ -14,5 +14,13 @@ public:
     virtual ~formatter() = default;
     virtual void format(const details::log_msg &msg, memory_buf_t &dest) = 0;
     virtual std::unique_ptr<formatter> clone() const = 0;
+
+    // formatters with the same non zero key produce the same output for a given message,
+    // so sinks using them share one formatted copy (see details/output_cache.h).
+    // 0 (the default) means the output is not shared.
+    virtual size_t share_key() const
+    {
+        return 0;
+    }
 };
 } // namespace spdlog
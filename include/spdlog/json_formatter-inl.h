@@ -9,10 +9,12 @@
 
 #include <spdlog/details/fmt_helper.h>
 #include <spdlog/details/log_msg.h>
+#include <spdlog/details/output_cache.h>
 #include <spdlog/fmt/fmt.h>
 #include <spdlog/formatter.h>
 #include <spdlog/structured_spdlog.h>
 
+#include <cassert>
 #include <chrono>
 #include <ctime>
 #include <mutex>
@@ -158,7 +160,7 @@ SPDLOG_INLINE bool pattern_needs_escaping(string_view_t pattern)
     //   We check for needs-to-be-escaped characters by checking the extra_chars table;
     //   anything that requires 0 extra chars doesn't need to be escaped.
 
-    constexpr char KNOWN_CLEAN_PATTERNS[] = "LtplLaAbBcCYDxmdHIMSefFprRTXzE%#oiuO";
+    constexpr char KNOWN_CLEAN_PATTERNS[] = "LtplLaAbBcCYDxmdHIMSefFprRTXzE%#oiuOk";
 
     for (size_t i=0; i < pattern.size(); i++) {
         // Check for % flags
@@ -239,16 +241,17 @@ SPDLOG_INLINE void pattern_field::format(const details::log_msg &msg, memory_buf
 
 SPDLOG_INLINE json_formatter::json_formatter(std::initializer_list<pattern_field_definition> field_defs, pattern_time_type time_type, std::string eol) :
     pattern_time_type_(time_type),
-    eol_(eol)
+    eol_(eol),
+    share_description_("json:" + std::string(time_type == pattern_time_type::local ? "l" : "u") + eol_)
 {
     for (auto &def: field_defs) {
-        fields_.emplace_back(details::make_unique<details::pattern_field>(def.field_name, def.pattern, def.field_type, pattern_time_type_));
+        add_field_(def.field_name, def.pattern, def.field_type);
     }
+    share_key_ = shareable_ ? details::format_share_key(share_description_) : 0;
 }
 
 SPDLOG_INLINE json_formatter::json_formatter(pattern_time_type time_type, std::string eol) :
-    pattern_time_type_(time_type),
-    eol_(eol)
+    json_formatter({}, time_type, std::move(eol))
 {
     add_default_fields();
 }
@@ -260,11 +263,23 @@ SPDLOG_INLINE json_formatter& json_formatter::add_default_fields()
 }
 
 SPDLOG_INLINE json_formatter &json_formatter::add_field(std::string field_name, std::string pattern, json_field_type field_type)
+{
+    add_field_(field_name, pattern, field_type);
+    share_key_ = shareable_ ? details::format_share_key(share_description_) : 0;
+    return *this;
+}
+
+SPDLOG_INLINE void json_formatter::add_field_(const std::string &field_name, const std::string &pattern, json_field_type field_type)
 {
     fields_.emplace_back(
         details::make_unique<details::pattern_field>(field_name, pattern, field_type, pattern_time_type_)
     );
-    return *this;
+    shareable_ = shareable_ && fields_.back()->shareable();
+    share_description_ += '\0';
+    share_description_ += field_name;
+    share_description_ += '\0';
+    share_description_ += pattern;
+    share_description_ += field_type == json_field_type::STRING ? 's' : 'n';
 }
 
 
@@ -274,6 +289,9 @@ SPDLOG_INLINE std::unique_ptr<formatter> json_formatter::clone() const
     for (auto &field: fields_) {
         result->fields_.emplace_back(std::move(field->clone()));
     }
+    result->share_description_ = share_description_;
+    result->shareable_ = shareable_;
+    result->share_key_ = share_key_;
     return result;
 }
 
@@ -338,7 +356,12 @@ SPDLOG_INLINE void json_formatter::format(const details::log_msg &msg, memory_bu
     // TODO: support custom flag formatters
     // TODO: all safe fields can be compiled into one pattern formatter
 
-    memory_buf_t buffer;
+    auto *shared_output = share_key_ != 0 && dest.size() == 0 ? msg.shared_output : nullptr;
+    if (shared_output != nullptr && shared_output->fetch(share_key_, msg, dest))
+    {
+        return;
+    }
+
     dest.push_back('{');
 
     for (auto &field_ptr: fields_) {
@@ -365,6 +388,11 @@ SPDLOG_INLINE void json_formatter::format(const details::log_msg &msg, memory_bu
     }
     dest.push_back('}');
     details::fmt_helper::append_string_view(eol_, dest);
+
+    if (shared_output != nullptr)
+    {
+        shared_output->store(share_key_, msg, dest);
+    }
 }
 
 } // namespace spdlog
@@ -36,6 +36,11 @@ namespace details {
         void format(const details::log_msg &msg, memory_buf_t &dest);
 
         std::unique_ptr<pattern_field> clone() const;
+
+        bool shareable() const
+        {
+            return formatter_->share_key() != 0;
+        }
     private:
         pattern_field(const std::string &name, formatter* formatter, json_field_type field_type, bool output_needs_escaping);
         std::string value_prefix_; // {"name":}
@@ -78,14 +83,23 @@ public:
 
     std::unique_ptr<formatter> clone() const override;
     void format(const details::log_msg &msg, memory_buf_t &dest) override;
+    // equal field definitions share their output
+    size_t share_key() const override
+    {
+        return share_key_;
+    }
 
 private:
     void format_data_field(const Field &field, spdlog::memory_buf_t &dest);
+    void add_field_(const std::string &field_name, const std::string &pattern, json_field_type field_type);
 
     pattern_time_type pattern_time_type_;
     std::string eol_;
 
     std::vector<std::unique_ptr<details::pattern_field>> fields_;
+    std::string share_description_;
+    bool shareable_ = true;
+    size_t share_key_ = 0;
 };
 
 
@@ -16,6 +16,15 @@
 namespace spdlog {
 
 // public methods
+SPDLOG_INLINE logger::~logger()
+{
+    SPDLOG_TRY
+    {
+        log_pending_suppressed_();
+    }
+    SPDLOG_CATCH_STD
+}
+
 SPDLOG_INLINE logger::logger(const logger &other)
     : name_(other.name_)
     , sinks_(other.sinks_)
@@ -23,14 +32,22 @@ SPDLOG_INLINE logger::logger(const logger &other)
     , flush_level_(other.flush_level_.load(std::memory_order_relaxed))
     , custom_err_handler_(other.custom_err_handler_)
     , tracer_(other.tracer_)
-{}
+{
+    auto *other_sampler = other.sampler_.load(std::memory_order_relaxed);
+    if (other_sampler != nullptr)
+    {
+        set_sampling(other_sampler->policy());
+    }
+}
 
 SPDLOG_INLINE logger::logger(logger &&other) SPDLOG_NOEXCEPT : name_(std::move(other.name_)),
                                                                sinks_(std::move(other.sinks_)),
                                                                level_(other.level_.load(std::memory_order_relaxed)),
                                                                flush_level_(other.flush_level_.load(std::memory_order_relaxed)),
                                                                custom_err_handler_(std::move(other.custom_err_handler_)),
-                                                               tracer_(std::move(other.tracer_))
+                                                               tracer_(std::move(other.tracer_)),
+                                                               sampler_storage_(std::move(other.sampler_storage_)),
+                                                               sampler_(other.sampler_.exchange(nullptr, std::memory_order_relaxed))
 
 {}
 
@@ -57,6 +74,9 @@ SPDLOG_INLINE void logger::swap(spdlog::logger &other) SPDLOG_NOEXCEPT
 
     custom_err_handler_.swap(other.custom_err_handler_);
     std::swap(tracer_, other.tracer_);
+    sampler_storage_.swap(other.sampler_storage_);
+    auto *other_sampler = other.sampler_.load();
+    other.sampler_.store(sampler_.exchange(other_sampler));
 }
 
 SPDLOG_INLINE void swap(logger &a, logger &b)
@@ -81,8 +101,17 @@ SPDLOG_INLINE const std::string &logger::name() const
 
 // set formatting for the sinks in this logger.
 // each sink will get a separate instance of the formatter object.
-SPDLOG_INLINE void logger::set_formatter(std::unique_ptr<formatter> f)
+SPDLOG_INLINE void logger::set_formatter(std::unique_ptr<formatter> f, formatter_sharing sharing)
 {
+    if (sharing == formatter_sharing::always)
+    {
+        f = details::make_unique<details::shared_formatter>(std::move(f), details::unique_format_share_key());
+    }
+    else if (sharing == formatter_sharing::never)
+    {
+        f = details::make_unique<details::shared_formatter>(std::move(f), 0);
+    }
+
     for (auto it = sinks_.begin(); it != sinks_.end(); ++it)
     {
         if (std::next(it) == sinks_.end())
@@ -98,10 +127,28 @@ SPDLOG_INLINE void logger::set_formatter(std::unique_ptr<formatter> f)
     }
 }
 
-SPDLOG_INLINE void logger::set_pattern(std::string pattern, pattern_time_type time_type)
+SPDLOG_INLINE void logger::set_pattern(std::string pattern, pattern_time_type time_type, formatter_sharing sharing)
 {
     auto new_formatter = details::make_unique<pattern_formatter>(std::move(pattern), time_type);
-    set_formatter(std::move(new_formatter));
+    set_formatter(std::move(new_formatter), sharing);
+}
+
+SPDLOG_INLINE void logger::set_sampling(sampling_policy policy)
+{
+    if (policy.type == sampling_policy::kind::none)
+    {
+        sampler_.store(nullptr, std::memory_order_relaxed);
+        return;
+    }
+    if (sampler_storage_)
+    {
+        sampler_storage_->reset(policy);
+    }
+    else
+    {
+        sampler_storage_ = details::make_unique<details::sampler>(policy);
+    }
+    sampler_.store(sampler_storage_.get(), std::memory_order_release);
 }
 
 // create new backtrace sink and move to it all our child sinks
@@ -124,6 +171,7 @@ SPDLOG_INLINE void logger::dump_backtrace()
 // flush functions
 SPDLOG_INLINE void logger::flush()
 {
+    log_pending_suppressed_();
     flush_();
 }
 
@@ -165,6 +213,31 @@ SPDLOG_INLINE std::shared_ptr<logger> logger::clone(std::string logger_name)
 // protected methods
 SPDLOG_INLINE void logger::log_it_(const spdlog::details::log_msg &log_msg, bool log_enabled, bool traceback_enabled)
 {
+#ifndef SPDLOG_NO_STRUCTURED_SPDLOG
+    auto *tail = details::tail_buffer::current();
+    if (tail != nullptr)
+    {
+        if (log_enabled)
+        {
+            // send the captured messages before the one that triggered them
+            if (tail->should_trigger(log_msg.level) && !tail->promoted())
+            {
+                tail->promote();
+            }
+        }
+        else if (tail_capture_(log_msg.source, log_msg.level))
+        {
+            if (tail->promoted())
+            {
+                sink_it_(log_msg);
+            }
+            else
+            {
+                tail->push_back(this, &logger::tail_sink_, log_msg);
+            }
+        }
+    }
+#endif
     if (log_enabled)
     {
         sink_it_(log_msg);
@@ -176,6 +249,26 @@ SPDLOG_INLINE void logger::log_it_(const spdlog::details::log_msg &log_msg, bool
 }
 
 SPDLOG_INLINE void logger::sink_it_(const details::log_msg &msg)
+{
+    details::msg_derived derived{msg};
+    if (sinks_.size() > 1 && msg.shared_output == nullptr)
+    {
+        // sinks with equivalent formatters format the message once
+        details::output_cache_scope shared_output{msg};
+        sink_to_all_(msg);
+    }
+    else
+    {
+        sink_to_all_(msg);
+    }
+
+    if (should_flush_(msg))
+    {
+        flush_();
+    }
+}
+
+SPDLOG_INLINE void logger::sink_to_all_(const details::log_msg &msg)
 {
     for (auto &sink : sinks_)
     {
@@ -188,10 +281,84 @@ SPDLOG_INLINE void logger::sink_it_(const details::log_msg &msg)
             SPDLOG_LOGGER_CATCH(msg.source)
         }
     }
+}
 
-    if (should_flush_(msg))
+SPDLOG_INLINE bool logger::sample_(const source_loc &loc, level::level_enum lvl)
+{
+    auto now = log_clock::now();
+    size_t suppressed = 0;
+    auto *site_sampler = loc.site != nullptr ? loc.site->site_sampler() : nullptr;
+    if (site_sampler != nullptr)
     {
-        flush_();
+        bool allowed = site_sampler->allow(now, suppressed);
+        if (suppressed > 0)
+        {
+            log_suppressed_(loc, lvl, suppressed);
+        }
+        if (!allowed)
+        {
+            site_sampler->suppressed_by(this, lvl);
+            return false;
+        }
+    }
+    auto *logger_sampler = sampler_.load(std::memory_order_acquire);
+    if (logger_sampler != nullptr)
+    {
+        bool allowed = logger_sampler->allow(now, suppressed);
+        if (suppressed > 0)
+        {
+            log_suppressed_(loc, lvl, suppressed);
+        }
+        if (!allowed)
+        {
+            logger_sampler->suppressed_by(this, lvl);
+        }
+        return allowed;
+    }
+    return true;
+}
+
+SPDLOG_INLINE void logger::log_suppressed_(const source_loc &loc, level::level_enum lvl, size_t count)
+{
+    SPDLOG_TRY
+    {
+        auto payload = fmt_lib::format("Suppressed {} messages", count);
+        details::log_msg summary(loc, name_, lvl, payload);
+        sink_it_(summary);
+    }
+    SPDLOG_LOGGER_CATCH(loc)
+}
+
+SPDLOG_INLINE void logger::log_pending_suppressed_()
+{
+    auto lvl = level::info;
+    auto *logger_sampler = sampler_.load(std::memory_order_acquire);
+    size_t count = logger_sampler != nullptr ? logger_sampler->take_suppressed(this, lvl) : 0;
+    if (count > 0)
+    {
+        log_suppressed_(source_loc{}, lvl, count);
+    }
+
+    // the sinks are called outside of the registry lock
+    struct pending
+    {
+        source_loc loc;
+        level::level_enum lvl;
+        size_t count;
+    };
+    std::vector<pending> sites;
+    details::callsite_registry::instance().for_each([this, &sites](details::callsite &site) {
+        auto *site_sampler = site.site_sampler();
+        auto site_lvl = level::info;
+        size_t site_count = site_sampler != nullptr ? site_sampler->take_suppressed(this, site_lvl) : 0;
+        if (site_count > 0)
+        {
+            sites.push_back(pending{site.loc, site_lvl, site_count});
+        }
+    });
+    for (auto &p : sites)
+    {
+        log_suppressed_(p.loc, p.lvl, p.count);
     }
 }
 
@@ -213,7 +380,7 @@ SPDLOG_INLINE void logger::dump_backtrace_()
     if (tracer_.enabled())
     {
         sink_it_(log_msg{name(), level::info, "****************** Backtrace Start ******************"});
-        tracer_.foreach_pop([this](const log_msg &msg) { this->sink_it_(msg); });
+        tracer_.foreach_pop(name_, [this](const log_msg &msg) { this->sink_it_(msg); });
         sink_it_(log_msg{name(), level::info, "****************** Backtrace End ********************"});
     }
 }
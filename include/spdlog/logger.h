@@ -17,6 +17,11 @@
 #include <spdlog/common.h>
 #include <spdlog/details/log_msg.h>
 #include <spdlog/details/backtracer.h>
+#include <spdlog/details/callsite.h>
+#include <spdlog/details/msg_derived.h>
+#include <spdlog/details/output_cache.h>
+#include <spdlog/details/sampler.h>
+#include <spdlog/details/tail_buffer.h>
 
 #ifdef SPDLOG_WCHAR_TO_UTF8_SUPPORT
 #    ifndef _WIN32
@@ -77,7 +82,8 @@ public:
         : logger(std::move(name), sinks.begin(), sinks.end())
     {}
 
-    virtual ~logger() = default;
+    // logs the sampling summaries still pending (see flush())
+    virtual ~logger();
 
     logger(const logger &other);
     logger(logger &&other) SPDLOG_NOEXCEPT;
@@ -116,9 +122,8 @@ public:
 
     void log(log_clock::time_point log_time, source_loc loc, level::level_enum lvl, string_view_t msg)
     {
-        bool log_enabled = should_log(lvl);
-        bool traceback_enabled = tracer_.enabled();
-        if (!log_enabled && !traceback_enabled)
+        bool log_enabled, traceback_enabled;
+        if (!should_process_(loc, lvl, log_enabled, traceback_enabled))
         {
             return;
         }
@@ -129,9 +134,8 @@ public:
 
     void log(source_loc loc, level::level_enum lvl, string_view_t msg)
     {
-        bool log_enabled = should_log(lvl);
-        bool traceback_enabled = tracer_.enabled();
-        if (!log_enabled && !traceback_enabled)
+        bool log_enabled, traceback_enabled;
+        if (!should_process_(loc, lvl, log_enabled, traceback_enabled))
         {
             return;
         }
@@ -196,9 +200,8 @@ public:
 
     void log(log_clock::time_point log_time, source_loc loc, level::level_enum lvl, wstring_view_t msg)
     {
-        bool log_enabled = should_log(lvl);
-        bool traceback_enabled = tracer_.enabled();
-        if (!log_enabled && !traceback_enabled)
+        bool log_enabled, traceback_enabled;
+        if (!should_process_(loc, lvl, log_enabled, traceback_enabled))
         {
             return;
         }
@@ -211,9 +214,8 @@ public:
 
     void log(source_loc loc, level::level_enum lvl, wstring_view_t msg)
     {
-        bool log_enabled = should_log(lvl);
-        bool traceback_enabled = tracer_.enabled();
-        if (!log_enabled && !traceback_enabled)
+        bool log_enabled, traceback_enabled;
+        if (!should_process_(loc, lvl, log_enabled, traceback_enabled))
         {
             return;
         }
@@ -365,9 +367,11 @@ public:
 
     // set formatting for the sinks in this logger.
     // each sink will get a separate instance of the formatter object.
-    void set_formatter(std::unique_ptr<formatter> f);
+    // sinks whose formatters are equivalent format each message once (see formatter_sharing).
+    void set_formatter(std::unique_ptr<formatter> f, formatter_sharing sharing = formatter_sharing::automatic);
 
-    void set_pattern(std::string pattern, pattern_time_type time_type = pattern_time_type::local);
+    void set_pattern(std::string pattern, pattern_time_type time_type = pattern_time_type::local,
+        formatter_sharing sharing = formatter_sharing::automatic);
 
     // backtrace support.
     // efficiently store all debug/trace messages in a circular buffer until needed for debugging.
@@ -375,7 +379,12 @@ public:
     void disable_backtrace();
     void dump_backtrace();
 
-    // flush functions
+    // sampling of the messages that pass the level check. may be changed while other threads log.
+    // e.g: logger->set_sampling(spdlog::sampling_policy::rate_limit(100, std::chrono::seconds(1)));
+    void set_sampling(sampling_policy policy);
+
+    // flush functions. flush() first logs the sampling summaries still pending (the messages dropped
+    // by the logger's sampler, and by the call site samplers whose last dropped message was ours).
     void flush();
     void flush_on(level::level_enum log_level);
     level::level_enum flush_level() const;
@@ -398,17 +407,27 @@ protected:
     spdlog::level_t flush_level_{level::off};
     err_handler custom_err_handler_{nullptr};
     details::backtracer tracer_;
+    // allocated by the first set_sampling() and reset by the later ones: logging threads may hold it.
+    // sampler_ points to it while the sampling is on.
+    std::unique_ptr<details::sampler> sampler_storage_;
+    std::atomic<details::sampler *> sampler_{nullptr};
+    // messages below this level are dropped before formatting and passed to count_drop_()
+    // (async loggers: the load shedding level of their thread pool). nullptr: none.
+    const level_t *drop_level_ = nullptr;
 
     // common implementation for after templated public api has been resolved
     template<typename... Args>
     void log_(source_loc loc, level::level_enum lvl, const Field * fields, size_t num_fields, string_view_t fmt, Args &&... args)
     {
-        bool log_enabled = should_log(lvl);
-        bool traceback_enabled = tracer_.enabled();
-        if (!log_enabled && !traceback_enabled)
+        bool log_enabled, traceback_enabled;
+        if (!should_process_(loc, lvl, log_enabled, traceback_enabled))
         {
             return;
         }
+        if (loc.site != nullptr && !loc.site->described())
+        {
+            loc.site->describe(lvl, fmt, fields, num_fields);
+        }
         SPDLOG_TRY
         {
 #ifdef SPDLOG_USE_STD_FORMAT
@@ -427,9 +446,8 @@ protected:
     template<typename... Args>
     void log_(source_loc loc, level::level_enum lvl, wstring_view_t fmt, Args &&... args)
     {
-        bool log_enabled = should_log(lvl);
-        bool traceback_enabled = tracer_.enabled();
-        if (!log_enabled && !traceback_enabled)
+        bool log_enabled, traceback_enabled;
+        if (!should_process_(loc, lvl, log_enabled, traceback_enabled))
         {
             return;
         }
@@ -455,9 +473,8 @@ protected:
     template<class T, typename std::enable_if<std::is_convertible<const T &, spdlog::wstring_view_t>::value, int>::type = 0>
     void log_(source_loc loc, level::level_enum lvl, const T &msg)
     {
-        bool log_enabled = should_log(lvl);
-        bool traceback_enabled = tracer_.enabled();
-        if (!log_enabled && !traceback_enabled)
+        bool log_enabled, traceback_enabled;
+        if (!should_process_(loc, lvl, log_enabled, traceback_enabled))
         {
             return;
         }
@@ -473,10 +490,57 @@ protected:
 
 #endif // SPDLOG_WCHAR_TO_UTF8_SUPPORT
 
+    // level and backtrace checks for a message, honoring the runtime mode of its call site.
+    // return false if there is nothing to do with the message.
+    bool should_process_(const source_loc &loc, level::level_enum lvl, bool &log_enabled, bool &traceback_enabled)
+    {
+        auto mode = loc.site != nullptr ? loc.site->mode() : callsite_mode::by_level;
+        log_enabled = mode == callsite_mode::on || (mode == callsite_mode::by_level && should_log(lvl));
+        traceback_enabled = mode != callsite_mode::off && tracer_.enabled();
+        if (log_enabled && (sampler_.load(std::memory_order_relaxed) != nullptr || (loc.site != nullptr && loc.site->site_sampler() != nullptr)))
+        {
+            log_enabled = sample_(loc, lvl);
+        }
+        if (log_enabled && drop_level_ != nullptr && lvl < drop_level_->load(std::memory_order_relaxed))
+        {
+            log_enabled = false;
+            count_drop_(lvl);
+        }
+#ifndef SPDLOG_NO_STRUCTURED_SPDLOG
+        if (!log_enabled && !traceback_enabled)
+        {
+            return tail_capture_(loc, lvl);
+        }
+#endif
+        return log_enabled || traceback_enabled;
+    }
+
+#ifndef SPDLOG_NO_STRUCTURED_SPDLOG
+    // true if the message is below the logger level and a tail_sampling_context of this thread wants it.
+    bool tail_capture_(const source_loc &loc, level::level_enum lvl) const
+    {
+        auto *tail = details::tail_buffer::current();
+        return tail != nullptr && tail->should_capture(lvl) && !should_log(lvl) &&
+               (loc.site == nullptr || loc.site->mode() == callsite_mode::by_level);
+    }
+
+    static void tail_sink_(logger *owner, const details::log_msg &msg)
+    {
+        owner->sink_it_(msg);
+    }
+#endif
+
+    // apply the call site and logger sampling policies, logging the summary of closed windows.
+    bool sample_(const source_loc &loc, level::level_enum lvl);
+    void log_suppressed_(const source_loc &loc, level::level_enum lvl, size_t count);
+    void log_pending_suppressed_();
+
     // log the given message (if the given log level is high enough),
     // and save backtrace (if backtrace is enabled).
     void log_it_(const details::log_msg &log_msg, bool log_enabled, bool traceback_enabled);
     virtual void sink_it_(const details::log_msg &msg);
+    virtual void count_drop_(level::level_enum) {}
+    void sink_to_all_(const details::log_msg &msg);
     virtual void flush_();
     void dump_backtrace_();
     bool should_flush_(const details::log_msg &msg);
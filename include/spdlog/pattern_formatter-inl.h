@@ -7,8 +7,11 @@
 #    include <spdlog/pattern_formatter.h>
 #endif
 
+#include <spdlog/details/callsite.h>
 #include <spdlog/details/fmt_helper.h>
+#include <spdlog/details/output_cache.h>
 #include <spdlog/details/log_msg.h>
+#include <spdlog/details/msg_derived.h>
 #include <spdlog/details/os.h>
 #include <spdlog/fmt/fmt.h>
 #include <spdlog/formatter.h>
@@ -599,8 +602,9 @@ template<typename ScopedPadder>
 class z_formatter final : public flag_formatter
 {
 public:
-    explicit z_formatter(padding_info padinfo)
+    z_formatter(padding_info padinfo, pattern_time_type time_type)
         : flag_formatter(padinfo)
+        , time_type_(time_type)
     {}
 
     z_formatter() = default;
@@ -630,6 +634,7 @@ public:
     }
 
 private:
+    pattern_time_type time_type_{pattern_time_type::local};
     log_clock::time_point last_update_{std::chrono::seconds(0)};
     int offset_minutes_{0};
 
@@ -638,7 +643,7 @@ private:
         // refresh every 10 seconds
         if (msg.time - last_update_ >= std::chrono::seconds(10))
         {
-            offset_minutes_ = os::utc_minutes_offset(tm_time);
+            offset_minutes_ = msg.derived != nullptr ? msg.derived->utc_offset_minutes(time_type_) : os::utc_minutes_offset(tm_time);
             last_update_ = msg.time;
         }
         return offset_minutes_;
@@ -656,6 +661,13 @@ public:
 
     void format(const details::log_msg &msg, const std::tm &, memory_buf_t &dest) override
     {
+        if (msg.derived != nullptr)
+        {
+            auto text = msg.derived->thread_id();
+            ScopedPadder p(text.size(), padinfo_, dest);
+            fmt_helper::append_string_view(text, dest);
+            return;
+        }
         const auto field_size = ScopedPadder::count_digits(msg.thread_id);
         ScopedPadder p(field_size, padinfo_, dest);
         fmt_helper::append_int(msg.thread_id, dest);
@@ -858,31 +870,10 @@ public:
         : flag_formatter(padinfo)
     {}
 
-#ifdef _MSC_VER
-#    pragma warning(push)
-#    pragma warning(disable : 4127) // consider using 'if constexpr' instead
-#endif                              // _MSC_VER
     static const char *basename(const char *filename)
     {
-        // if the size is 2 (1 character + null terminator) we can use the more efficient strrchr
-        // the branch will be elided by optimizations
-        if (sizeof(os::folder_seps) == 2)
-        {
-            const char *rv = std::strrchr(filename, os::folder_seps[0]);
-            return rv != nullptr ? rv + 1 : filename;
-        }
-        else
-        {
-            const std::reverse_iterator<const char *> begin(filename + std::strlen(filename));
-            const std::reverse_iterator<const char *> end(filename);
-
-            const auto it = std::find_first_of(begin, end, std::begin(os::folder_seps), std::end(os::folder_seps) - 1);
-            return it != end ? it.base() : filename;
-        }
+        return msg_derived::basename(filename);
     }
-#ifdef _MSC_VER
-#    pragma warning(pop)
-#endif // _MSC_VER
 
     void format(const details::log_msg &msg, const std::tm &, memory_buf_t &dest) override
     {
@@ -890,7 +881,9 @@ public:
         {
             return;
         }
-        auto filename = basename(msg.source.filename);
+        auto filename = msg.derived != nullptr         ? msg.derived->short_filename()
+                        : msg.source.site != nullptr ? msg.source.site->short_filename
+                                                     : basename(msg.source.filename);
         size_t text_size = padinfo_.enabled() ? std::char_traits<char>::length(filename) : 0;
         ScopedPadder p(text_size, padinfo_, dest);
         fmt_helper::append_string_view(filename, dest);
@@ -939,6 +932,28 @@ public:
     }
 };
 
+// id of the static call site descriptor (empty if the message was not logged by a SPDLOG_ macro)
+template<typename ScopedPadder>
+class callsite_id_formatter final : public flag_formatter
+{
+public:
+    explicit callsite_id_formatter(padding_info padinfo)
+        : flag_formatter(padinfo)
+    {}
+
+    void format(const details::log_msg &msg, const std::tm &, memory_buf_t &dest) override
+    {
+        if (msg.source.site == nullptr)
+        {
+            return;
+        }
+        auto id = msg.source.site->id();
+        auto field_size = ScopedPadder::count_digits(id);
+        ScopedPadder p(field_size, padinfo_, dest);
+        fmt_helper::append_int(id, dest);
+    }
+};
+
 // print elapsed time since last message
 template<typename ScopedPadder, typename Units>
 class elapsed_formatter final : public flag_formatter
@@ -971,8 +986,9 @@ private:
 class full_formatter final : public flag_formatter
 {
 public:
-    explicit full_formatter(padding_info padinfo)
+    explicit full_formatter(padding_info padinfo, pattern_time_type time_type = pattern_time_type::local)
         : flag_formatter(padinfo)
+        , time_type_(time_type)
     {}
 
     void format(const details::log_msg &msg, const std::tm &tm_time, memory_buf_t &dest) override
@@ -985,7 +1001,14 @@ public:
         auto duration = msg.time.time_since_epoch();
         auto secs = duration_cast<seconds>(duration);
 
-        if (cache_timestamp_ != secs || cached_datetime_.size() == 0)
+        if ((cache_timestamp_ != secs || cached_datetime_.size() == 0) && msg.derived != nullptr)
+        {
+            auto prefix = msg.derived->date_prefix(time_type_);
+            cached_datetime_.clear();
+            cached_datetime_.append(prefix.data(), prefix.data() + prefix.size());
+            cache_timestamp_ = secs;
+        }
+        else if (cache_timestamp_ != secs || cached_datetime_.size() == 0)
         {
             cached_datetime_.clear();
             cached_datetime_.push_back('[');
@@ -1038,7 +1061,9 @@ public:
         if (!msg.source.empty())
         {
             dest.push_back('[');
-            const char *filename = details::short_filename_formatter<details::null_scoped_padder>::basename(msg.source.filename);
+            const char *filename = msg.derived != nullptr         ? msg.derived->short_filename()
+                                   : msg.source.site != nullptr ? msg.source.site->short_filename
+                                                                : msg_derived::basename(msg.source.filename);
             fmt_helper::append_string_view(filename, dest);
             dest.push_back(':');
             fmt_helper::append_int(msg.source.line, dest);
@@ -1061,6 +1086,7 @@ public:
     }
 
 private:
+    pattern_time_type time_type_;
     std::chrono::seconds cache_timestamp_{0};
     memory_buf_t cached_datetime_;
 };
@@ -1087,7 +1113,8 @@ SPDLOG_INLINE pattern_formatter::pattern_formatter(pattern_time_type time_type,
     , last_log_secs_(0)
 {
     std::memset(&cached_tm_, 0, sizeof(cached_tm_));
-    formatters_.push_back(details::make_unique<details::full_formatter>(details::padding_info{}));
+    formatters_.push_back(details::make_unique<details::full_formatter>(details::padding_info{}, pattern_time_type_));
+    update_share_key_();
 }
 
 SPDLOG_INLINE std::unique_ptr<formatter> pattern_formatter::clone() const
@@ -1102,10 +1129,16 @@ SPDLOG_INLINE std::unique_ptr<formatter> pattern_formatter::clone() const
 
 SPDLOG_INLINE void pattern_formatter::format(const details::log_msg &msg, memory_buf_t &dest)
 {
+    auto *shared_output = share_key_ != 0 && dest.size() == 0 ? msg.shared_output : nullptr;
+    if (shared_output != nullptr && shared_output->fetch(share_key_, msg, dest))
+    {
+        return;
+    }
+
     auto secs = std::chrono::duration_cast<std::chrono::seconds>(msg.time.time_since_epoch());
     if (secs != last_log_secs_)
     {
-        cached_tm_ = get_time_(msg);
+        cached_tm_ = msg.derived != nullptr ? msg.derived->tm(pattern_time_type_) : get_time_(msg);
         last_log_secs_ = secs;
     }
 
@@ -1115,6 +1148,11 @@ SPDLOG_INLINE void pattern_formatter::format(const details::log_msg &msg, memory
     }
     // write eol
     details::fmt_helper::append_string_view(eol_, dest);
+
+    if (shared_output != nullptr)
+    {
+        shared_output->store(share_key_, msg, dest);
+    }
 }
 
 SPDLOG_INLINE void pattern_formatter::set_pattern(std::string pattern)
@@ -1141,6 +1179,7 @@ SPDLOG_INLINE void pattern_formatter::handle_flag_(char flag, details::padding_i
     {
         auto custom_handler = it->second->clone();
         custom_handler->set_padding_info(padding);
+        shareable_ = false; // may hold state or depend on more than the message
         formatters_.push_back(std::move(custom_handler));
         return;
     }
@@ -1149,7 +1188,7 @@ SPDLOG_INLINE void pattern_formatter::handle_flag_(char flag, details::padding_i
     switch (flag)
     {
     case ('+'): // default formatter
-        formatters_.push_back(details::make_unique<details::full_formatter>(padding));
+        formatters_.push_back(details::make_unique<details::full_formatter>(padding, pattern_time_type_));
         break;
 
     case 'n': // logger name
@@ -1268,7 +1307,7 @@ SPDLOG_INLINE void pattern_formatter::handle_flag_(char flag, details::padding_i
         break;
 
     case ('z'): // timezone
-        formatters_.push_back(details::make_unique<details::z_formatter<Padder>>(padding));
+        formatters_.push_back(details::make_unique<details::z_formatter<Padder>>(padding, pattern_time_type_));
         break;
 
     case ('P'): // pid
@@ -1303,24 +1342,32 @@ SPDLOG_INLINE void pattern_formatter::handle_flag_(char flag, details::padding_i
         formatters_.push_back(details::make_unique<details::source_funcname_formatter<Padder>>(padding));
         break;
 
+    case ('k'): // call site id
+        formatters_.push_back(details::make_unique<details::callsite_id_formatter<Padder>>(padding));
+        break;
+
     case ('%'): // % char
         formatters_.push_back(details::make_unique<details::ch_formatter>('%'));
         break;
 
     case ('u'): // elapsed time since last log message in nanos
         formatters_.push_back(details::make_unique<details::elapsed_formatter<Padder, std::chrono::nanoseconds>>(padding));
+        shareable_ = false; // depends on the previous message seen by this instance
         break;
 
     case ('i'): // elapsed time since last log message in micros
         formatters_.push_back(details::make_unique<details::elapsed_formatter<Padder, std::chrono::microseconds>>(padding));
+        shareable_ = false; // depends on the previous message seen by this instance
         break;
 
     case ('o'): // elapsed time since last log message in millis
         formatters_.push_back(details::make_unique<details::elapsed_formatter<Padder, std::chrono::milliseconds>>(padding));
+        shareable_ = false; // depends on the previous message seen by this instance
         break;
 
     case ('O'): // elapsed time since last log message in seconds
         formatters_.push_back(details::make_unique<details::elapsed_formatter<Padder, std::chrono::seconds>>(padding));
+        shareable_ = false; // depends on the previous message seen by this instance
         break;
 
     default: // Unknown flag appears as is
@@ -1408,6 +1455,7 @@ SPDLOG_INLINE void pattern_formatter::compile_pattern_(const std::string &patter
     auto end = pattern.end();
     std::unique_ptr<details::aggregate_formatter> user_chars;
     formatters_.clear();
+    shareable_ = true;
     for (auto it = pattern.begin(); it != end; ++it)
     {
         if (*it == '%')
@@ -1448,5 +1496,21 @@ SPDLOG_INLINE void pattern_formatter::compile_pattern_(const std::string &patter
     {
         formatters_.push_back(std::move(user_chars));
     }
+    update_share_key_();
+}
+
+SPDLOG_INLINE void pattern_formatter::update_share_key_()
+{
+    if (!shareable_)
+    {
+        share_key_ = 0;
+        return;
+    }
+    std::string description{"pattern:"};
+    description += pattern_time_type_ == pattern_time_type::local ? 'l' : 'u';
+    description += eol_;
+    description += '\0';
+    description += pattern_;
+    share_key_ = details::format_share_key(description);
 }
 } // namespace spdlog
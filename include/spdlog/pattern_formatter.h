@@ -90,6 +90,11 @@ public:
 
     std::unique_ptr<formatter> clone() const override;
     void format(const details::log_msg &msg, memory_buf_t &dest) override;
+    // patterns with custom or elapsed time flags are not shared
+    size_t share_key() const override
+    {
+        return share_key_;
+    }
 
     template<typename T, typename... Args>
     pattern_formatter &add_flag(char flag, Args &&... args)
@@ -107,6 +112,8 @@ private:
     std::chrono::seconds last_log_secs_;
     std::vector<std::unique_ptr<details::flag_formatter>> formatters_;
     custom_flags custom_handlers_;
+    bool shareable_ = true;
+    size_t share_key_ = 0;
 
     std::tm get_time_(const details::log_msg &msg);
     template<typename Padder>
@@ -118,6 +125,7 @@ private:
     static details::padding_info handle_padspec_(std::string::const_iterator &it, std::string::const_iterator end);
 
     void compile_pattern_(const std::string &pattern);
+    void update_share_key_();
 };
 } // namespace spdlog
 
@@ -30,9 +30,12 @@ public:
     base_sink &operator=(base_sink &&) = delete;
 
     void log(const details::log_msg &msg) final;
+    void log_batch(const details::log_msg *msgs, size_t count) final;
     void flush() final;
     void set_pattern(const std::string &pattern) final;
     void set_formatter(std::unique_ptr<spdlog::formatter> sink_formatter) final;
+    size_t formatter_share_key() override;
+    std::unique_ptr<spdlog::formatter> clone_formatter() override;
 
 protected:
     // sink formatter
@@ -40,6 +43,8 @@ protected:
     Mutex mutex_;
 
     virtual void sink_it_(const details::log_msg &msg) = 0;
+    // called with the mutex held. the default calls sink_it_() for each message.
+    virtual void sink_batch_(const details::log_msg *msgs, size_t count);
     virtual void flush_() = 0;
     virtual void set_pattern_(const std::string &pattern);
     virtual void set_formatter_(std::unique_ptr<spdlog::formatter> sink_formatter);
@@ -34,6 +34,22 @@ SPDLOG_INLINE void basic_file_sink<Mutex>::sink_it_(const details::log_msg &msg)
     file_helper_.write(formatted);
 }
 
+// format the whole batch and write it at once
+template<typename Mutex>
+SPDLOG_INLINE void basic_file_sink<Mutex>::sink_batch_(const details::log_msg *msgs, size_t count)
+{
+    memory_buf_t formatted;
+    memory_buf_t batch;
+    for (size_t i = 0; i < count; i++)
+    {
+        // format each message on its own so the formatter may reuse an output shared with other sinks
+        formatted.clear();
+        base_sink<Mutex>::formatter_->format(msgs[i], formatted);
+        batch.append(formatted.data(), formatted.data() + formatted.size());
+    }
+    file_helper_.write(batch);
+}
+
 template<typename Mutex>
 SPDLOG_INLINE void basic_file_sink<Mutex>::flush_()
 {
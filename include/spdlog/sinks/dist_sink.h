@@ -54,6 +54,12 @@ public:
         return sinks_;
     }
 
+    // the sub sinks format the messages themselves
+    size_t formatter_share_key() override
+    {
+        return 0;
+    }
+
 protected:
     void sink_it_(const details::log_msg &msg) override
     {
@@ -15,6 +15,13 @@ namespace sinks {
 template<typename Mutex>
 class null_sink : public base_sink<Mutex>
 {
+public:
+    // nothing to format
+    size_t formatter_share_key() override
+    {
+        return 0;
+    }
+
 protected:
     void sink_it_(const details::log_msg &) override {}
     void flush_() override {}
@@ -23,3 +23,21 @@ SPDLOG_INLINE spdlog::level::level_enum spdlog::sinks::sink::level() const
 {
     return static_cast<spdlog::level::level_enum>(level_.load(std::memory_order_relaxed));
 }
+
+SPDLOG_INLINE void spdlog::sinks::sink::log_batch(const details::log_msg *msgs, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        log(msgs[i]);
+    }
+}
+
+SPDLOG_INLINE size_t spdlog::sinks::sink::formatter_share_key()
+{
+    return 0;
+}
+
+SPDLOG_INLINE std::unique_ptr<spdlog::formatter> spdlog::sinks::sink::clone_formatter()
+{
+    return nullptr;
+}
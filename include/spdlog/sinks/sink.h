@@ -14,10 +14,19 @@ class SPDLOG_API sink
 public:
     virtual ~sink() = default;
     virtual void log(const details::log_msg &msg) = 0;
+    // log count messages, all of them passing should_log(). the default logs them one by one;
+    // sinks that can take a batch at once (one lock, one write) override it.
+    virtual void log_batch(const details::log_msg *msgs, size_t count);
     virtual void flush() = 0;
     virtual void set_pattern(const std::string &pattern) = 0;
     virtual void set_formatter(std::unique_ptr<spdlog::formatter> sink_formatter) = 0;
 
+    // let other threads format the messages of this sink ahead of time (thread_pool_options::format_threads):
+    // the share key of the sink's formatter (0, the default: its output can't be formatted elsewhere)
+    // and a copy of that formatter.
+    virtual size_t formatter_share_key();
+    virtual std::unique_ptr<spdlog::formatter> clone_formatter();
+
     void set_level(level::level_enum log_level);
     level::level_enum level() const;
     bool should_log(level::level_enum msg_level) const;
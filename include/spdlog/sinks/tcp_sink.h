@@ -69,6 +69,24 @@ protected:
         client_.send(formatted.data(), formatted.size());
     }
 
+    // send the whole batch at once
+    void sink_batch_(const spdlog::details::log_msg *msgs, size_t count) override
+    {
+        spdlog::memory_buf_t formatted;
+        spdlog::memory_buf_t batch;
+        for (size_t i = 0; i < count; i++)
+        {
+            formatted.clear();
+            spdlog::sinks::base_sink<Mutex>::formatter_->format(msgs[i], formatted);
+            batch.append(formatted.data(), formatted.data() + formatted.size());
+        }
+        if (!client_.is_connected())
+        {
+            client_.connect(config_.server_host, config_.server_port);
+        }
+        client_.send(batch.data(), batch.size());
+    }
+
     void flush_() override {}
     tcp_sink_config config_;
     details::tcp_client client_;
@@ -107,6 +107,21 @@ SPDLOG_INLINE void set_automatic_registration(bool automatic_registration)
     details::registry::instance().set_automatic_registration(automatic_registration);
 }
 
+SPDLOG_INLINE void set_callsite_mode(const std::string &selector, callsite_mode mode)
+{
+    details::callsite_registry::instance().set_mode(selector, mode);
+}
+
+SPDLOG_INLINE void reset_callsite_modes()
+{
+    details::callsite_registry::instance().reset_modes();
+}
+
+SPDLOG_INLINE void set_callsite_sampling(const std::string &selector, sampling_policy policy)
+{
+    details::callsite_registry::instance().set_sampling(selector, policy);
+}
+
 SPDLOG_INLINE std::shared_ptr<spdlog::logger> default_logger()
 {
     return details::registry::instance().default_logger();
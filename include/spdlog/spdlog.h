@@ -106,6 +106,21 @@ SPDLOG_API void shutdown();
 // Automatic registration of loggers when using spdlog::create() or spdlog::create_async
 SPDLOG_API void set_automatic_registration(bool automatic_registration);
 
+// Runtime switches for the call sites of the SPDLOG_ logging macros (like Linux dynamic_debug).
+// The selector is a file glob ("net/*.cpp"), a file glob and line ("parser.cpp:120")
+// or a function glob ("handle_*()"). Sites compiled out by SPDLOG_ACTIVE_LEVEL are not affected.
+// Throws spdlog_ex on an empty selector or a line number out of range.
+// e.g: spdlog::set_callsite_mode("parser.cpp", spdlog::callsite_mode::on);
+SPDLOG_API void set_callsite_mode(const std::string &selector, callsite_mode mode);
+
+// Return all call sites to callsite_mode::by_level
+SPDLOG_API void reset_callsite_modes();
+
+// Sample or rate limit the call sites matching the selector (same syntax as set_callsite_mode()).
+// Each matching site gets its own lock free sampler; sampling_policy{} removes the sampling.
+// e.g: spdlog::set_callsite_sampling("retry_loop()", spdlog::sampling_policy::first_n(10, std::chrono::seconds(1)));
+SPDLOG_API void set_callsite_sampling(const std::string &selector, sampling_policy policy);
+
 // API for using default logger (stdout_color_mt),
 // e.g: spdlog::info("Message {}", 1);
 //
@@ -322,7 +337,14 @@ inline void critical(const T &msg)
 // SPDLOG_LEVEL_OFF
 //
 
-#define SPDLOG_LOGGER_CALL(logger, level, ...) (logger)->log(spdlog::source_loc{__FILE__, __LINE__, SPDLOG_FUNCTION}, level, __VA_ARGS__)
+// Each expansion owns a static spdlog::details::callsite, created on first use.
+#define SPDLOG_CALLSITE_LOC()                                                                                                              \
+    [](const char *spdlog_func_) -> const spdlog::source_loc & {                                                                           \
+        static spdlog::details::callsite spdlog_site_{__FILE__, __LINE__, spdlog_func_};                                                   \
+        return spdlog_site_.loc;                                                                                                           \
+    }(SPDLOG_FUNCTION)
+
+#define SPDLOG_LOGGER_CALL(logger, level, ...) (logger)->log(SPDLOG_CALLSITE_LOC(), level, __VA_ARGS__)
 
 #if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_TRACE
 #    define SPDLOG_LOGGER_TRACE(logger, ...) SPDLOG_LOGGER_CALL(logger, spdlog::level::trace, __VA_ARGS__)
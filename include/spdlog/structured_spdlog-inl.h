@@ -12,6 +12,10 @@
 #    include <spdlog/structured_spdlog.h>
 #endif
 
+#include <spdlog/details/fmt_helper.h>
+
+#include <cassert>
+
 // TODO(opt): static field names on the stack
 //    Rather than passing std::initializer_list<Field>, I intuit that we should be able to construct
 //    templates such that log_ eventually gets passed a std::array<string_view,N> && names and
@@ -184,6 +188,22 @@ SPDLOG_INLINE replacement_context::~replacement_context()
     details::threadlocal_context_head() = old_context_fields_;
 }
 
+//
+// Tail sampling
+//
+SPDLOG_INLINE tail_sampling_context::tail_sampling_context(std::initializer_list<Field> fields, size_t max_messages,
+    level::level_enum capture_level, level::level_enum trigger_level) :
+    context_(fields), buffer_(max_messages, capture_level, trigger_level, details::threadlocal_tail_buffer())
+{
+    details::threadlocal_tail_buffer() = &buffer_;
+}
+
+SPDLOG_INLINE tail_sampling_context::~tail_sampling_context()
+{
+    buffer_.discard();
+    details::threadlocal_tail_buffer() = buffer_.parent();
+}
+
 
 } // namespace spdlog
 
@@ -9,6 +9,7 @@
 #pragma once
 
 #include "spdlog/common.h"
+#include "spdlog/details/tail_buffer.h"
 
 #include <iterator>
 
@@ -159,6 +160,48 @@ private:
 };
 
 
+/**
+    tail_sampling_context is a context that also captures the messages logged on this thread
+    below their logger level (but at least capture_level) into a private buffer.
+    The buffer is sent to the sinks if a message at trigger_level or above is logged within the
+    context, or if promote() is called, and is discarded otherwise. Once promoted, the messages at
+    capture_level or above logged within the context go straight to the sinks.
+
+    Useful for keeping debug detail only for the requests that fail:
+
+        void handle(const request &req) {
+            spdlog::tail_sampling_context ctx({{"req_id", req.id}});
+            spdlog::debug("parsing");      // buffered
+            if (!process(req)) {
+                spdlog::error("failed");   // "parsing" is logged before "failed"
+            }
+        }                                  // on success the debug messages are dropped
+
+    Messages logged by other threads (even with a snapshot of this context) are not captured.
+    The loggers used within the context must outlive it.
+**/
+class SPDLOG_API tail_sampling_context final {
+public:
+    tail_sampling_context(std::initializer_list<Field> fields, size_t max_messages = 256,
+        level::level_enum capture_level = level::trace, level::level_enum trigger_level = level::err);
+    ~tail_sampling_context();
+    tail_sampling_context(const tail_sampling_context &) = delete;
+    tail_sampling_context &operator=(const tail_sampling_context &) = delete;
+
+    // send the captured messages to the sinks now
+    void promote() { buffer_.promote(); }
+    bool promoted() const { return buffer_.promoted(); }
+
+    // number of messages currently captured
+    size_t buffered() const { return buffer_.size(); }
+
+    // number of captured messages lost because the buffer was full
+    size_t dropped() const { return buffer_.dropped(); }
+private:
+    context context_;
+    details::tail_buffer buffer_;
+};
+
 } // namespace spdlog
 
 #endif // STRUCTURED_SPDLOG_H
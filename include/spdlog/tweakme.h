@@ -133,3 +133,12 @@
 // # define SPDLOG_FUNCTION __FUNCTION__
 // #endif
 ///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Uncomment to change how much a buffered message (async queue, ringbuffer
+// sink, tail sampling) keeps inline before allocating: bytes for the logger
+// name, payload and field strings, and number of fields.
+//
+// #define SPDLOG_MSG_BUFFER_INLINE_BYTES 250
+// #define SPDLOG_MSG_BUFFER_INLINE_FIELDS 3
+///////////////////////////////////////////////////////////////////////////////
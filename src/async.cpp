@@ -7,7 +7,10 @@
 
 #include <spdlog/async.h>
 #include <spdlog/async_logger-inl.h>
+#include <spdlog/details/mpsc_byte_ring-inl.h>
 #include <spdlog/details/periodic_worker-inl.h>
+#include <spdlog/details/spill_file-inl.h>
 #include <spdlog/details/thread_pool-inl.h>
 
-template class SPDLOG_API spdlog::details::mpmc_blocking_queue<spdlog::details::async_msg>;
+template class SPDLOG_API spdlog::details::mpmc_ring_queue<spdlog::details::async_msg>;
+template class SPDLOG_API spdlog::details::spsc_merge_queue<spdlog::details::async_msg>;
@@ -8,6 +8,9 @@
 #include <spdlog/spdlog-inl.h>
 #include <spdlog/common-inl.h>
 #include <spdlog/details/backtracer-inl.h>
+#include <spdlog/details/callsite-inl.h>
+#include <spdlog/details/sampler-inl.h>
+#include <spdlog/details/tail_buffer-inl.h>
 #include <spdlog/details/registry-inl.h>
 #include <spdlog/details/os-inl.h>
 #include <spdlog/json_formatter-inl.h>
@@ -15,6 +18,9 @@
 #include <spdlog/structured_spdlog-inl.h>
 #include <spdlog/details/log_msg-inl.h>
 #include <spdlog/details/log_msg_buffer-inl.h>
+#include <spdlog/details/msg_derived-inl.h>
+#include <spdlog/details/msg_record-inl.h>
+#include <spdlog/details/output_cache-inl.h>
 #include <spdlog/logger-inl.h>
 #include <spdlog/sinks/sink-inl.h>
 #include <spdlog/sinks/base_sink-inl.h>
@@ -1,6 +1,8 @@
 #include "includes.h"
 #include "spdlog/async.h"
+#include "spdlog/details/output_cache.h"
 #include "spdlog/sinks/basic_file_sink.h"
+#include "spdlog/sinks/ostream_sink.h"
 #include "test_sink.h"
 
 #define TEST_FILENAME "test_logs/async_test.log"
@@ -62,6 +64,179 @@ TEST_CASE("discard policy using factory ", "[async]")
     spdlog::drop_all();
 }
 
+TEST_CASE("discard new policy", "[async]")
+{
+    for (auto topology : {spdlog::async_queue_topology::shared, spdlog::async_queue_topology::per_thread,
+             spdlog::async_queue_topology::byte_ring})
+    {
+        auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+        test_sink->set_pattern("%l %v");
+        size_t messages = 200;
+        spdlog::thread_pool_options options;
+        options.topology = topology;
+        options.queue_size = 8;
+        options.per_thread_queue_size = 8;
+        options.queue_bytes = 1024;
+        options.drop_report_interval = std::chrono::milliseconds::zero();
+        auto tp = std::make_shared<spdlog::details::thread_pool>(options);
+        auto logger = std::make_shared<spdlog::async_logger>("as", test_sink, tp, spdlog::async_overflow_policy::discard_new);
+        logger->info("first");
+        test_sink->set_delay(std::chrono::milliseconds(5));
+        for (size_t i = 1; i < messages; i++)
+        {
+            logger->log(i % 2 == 0 ? spdlog::level::info : spdlog::level::warn, "Hello message #{}", i);
+        }
+        auto dropped = logger->dropped();
+        REQUIRE(dropped > 0);
+        REQUIRE(logger->dropped(spdlog::level::info) + logger->dropped(spdlog::level::warn) == dropped);
+        REQUIRE(tp->overrun_counter() == 0);
+        logger.reset();
+
+        // the gaps are reported once the queue drained (the last report by the logger's destruction)
+        size_t reports = 0;
+        size_t reported = 0;
+        for (auto &line : test_sink->lines())
+        {
+            std::string prefix = "warning dropped ";
+            if (line.compare(0, prefix.size(), prefix) == 0)
+            {
+                reports++;
+                reported += std::stoul(line.substr(prefix.size()));
+                REQUIRE(line.find(" messages (") != std::string::npos);
+            }
+        }
+        REQUIRE(reports > 0);
+        REQUIRE(reported == dropped);
+        REQUIRE(test_sink->msg_counter() == messages - dropped + reports);
+    }
+}
+
+TEST_CASE("priority lane", "[async]")
+{
+    for (auto topology : {spdlog::async_queue_topology::shared, spdlog::async_queue_topology::per_thread,
+             spdlog::async_queue_topology::byte_ring, spdlog::async_queue_topology::sharded})
+    {
+        for (bool lane : {true, false})
+        {
+            auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+            test_sink->set_pattern("%v");
+            size_t messages = 200;
+            spdlog::thread_pool_options options;
+            options.topology = topology;
+            options.priority_level = spdlog::level::err;
+            {
+                auto tp = std::make_shared<spdlog::details::thread_pool>(options);
+                auto logger = std::make_shared<spdlog::async_logger>("as", test_sink, tp);
+                logger->set_priority_lane(lane);
+                // the worker thread is busy with the first message while the others pile up
+                test_sink->set_delay(std::chrono::milliseconds(100));
+                logger->info("first");
+                for (size_t i = 1; i < messages; i++)
+                {
+                    logger->info("Hello message #{}", i);
+                }
+                logger->error("error");
+                test_sink->set_delay(std::chrono::milliseconds::zero());
+            }
+            REQUIRE(test_sink->msg_counter() == messages + 1);
+            auto lines = test_sink->lines();
+            auto error_at = std::find(lines.begin(), lines.end(), "error") - lines.begin();
+            if (lane)
+            {
+                // behind at most the first batch
+                REQUIRE(error_at <= static_cast<std::ptrdiff_t>(options.max_batch + 1));
+            }
+            else
+            {
+                REQUIRE(error_at == static_cast<std::ptrdiff_t>(lines.size()));
+            }
+        }
+    }
+
+    spdlog::thread_pool_options options;
+    options.priority_level = spdlog::level::err;
+    options.format_threads = 2;
+    REQUIRE_THROWS_AS(spdlog::details::thread_pool(options), spdlog::spdlog_ex);
+
+    // a logger's lane messages would be written by another worker thread than its other ones
+    options.format_threads = 0;
+    options.threads = 2;
+    for (auto topology : {spdlog::async_queue_topology::shared, spdlog::async_queue_topology::sharded})
+    {
+        options.topology = topology;
+        REQUIRE_THROWS_AS(spdlog::details::thread_pool(options), spdlog::spdlog_ex);
+    }
+}
+
+TEST_CASE("load shedding", "[async]")
+{
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+    size_t messages = 200;
+    spdlog::thread_pool_options options;
+    options.queue_size = 64;
+    options.load_shedding = {{32, 8, spdlog::level::info}};
+    std::vector<spdlog::level::level_enum> transitions;
+    std::mutex transitions_mutex;
+    options.on_load_shedding = [&transitions, &transitions_mutex](spdlog::level::level_enum lvl) {
+        std::lock_guard<std::mutex> lock(transitions_mutex);
+        transitions.push_back(lvl);
+    };
+    size_t dropped_debug;
+    size_t dropped_info;
+    {
+        auto tp = std::make_shared<spdlog::details::thread_pool>(options);
+        auto logger = std::make_shared<spdlog::async_logger>("as", test_sink, tp);
+        logger->set_level(spdlog::level::trace);
+        test_sink->set_delay(std::chrono::milliseconds(2));
+        for (size_t i = 0; i < messages; i++)
+        {
+            logger->log(i % 2 == 0 ? spdlog::level::debug : spdlog::level::info, "Hello message #{}", i);
+        }
+        spdlog::details::os::sleep_for_millis(50);
+        tp->retire_barrier();
+        REQUIRE(tp->shed_level() == spdlog::level::trace);
+        dropped_debug = logger->dropped(spdlog::level::debug);
+        dropped_info = logger->dropped(spdlog::level::info);
+    }
+    // debug messages shed while the queue was above the high watermark, then everything again once drained
+    REQUIRE(dropped_debug > 0);
+    REQUIRE(dropped_info == 0);
+    REQUIRE(transitions == std::vector<spdlog::level::level_enum>{spdlog::level::info, spdlog::level::trace});
+
+    options.load_shedding = {{32, 8, spdlog::level::info}, {16, 8, spdlog::level::warn}};
+    REQUIRE_THROWS_AS(spdlog::details::thread_pool(options), spdlog::spdlog_ex);
+    options.load_shedding = {{32, 40, spdlog::level::info}};
+    REQUIRE_THROWS_AS(spdlog::details::thread_pool(options), spdlog::spdlog_ex);
+}
+
+TEST_CASE("load shedding before formatting", "[async]")
+{
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+    spdlog::thread_pool_options options;
+    options.queue_size = 64;
+    options.load_shedding = {{32, 8, spdlog::level::info}};
+    std::atomic<bool> shedding{false};
+    options.on_load_shedding = [&shedding](spdlog::level::level_enum lvl) { shedding = lvl == spdlog::level::info; };
+    auto tp = std::make_shared<spdlog::details::thread_pool>(options);
+    auto logger = std::make_shared<spdlog::async_logger>("as", test_sink, tp);
+    logger->set_level(spdlog::level::trace);
+    size_t errors = 0;
+    logger->set_error_handler([&errors](const std::string &) { errors++; });
+    test_sink->set_delay(std::chrono::milliseconds(2));
+    while (!shedding)
+    {
+        logger->info("Hello message");
+    }
+    // the bad format string would only be noticed by formatting the message
+#ifdef SPDLOG_USE_STD_FORMAT
+    logger->debug("Bad format msg {} {}", 1);
+#else
+    logger->debug(fmt::runtime("Bad format msg {} {}"), 1);
+#endif
+    REQUIRE(errors == 0);
+    REQUIRE(logger->dropped(spdlog::level::debug) == 1);
+}
+
 TEST_CASE("flush", "[async]")
 {
     auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
@@ -114,6 +289,18 @@ TEST_CASE("tp->wait_empty() ", "[async]")
     REQUIRE(test_sink->flush_counter() == 1);
 }
 
+TEST_CASE("log after the thread pool is gone", "[async]")
+{
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+    auto tp = std::make_shared<spdlog::details::thread_pool>(16, 1);
+    auto logger = std::make_shared<spdlog::async_logger>("as", test_sink, tp);
+    logger->info("before");
+    tp.reset();
+    REQUIRE(test_sink->msg_counter() == 1);
+    REQUIRE_THROWS_AS(logger->info("after"), spdlog::spdlog_ex);
+    REQUIRE_THROWS_AS(logger->flush(), spdlog::spdlog_ex);
+}
+
 TEST_CASE("multi threads", "[async]")
 {
     auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
@@ -146,6 +333,777 @@ TEST_CASE("multi threads", "[async]")
     REQUIRE(test_sink->flush_counter() == n_threads);
 }
 
+TEST_CASE("per_thread queues", "[async]")
+{
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+    size_t messages = 256;
+    size_t n_threads = 10;
+    spdlog::thread_pool_options options;
+    options.topology = spdlog::async_queue_topology::per_thread;
+    options.per_thread_queue_size = 16;
+    {
+        auto tp = std::make_shared<spdlog::details::thread_pool>(options);
+        auto logger = std::make_shared<spdlog::async_logger>("as", test_sink, tp, spdlog::async_overflow_policy::block);
+
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < n_threads; i++)
+        {
+            threads.emplace_back([logger, messages] {
+                for (size_t j = 0; j < messages; j++)
+                {
+                    logger->info("Hello message #{}", j);
+                }
+                logger->flush();
+            });
+        }
+
+        for (auto &t : threads)
+        {
+            t.join();
+        }
+    }
+
+    REQUIRE(test_sink->msg_counter() == messages * n_threads);
+    REQUIRE(test_sink->flush_counter() == n_threads);
+
+    // the rings are merged by a single worker
+    options.threads = 2;
+    REQUIRE_THROWS_AS(spdlog::details::thread_pool(options), spdlog::spdlog_ex);
+}
+
+// records the batch sizes. the first message waits so the next ones pile up in the queue.
+class batch_sink : public spdlog::sinks::base_sink<std::mutex>
+{
+public:
+    std::vector<size_t> batches;
+    size_t messages = 0;
+    size_t without_derived = 0;
+
+protected:
+    void sink_it_(const spdlog::details::log_msg &msg) override
+    {
+        if (msg.derived == nullptr)
+        {
+            without_derived++;
+        }
+        if (messages++ == 0)
+        {
+            spdlog::details::os::sleep_for_millis(50);
+        }
+    }
+
+    void sink_batch_(const spdlog::details::log_msg *msgs, size_t count) override
+    {
+        batches.push_back(count);
+        base_sink<std::mutex>::sink_batch_(msgs, count);
+    }
+
+    void flush_() override {}
+};
+
+TEST_CASE("batches", "[async]")
+{
+    auto sink = std::make_shared<batch_sink>();
+    auto filtering_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+    filtering_sink->set_level(spdlog::level::warn);
+    size_t messages = 100;
+    spdlog::thread_pool_options options;
+    options.max_batch = 16;
+    {
+        auto tp = std::make_shared<spdlog::details::thread_pool>(options);
+        auto logger = std::make_shared<spdlog::async_logger>("as", spdlog::sinks_init_list{sink, filtering_sink}, tp);
+        logger->info("first");
+        spdlog::details::os::sleep_for_millis(10);
+        for (size_t i = 0; i < messages; i++)
+        {
+            logger->log(i % 10 == 0 ? spdlog::level::warn : spdlog::level::info, "Hello message #{}", i);
+        }
+    }
+
+    REQUIRE(sink->messages == messages + 1);
+    REQUIRE(sink->without_derived == 0);
+    REQUIRE(filtering_sink->msg_counter() == messages / 10);
+    REQUIRE(sink->batches.size() >= messages / 16);
+    REQUIRE(sink->batches.size() < messages);
+    for (auto count : sink->batches)
+    {
+        REQUIRE(count <= 16);
+    }
+}
+
+TEST_CASE("byte_ring", "[async]")
+{
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+    size_t messages = 256;
+    size_t n_threads = 4;
+    spdlog::thread_pool_options options;
+    options.topology = spdlog::async_queue_topology::byte_ring;
+    options.queue_bytes = 4096;
+    {
+        auto tp = std::make_shared<spdlog::details::thread_pool>(options);
+        auto logger = std::make_shared<spdlog::async_logger>("as", test_sink, tp, spdlog::async_overflow_policy::block);
+
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < n_threads; i++)
+        {
+            threads.emplace_back([logger, messages] {
+                for (size_t j = 0; j < messages; j++)
+                {
+                    logger->info("Hello message #{}", j);
+                }
+                logger->flush();
+            });
+        }
+        for (auto &t : threads)
+        {
+            t.join();
+        }
+    }
+    REQUIRE(test_sink->msg_counter() == messages * n_threads);
+    REQUIRE(test_sink->flush_counter() == n_threads);
+
+    options.threads = 2;
+    REQUIRE_THROWS_AS(spdlog::details::thread_pool(options), spdlog::spdlog_ex);
+}
+
+TEST_CASE("byte_ring message content", "[async]")
+{
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+    spdlog::thread_pool_options options;
+    options.topology = spdlog::async_queue_topology::byte_ring;
+    options.queue_bytes = 1024;
+    std::string long_payload(4096, 'x');
+    {
+        auto tp = std::make_shared<spdlog::details::thread_pool>(options);
+        auto logger = std::make_shared<spdlog::async_logger>("as", test_sink, tp);
+        logger->set_pattern("%n %l %v%V");
+#ifndef SPDLOG_NO_STRUCTURED_SPDLOG
+        {
+            spdlog::context ctx({{"req", "r1"}});
+            logger->log(spdlog::level::warn, {{"n", 42}, {"name", "abc"}}, "step");
+        }
+#else
+        logger->warn("step");
+#endif
+        logger->info(long_payload);
+    }
+
+    auto lines = test_sink->lines();
+    REQUIRE(lines.size() == 2);
+#ifndef SPDLOG_NO_STRUCTURED_SPDLOG
+    REQUIRE(lines[0] == "as warning step n:42 name:abc req:r1");
+#else
+    REQUIRE(lines[0] == "as warning step");
+#endif
+    // too long for the ring: kept whole on the heap
+    REQUIRE(lines[1] == "as info " + long_payload);
+}
+
+TEST_CASE("byte_ring full", "[async]")
+{
+    size_t messages = 2000;
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+    test_sink->set_delay(std::chrono::milliseconds(1));
+    spdlog::thread_pool_options options;
+    options.topology = spdlog::async_queue_topology::byte_ring;
+    options.queue_bytes = 1024;
+    auto tp = std::make_shared<spdlog::details::thread_pool>(options);
+    {
+        auto logger = std::make_shared<spdlog::async_logger>("as", test_sink, tp, spdlog::async_overflow_policy::overrun_oldest);
+        for (size_t i = 0; i < messages; i++)
+        {
+            logger->info("Hello message #{}", i);
+        }
+    }
+    // the ring can't drop its oldest records: the new messages are dropped, and counted
+    REQUIRE(tp->ring_full_drops() > 0);
+    REQUIRE(tp->overrun_counter() == tp->ring_full_drops());
+    REQUIRE(test_sink->msg_counter() + tp->ring_full_drops() == messages);
+}
+
+TEST_CASE("logger destruction", "[async]")
+{
+    size_t messages = 64;
+    spdlog::thread_pool_options options;
+    options.queue_size = 16;
+    for (auto topology : {spdlog::async_queue_topology::shared, spdlog::async_queue_topology::per_thread,
+             spdlog::async_queue_topology::byte_ring})
+    {
+        options.topology = topology;
+        options.threads = topology == spdlog::async_queue_topology::shared ? 3 : 1;
+        auto tp = std::make_shared<spdlog::details::thread_pool>(options);
+        auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+        test_sink->set_delay(std::chrono::milliseconds(1));
+        auto logger = std::make_shared<spdlog::async_logger>("as", test_sink, tp);
+        for (size_t i = 0; i < messages; i++)
+        {
+            logger->info("Hello message #{}", i);
+        }
+        // the queued messages don't own the logger: its destructor waits for them
+        logger.reset();
+        REQUIRE(test_sink->msg_counter() == messages);
+    }
+
+    // another logger overrunning the queue meanwhile
+    options.topology = spdlog::async_queue_topology::shared;
+    options.queue_size = 4;
+    options.threads = 2;
+    auto tp = std::make_shared<spdlog::details::thread_pool>(options);
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+    auto noisy = std::make_shared<spdlog::async_logger>("noisy", test_sink, tp, spdlog::async_overflow_policy::overrun_oldest);
+    std::atomic<bool> done{false};
+    std::thread noisy_thread([noisy, &done] {
+        while (!done)
+        {
+            noisy->info("noise");
+        }
+    });
+    for (size_t i = 0; i < 10; i++)
+    {
+        auto logger = std::make_shared<spdlog::async_logger>("as", test_sink, tp);
+        logger->info("Hello message #{}", i);
+    }
+    done = true;
+    noisy_thread.join();
+}
+
+TEST_CASE("logger destruction on a worker thread", "[async]")
+{
+    struct setup
+    {
+        spdlog::async_queue_topology topology;
+        size_t threads;
+    };
+    for (auto s : {setup{spdlog::async_queue_topology::shared, 1}, setup{spdlog::async_queue_topology::shared, 3},
+             setup{spdlog::async_queue_topology::byte_ring, 1}, setup{spdlog::async_queue_topology::sharded, 2}})
+    {
+        spdlog::thread_pool_options options;
+        options.topology = s.topology;
+        options.threads = s.threads;
+        auto tp = std::make_shared<spdlog::details::thread_pool>(options);
+        auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+        auto logger = std::make_shared<spdlog::async_logger>("as", test_sink, tp);
+        std::weak_ptr<spdlog::async_logger> weak = logger;
+        logger->info("before");
+        // the callback holds the last reference: the logger is destroyed on the worker thread calling it
+        logger->flush_async([logger] {});
+        logger.reset();
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (!weak.expired() && std::chrono::steady_clock::now() < deadline)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        REQUIRE(weak.expired());
+        REQUIRE(test_sink->msg_counter() == 1);
+
+        // a logger allocated in its place gets its messages written
+        auto next = std::make_shared<spdlog::async_logger>("next", test_sink, tp);
+        next->info("after");
+        REQUIRE(next->flush_async().wait_for(std::chrono::seconds(10)) == std::future_status::ready);
+        REQUIRE(test_sink->msg_counter() == 2);
+    }
+}
+
+TEST_CASE("wait strategies", "[async]")
+{
+    size_t messages = 256;
+    spdlog::thread_pool_options options;
+    options.queue_size = 64;
+    options.queue_bytes = 4096;
+    options.spin_budget = std::chrono::microseconds(10);
+    options.batch_window = std::chrono::microseconds(50);
+    for (auto strategy : {spdlog::async_wait_strategy::park, spdlog::async_wait_strategy::busy_spin, spdlog::async_wait_strategy::yield,
+             spdlog::async_wait_strategy::spin_then_park, spdlog::async_wait_strategy::timed_batch})
+    {
+        for (auto topology : {spdlog::async_queue_topology::shared, spdlog::async_queue_topology::byte_ring})
+        {
+            options.wait_strategy = strategy;
+            options.topology = topology;
+            auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+            {
+                auto tp = std::make_shared<spdlog::details::thread_pool>(options);
+                REQUIRE(tp->wait_strategy() == strategy);
+                auto logger = std::make_shared<spdlog::async_logger>("as", test_sink, tp);
+                for (size_t i = 0; i < messages; i++)
+                {
+                    logger->info("Hello message #{}", i);
+                    if (i % 64 == 0)
+                    {
+                        // let the worker go idle
+                        spdlog::details::os::sleep_for_millis(2);
+                    }
+                }
+                logger->flush();
+            }
+            REQUIRE(test_sink->msg_counter() == messages);
+            REQUIRE(test_sink->flush_counter() == 1);
+        }
+    }
+}
+
+TEST_CASE("timed_batch waits only for partial batches", "[async]")
+{
+    size_t messages = 64;
+    spdlog::thread_pool_options options;
+    options.queue_size = 256;
+    options.max_batch = 4;
+    options.wait_strategy = spdlog::async_wait_strategy::timed_batch;
+    options.batch_window = std::chrono::milliseconds(200);
+    for (auto topology : {spdlog::async_queue_topology::shared, spdlog::async_queue_topology::byte_ring})
+    {
+        options.topology = topology;
+        auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+        auto tp = std::make_shared<spdlog::details::thread_pool>(options);
+        auto logger = std::make_shared<spdlog::async_logger>("as", test_sink, tp);
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < messages; i++)
+        {
+            logger->info("Hello message #{}", i);
+        }
+        tp->flush_barrier().wait();
+        // 16 batches: waiting before each would take 3.2s
+        REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::seconds(1));
+        REQUIRE(test_sink->msg_counter() == messages);
+    }
+}
+
+// checks that the payloads (numbers) come in increasing order
+class sequence_sink : public spdlog::sinks::base_sink<std::mutex>
+{
+public:
+    explicit sequence_sink(size_t delay_every = 0)
+        : delay_every_(delay_every)
+    {}
+
+    size_t messages = 0;
+    bool in_order = true;
+    size_t longest = 0;
+
+protected:
+    void sink_it_(const spdlog::details::log_msg &msg) override
+    {
+        auto n = std::stoul(std::string(msg.payload.data(), msg.payload.size()));
+        in_order = in_order && (messages == 0 || n > last_);
+        last_ = n;
+        longest = std::max(longest, msg.payload.size());
+        if (delay_every_ > 0 && messages % delay_every_ == 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        messages++;
+    }
+
+    void flush_() override {}
+
+private:
+    size_t delay_every_;
+    unsigned long last_ = 0;
+};
+
+TEST_CASE("sharded", "[async]")
+{
+    size_t messages = 2000;
+    spdlog::thread_pool_options options;
+    options.topology = spdlog::async_queue_topology::sharded;
+    options.threads = 2;
+    options.queue_size = 256;
+    options.max_batch = 4;
+    // 3 loggers: the first and the third share the first shard, which runs hot
+    auto slow_sink = std::make_shared<sequence_sink>(16);
+    auto fast_sink = std::make_shared<sequence_sink>();
+    auto other_sink = std::make_shared<sequence_sink>(16);
+    bool moved = false;
+    {
+        auto tp = std::make_shared<spdlog::details::thread_pool>(options);
+        auto slow = std::make_shared<spdlog::async_logger>("slow", slow_sink, tp);
+        auto fast = std::make_shared<spdlog::async_logger>("fast", fast_sink, tp);
+        auto other = std::make_shared<spdlog::async_logger>("other", other_sink, tp);
+        slow->info("0");
+        fast->info("0");
+        other->info("0");
+
+        std::thread other_thread([other, messages] {
+            for (size_t i = 1; i < messages; i++)
+            {
+                other->info("{}", i);
+            }
+        });
+        for (size_t i = 1; i < messages; i++)
+        {
+            slow->info("{}", i);
+            fast->info("{}", i);
+            if (i == messages / 2)
+            {
+                moved = tp->rebalance();
+            }
+        }
+        other_thread.join();
+    }
+    REQUIRE(moved);
+    for (auto &sink : {slow_sink, fast_sink, other_sink})
+    {
+        REQUIRE(sink->messages == messages);
+        REQUIRE(sink->in_order);
+    }
+
+    // a single shard never rebalances
+    options.threads = 1;
+    auto tp = std::make_shared<spdlog::details::thread_pool>(options);
+    REQUIRE_FALSE(tp->rebalance());
+}
+
+// payload per line, counting the messages formatted and the ones fetched from the shared output
+class counting_formatter : public spdlog::formatter
+{
+public:
+    struct counters
+    {
+        std::atomic<size_t> formatted{0};
+        std::atomic<size_t> fetched{0};
+    };
+
+    counting_formatter(std::shared_ptr<counters> counts, size_t key)
+        : counts_(std::move(counts))
+        , key_(key)
+    {}
+
+    void format(const spdlog::details::log_msg &msg, spdlog::memory_buf_t &dest) override
+    {
+        if (msg.shared_output != nullptr && dest.size() == 0 && msg.shared_output->fetch(key_, msg, dest))
+        {
+            counts_->fetched++;
+            return;
+        }
+        counts_->formatted++;
+        dest.append(msg.payload.begin(), msg.payload.end());
+        dest.push_back('\n');
+        if (msg.shared_output != nullptr)
+        {
+            msg.shared_output->store(key_, msg, dest);
+        }
+    }
+
+    std::unique_ptr<spdlog::formatter> clone() const override
+    {
+        return spdlog::details::make_unique<counting_formatter>(counts_, key_);
+    }
+
+    size_t share_key() const override
+    {
+        return key_;
+    }
+
+private:
+    std::shared_ptr<counters> counts_;
+    size_t key_;
+};
+
+TEST_CASE("format threads", "[async]")
+{
+    size_t messages = 2000;
+    spdlog::thread_pool_options options;
+    options.format_threads = 3;
+    options.queue_size = 256;
+    options.max_batch = 8;
+    auto counts = std::make_shared<counting_formatter::counters>();
+    auto key = spdlog::details::unique_format_share_key();
+    std::ostringstream first_out;
+    std::ostringstream second_out;
+    std::ostringstream pattern_out;
+    auto first = std::make_shared<spdlog::sinks::ostream_sink_mt>(first_out);
+    auto second = std::make_shared<spdlog::sinks::ostream_sink_mt>(second_out);
+    auto pattern = std::make_shared<spdlog::sinks::ostream_sink_mt>(pattern_out);
+    first->set_formatter(spdlog::details::make_unique<counting_formatter>(counts, key));
+    second->set_formatter(spdlog::details::make_unique<counting_formatter>(counts, key));
+    pattern->set_pattern("[%n] %v");
+    size_t started = 0;
+    std::mutex started_mutex;
+    options.on_thread_start = [&started, &started_mutex] {
+        std::lock_guard<std::mutex> lock(started_mutex);
+        started++;
+    };
+    {
+        auto tp = std::make_shared<spdlog::details::thread_pool>(options);
+        auto logger = std::make_shared<spdlog::async_logger>("pipe", spdlog::sinks_init_list{first, second, pattern}, tp);
+        for (size_t i = 0; i < messages; i++)
+        {
+            logger->info("{}", i);
+            if (i % 500 == 0)
+            {
+                logger->flush();
+            }
+        }
+    }
+    REQUIRE(started == 4);
+
+    // written in order, each message formatted once by the format threads for the two counting sinks
+    std::string expected;
+    std::string expected_pattern;
+    for (size_t i = 0; i < messages; i++)
+    {
+        expected += spdlog::fmt_lib::format("{}\n", i);
+        expected_pattern += spdlog::fmt_lib::format("[pipe] {}{}", i, spdlog::details::os::default_eol);
+    }
+    REQUIRE(first_out.str() == expected);
+    REQUIRE(second_out.str() == expected);
+    REQUIRE(pattern_out.str() == expected_pattern);
+    REQUIRE(counts->formatted == messages);
+    REQUIRE(counts->fetched == 2 * messages);
+
+    // the ordered writes need the shared queue and one worker thread
+    options.threads = 2;
+    REQUIRE_THROWS_AS(spdlog::details::thread_pool(options), spdlog::spdlog_ex);
+    options.threads = 1;
+    options.topology = spdlog::async_queue_topology::byte_ring;
+    REQUIRE_THROWS_AS(spdlog::details::thread_pool(options), spdlog::spdlog_ex);
+}
+
+TEST_CASE("spill", "[async]")
+{
+    prepare_logdir();
+    size_t messages = 3000;
+    spdlog::thread_pool_options options;
+    options.queue_size = 8;
+    options.max_batch = 4;
+    options.spill_path = SPDLOG_FILENAME_T("test_logs/spill");
+    // a few small segments: the logging thread also waits for the budget
+    options.spill_segment_size = 4096;
+    options.spill_budget = 3 * 4096;
+    auto sink = std::make_shared<sequence_sink>(16);
+    auto other_sink = std::make_shared<sequence_sink>();
+    {
+        auto tp = std::make_shared<spdlog::details::thread_pool>(options);
+        auto logger = std::make_shared<spdlog::async_logger>("spilled", sink, tp, spdlog::async_overflow_policy::spill);
+        auto other = std::make_shared<spdlog::async_logger>("other", other_sink, tp, spdlog::async_overflow_policy::spill);
+        std::thread other_thread([other, messages] {
+            for (size_t i = 0; i < messages; i++)
+            {
+                other->info("{}", i);
+            }
+        });
+        for (size_t i = 0; i < messages; i++)
+        {
+            logger->info("{}", i);
+            if (i % 500 == 0)
+            {
+                logger->flush();
+            }
+        }
+        other_thread.join();
+        // destroyed while spilling: its messages are done first
+        other.reset();
+        REQUIRE(other_sink->messages == messages);
+        REQUIRE(tp->overrun_counter() == 0);
+    }
+    // each message once and in order, the segment files removed
+    for (auto &s : {sink, other_sink})
+    {
+        REQUIRE(s->messages == messages);
+        REQUIRE(s->in_order);
+    }
+    REQUIRE(count_files("test_logs") == 0);
+
+    // the spilled messages are read back by the only worker thread, in order
+    options.threads = 2;
+    REQUIRE_THROWS_AS(spdlog::details::thread_pool(options), spdlog::spdlog_ex);
+    options.threads = 1;
+    options.topology = spdlog::async_queue_topology::byte_ring;
+    REQUIRE_THROWS_AS(spdlog::details::thread_pool(options), spdlog::spdlog_ex);
+    options.topology = spdlog::async_queue_topology::shared;
+    options.priority_level = spdlog::level::err;
+    REQUIRE_THROWS_AS(spdlog::details::thread_pool(options), spdlog::spdlog_ex);
+}
+
+TEST_CASE("spill oversize messages", "[async]")
+{
+    prepare_logdir();
+    size_t messages = 1000;
+    std::string payload(10000, 'x');
+    spdlog::thread_pool_options options;
+    options.queue_size = 8;
+    options.spill_path = SPDLOG_FILENAME_T("test_logs/spill");
+    options.spill_segment_size = 4096;
+    auto sink = std::make_shared<sequence_sink>(16);
+    {
+        auto tp = std::make_shared<spdlog::details::thread_pool>(options);
+        auto logger = std::make_shared<spdlog::async_logger>("oversize", sink, tp, spdlog::async_overflow_policy::spill);
+        // larger than a segment: queued behind the spilled messages, whole
+        for (size_t i = 0; i < messages; i++)
+        {
+            if (i % 50 == 0)
+            {
+                logger->info("{} {}", i, payload);
+            }
+            else
+            {
+                logger->info("{}", i);
+            }
+        }
+        logger->flush();
+        REQUIRE(tp->overrun_counter() == 0);
+    }
+    REQUIRE(sink->messages == messages);
+    REQUIRE(sink->in_order);
+    REQUIRE(sink->longest > payload.size());
+    REQUIRE(count_files("test_logs") == 0);
+}
+
+TEST_CASE("flush futures", "[async]")
+{
+    struct setup
+    {
+        spdlog::async_queue_topology topology;
+        size_t threads;
+    };
+    for (auto s : {setup{spdlog::async_queue_topology::shared, 1}, setup{spdlog::async_queue_topology::shared, 3},
+             setup{spdlog::async_queue_topology::per_thread, 1}, setup{spdlog::async_queue_topology::byte_ring, 1},
+             setup{spdlog::async_queue_topology::sharded, 2}})
+    {
+        size_t messages = 100;
+        spdlog::thread_pool_options options;
+        options.topology = s.topology;
+        options.threads = s.threads;
+        auto tp = std::make_shared<spdlog::details::thread_pool>(options);
+        auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+        auto logger = std::make_shared<spdlog::async_logger>("as", test_sink, tp);
+        for (size_t i = 0; i < messages; i++)
+        {
+            logger->info("Hello message #{}", i);
+        }
+        logger->flush_async().get();
+        REQUIRE(test_sink->msg_counter() == messages);
+        REQUIRE(test_sink->flush_counter() >= 1);
+
+        // requests piled up behind a slow message share one flush
+        test_sink->set_delay(std::chrono::milliseconds(50));
+        logger->info("slow");
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        auto flushes = test_sink->flush_counter();
+        std::atomic<size_t> flushed{0};
+        for (size_t i = 0; i < 9; i++)
+        {
+            logger->flush_async([&flushed] { flushed++; });
+        }
+        logger->flush_async().get();
+        test_sink->set_delay(std::chrono::milliseconds::zero());
+        REQUIRE(flushed == 9);
+        REQUIRE(test_sink->msg_counter() == messages + 1);
+        if (s.threads == 1)
+        {
+            REQUIRE(test_sink->flush_counter() == flushes + 1);
+        }
+    }
+
+    // another logger overrunning the queue puts the requests back in instead of losing them
+    for (auto topology : {spdlog::async_queue_topology::shared, spdlog::async_queue_topology::sharded})
+    {
+        spdlog::thread_pool_options options;
+        options.topology = topology;
+        options.queue_size = 8;
+        auto tp = std::make_shared<spdlog::details::thread_pool>(options);
+        auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+        test_sink->set_delay(std::chrono::milliseconds(1));
+        auto logger = std::make_shared<spdlog::async_logger>("as", test_sink, tp);
+        auto noisy = std::make_shared<spdlog::async_logger>("noisy", test_sink, tp, spdlog::async_overflow_policy::overrun_oldest);
+        logger->info("before");
+        std::vector<std::future<void>> futures;
+        for (size_t i = 0; i < 20; i++)
+        {
+            futures.push_back(logger->flush_async());
+            for (size_t j = 0; j < 50; j++)
+            {
+                noisy->info("Hello message #{}", j);
+            }
+        }
+        REQUIRE(tp->overrun_counter() > 0);
+        for (auto &f : futures)
+        {
+            REQUIRE(f.wait_for(std::chrono::seconds(30)) == std::future_status::ready);
+        }
+    }
+}
+
+TEST_CASE("flush barrier", "[async]")
+{
+    size_t messages = 200;
+    spdlog::thread_pool_options options;
+    options.threads = 2;
+    auto tp = std::make_shared<spdlog::details::thread_pool>(options);
+    auto first_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+    auto second_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+    auto idle_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+    auto first = std::make_shared<spdlog::async_logger>("first", first_sink, tp);
+    auto second = std::make_shared<spdlog::async_logger>("second", second_sink, tp);
+    auto idle = std::make_shared<spdlog::async_logger>("idle", idle_sink, tp);
+    for (size_t i = 0; i < messages; i++)
+    {
+        first->info("Hello message #{}", i);
+        second->info("Hello message #{}", i);
+    }
+    tp->flush_barrier().get();
+    REQUIRE(first_sink->msg_counter() == messages);
+    REQUIRE(second_sink->msg_counter() == messages);
+    REQUIRE(first_sink->flush_counter() == 1);
+    REQUIRE(second_sink->flush_counter() == 1);
+    REQUIRE(idle_sink->flush_counter() == 0);
+
+    // only the loggers written since the last barrier are flushed again
+    first->info("again");
+    bool done = false;
+    std::mutex done_mutex;
+    std::condition_variable done_cv;
+    tp->flush_barrier([&] {
+        std::lock_guard<std::mutex> lock(done_mutex);
+        done = true;
+        done_cv.notify_all();
+    });
+    {
+        std::unique_lock<std::mutex> lock(done_mutex);
+        done_cv.wait(lock, [&done] { return done; });
+    }
+    REQUIRE(first_sink->flush_counter() == 2);
+    REQUIRE(second_sink->flush_counter() == 1);
+
+    // a logger going away is forgotten
+    second->info("last");
+    second.reset();
+    tp->flush_barrier().get();
+    REQUIRE(second_sink->msg_counter() == messages + 1);
+}
+
+#if defined(__linux__) || defined(_WIN32)
+TEST_CASE("pinned workers", "[async]")
+{
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+    size_t messages = 256;
+    spdlog::thread_pool_options options;
+    options.threads = 2;
+    options.worker_cpus = {0};
+    size_t started = 0;
+    std::mutex started_mutex;
+    options.on_thread_start = [&started, &started_mutex] {
+        std::lock_guard<std::mutex> lock(started_mutex);
+        started++;
+    };
+    {
+        auto tp = std::make_shared<spdlog::details::thread_pool>(options);
+        auto logger = std::make_shared<spdlog::async_logger>("as", test_sink, tp);
+        for (size_t i = 0; i < messages; i++)
+        {
+            logger->info("Hello message #{}", i);
+        }
+    }
+    REQUIRE(test_sink->msg_counter() == messages);
+    REQUIRE(started == 2);
+
+    // no such cpu: the worker threads are not started
+    started = 0;
+    options.worker_cpus = {0, 100000};
+    REQUIRE_THROWS_AS(spdlog::details::thread_pool(options), spdlog::spdlog_ex);
+    REQUIRE(started == 0);
+}
+#endif
+
 TEST_CASE("to_file", "[async]")
 {
     prepare_logdir();
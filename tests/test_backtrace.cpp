@@ -63,3 +63,118 @@ TEST_CASE("bactrace-async", "[bactrace]")
     REQUIRE(test_sink->lines()[6] == "debug message 99");
     REQUIRE(test_sink->lines()[7] == "****************** Backtrace End ********************");
 }
+
+TEST_CASE("bactrace-threads", "[bactrace]")
+{
+    using spdlog::sinks::test_sink_mt;
+    auto test_sink = std::make_shared<test_sink_mt>();
+
+    spdlog::logger logger("test-bactrace-threads", test_sink);
+    logger.set_pattern("%n %v");
+    logger.enable_backtrace(5);
+
+    // explicit times: the merge order does not depend on the clock
+    auto t0 = spdlog::log_clock::now();
+    auto at = [&logger, t0](int seconds, const std::string &msg) {
+        logger.log(t0 + std::chrono::seconds(seconds), spdlog::source_loc{}, spdlog::level::debug, msg);
+    };
+    at(0, "main 0");
+    std::thread([&at] {
+        for (int i = 0; i < 3; i++)
+            at(1 + i, "a " + std::to_string(i));
+    }).join();
+    std::thread([&at] {
+        for (int i = 0; i < 3; i++)
+            at(4 + i, "b " + std::to_string(i));
+    }).join();
+    at(7, "main 1");
+
+    // the rings of the exited threads are still dumped, merged by time
+    logger.dump_backtrace();
+    std::vector<std::string> expected{"test-bactrace-threads ****************** Backtrace Start ******************",
+        "test-bactrace-threads a 2", "test-bactrace-threads b 0", "test-bactrace-threads b 1", "test-bactrace-threads b 2",
+        "test-bactrace-threads main 1", "test-bactrace-threads ****************** Backtrace End ********************"};
+    REQUIRE(test_sink->lines() == expected);
+
+    // popped: a second dump is empty
+    logger.dump_backtrace();
+    REQUIRE(test_sink->lines().size() == expected.size() + 2);
+}
+
+TEST_CASE("bactrace-long-message", "[bactrace]")
+{
+    using spdlog::sinks::test_sink_st;
+    auto test_sink = std::make_shared<test_sink_st>();
+
+    spdlog::logger logger("test-bactrace-long", test_sink);
+    logger.set_pattern("%v");
+    logger.enable_backtrace(2);
+
+    std::string long_message(10000, 'x');
+    logger.debug(long_message);
+    logger.dump_backtrace();
+    REQUIRE(test_sink->lines().size() == 3);
+    REQUIRE(test_sink->lines()[1] == long_message);
+}
+
+TEST_CASE("bactrace-long-messages", "[bactrace]")
+{
+    using spdlog::sinks::test_sink_st;
+    auto test_sink = std::make_shared<test_sink_st>();
+
+    spdlog::logger logger("test-bactrace-long", test_sink);
+    logger.set_pattern("%v");
+    logger.enable_backtrace(3);
+
+    // larger than the ring: kept whole, mixed in time order with the short ones
+    for (int i = 0; i < 4; i++)
+    {
+        logger.debug("short {}", i);
+        logger.debug(std::string(10000, static_cast<char>('a' + i)));
+    }
+    logger.dump_backtrace();
+    std::vector<std::string> expected{"****************** Backtrace Start ******************", std::string(10000, 'c'), "short 3",
+        std::string(10000, 'd'), "****************** Backtrace End ********************"};
+    REQUIRE(test_sink->lines() == expected);
+}
+
+TEST_CASE("bactrace-clone", "[bactrace]")
+{
+    using spdlog::sinks::test_sink_st;
+    auto test_sink = std::make_shared<test_sink_st>();
+
+    spdlog::logger logger("test-bactrace-clone", test_sink);
+    logger.set_pattern("%n %v");
+    logger.enable_backtrace(2);
+    logger.debug("one");
+    logger.debug("two");
+
+    // the clone keeps the backtrace, the original keeps it too
+    auto cloned = logger.clone("cloned");
+    cloned->dump_backtrace();
+    logger.dump_backtrace();
+    std::vector<std::string> expected{"cloned ****************** Backtrace Start ******************", "cloned one", "cloned two",
+        "cloned ****************** Backtrace End ********************",
+        "test-bactrace-clone ****************** Backtrace Start ******************", "test-bactrace-clone one",
+        "test-bactrace-clone two", "test-bactrace-clone ****************** Backtrace End ********************"};
+    REQUIRE(test_sink->lines() == expected);
+}
+
+#ifndef SPDLOG_NO_STRUCTURED_SPDLOG
+TEST_CASE("bactrace-fields", "[bactrace]")
+{
+    using spdlog::sinks::test_sink_st;
+    auto test_sink = std::make_shared<test_sink_st>();
+
+    spdlog::logger logger("test-bactrace-fields", test_sink);
+    logger.set_pattern("%v%V");
+    logger.enable_backtrace(2);
+    {
+        spdlog::context ctx({{"req", "r1"}});
+        logger.log(spdlog::level::debug, {{"n", 42}, {"ratio", 0.5}}, "step");
+    }
+    logger.dump_backtrace();
+    REQUIRE(test_sink->lines().size() == 3);
+    REQUIRE(test_sink->lines()[1] == "step n:42 ratio:0.500000 req:r1");
+}
+#endif
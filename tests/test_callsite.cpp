@@ -0,0 +1,202 @@
+#include "includes.h"
+#include "test_sink.h"
+
+#include <spdlog/cfg/helpers.h>
+
+using spdlog::details::callsite;
+using spdlog::details::callsite_registry;
+
+static void log_from_single_site(spdlog::logger &logger, int i)
+{
+    SPDLOG_LOGGER_INFO(&logger, {spdlog::F("idx", i), spdlog::F("name", "value")}, "single site");
+}
+
+TEST_CASE("callsite registered once per site", "[callsite]")
+{
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_st>();
+    spdlog::logger logger("callsite", test_sink);
+    logger.set_pattern("%k %v");
+
+    for (int i = 0; i < 3; i++)
+    {
+        log_from_single_site(logger, i);
+    }
+    SPDLOG_LOGGER_INFO(&logger, "other site");
+
+    auto lines = test_sink->lines();
+    REQUIRE(lines.size() == 4);
+    REQUIRE(lines[0] == lines[1]);
+    REQUIRE(lines[1] == lines[2]);
+    REQUIRE(lines[0].substr(0, lines[0].find(' ')) != lines[3].substr(0, lines[3].find(' ')));
+
+    auto id = static_cast<size_t>(std::stoul(lines[0]));
+    callsite *site = callsite_registry::instance().get(id);
+    REQUIRE(site != nullptr);
+    REQUIRE(site->id() == id);
+    REQUIRE(std::string(site->short_filename) == "test_callsite.cpp");
+    REQUIRE(std::string(site->loc.funcname) == "log_from_single_site");
+    REQUIRE(site->loc.site == site);
+}
+
+TEST_CASE("callsite description", "[callsite]")
+{
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_st>();
+    spdlog::logger logger("callsite", test_sink);
+    logger.set_pattern("%k");
+
+    log_from_single_site(logger, 42);
+    callsite *site = callsite_registry::instance().get(std::stoul(test_sink->lines()[0]));
+    REQUIRE(site != nullptr);
+    REQUIRE(site->described());
+    REQUIRE(site->level() == spdlog::level::info);
+    REQUIRE(std::string(site->fmt().data(), site->fmt().size()) == "single site");
+    REQUIRE(site->field_names() == std::vector<std::string>{"idx", "name"});
+}
+
+TEST_CASE("callsite not described while level is disabled", "[callsite]")
+{
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_st>();
+    spdlog::logger logger("callsite", test_sink);
+    logger.set_level(spdlog::level::off);
+
+    size_t before = callsite_registry::instance().size();
+    SPDLOG_LOGGER_ERROR(&logger, "not logged {}", 1);
+    REQUIRE(callsite_registry::instance().size() == before + 1);
+    callsite *site = callsite_registry::instance().get(before);
+    REQUIRE(site != nullptr);
+    REQUIRE_FALSE(site->described());
+    REQUIRE(test_sink->msg_counter() == 0);
+}
+
+TEST_CASE("callsite short filename", "[callsite]")
+{
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_st>();
+    spdlog::logger logger("callsite", test_sink);
+    logger.set_pattern("%s:%#");
+
+    SPDLOG_LOGGER_INFO(&logger, "hello");
+    REQUIRE(test_sink->lines()[0] == spdlog::fmt_lib::format("test_callsite.cpp:{}", __LINE__ - 1));
+}
+
+static void debug_site(spdlog::logger &logger)
+{
+    SPDLOG_LOGGER_DEBUG(&logger, "debug site");
+}
+
+static void info_site(spdlog::logger &logger)
+{
+    SPDLOG_LOGGER_INFO(&logger, "info site");
+}
+
+TEST_CASE("callsite mode by function", "[callsite]")
+{
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_st>();
+    spdlog::logger logger("callsite", test_sink);
+    logger.set_pattern("%v");
+
+    // rule set before the site registers
+    spdlog::set_callsite_mode("debug_s*()", spdlog::callsite_mode::on);
+    debug_site(logger);
+    info_site(logger);
+    REQUIRE(test_sink->lines() == std::vector<std::string>{"debug site", "info site"});
+
+    spdlog::set_callsite_mode("info_site()", spdlog::callsite_mode::off);
+    debug_site(logger);
+    info_site(logger);
+    REQUIRE(test_sink->msg_counter() == 3);
+
+    spdlog::reset_callsite_modes();
+    debug_site(logger);
+    info_site(logger);
+    REQUIRE(test_sink->lines() == std::vector<std::string>{"debug site", "info site", "debug site", "info site"});
+}
+
+TEST_CASE("callsite mode toggled", "[callsite]")
+{
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_st>();
+    spdlog::logger logger("callsite", test_sink);
+    logger.set_pattern("%v");
+
+    // the same selector replaces its rule: the rules don't grow
+    auto &registry = callsite_registry::instance();
+    auto rules = registry.mode_rules();
+    for (int i = 0; i < 100; i++)
+    {
+        spdlog::set_callsite_mode("debug_site()", i % 2 == 0 ? spdlog::callsite_mode::on : spdlog::callsite_mode::off);
+        debug_site(logger);
+    }
+    REQUIRE(registry.mode_rules() == rules + 1);
+    REQUIRE(test_sink->msg_counter() == 50);
+
+    // the last one wins over an earlier rule of another selector
+    spdlog::set_callsite_mode("debug_s*()", spdlog::callsite_mode::on);
+    spdlog::set_callsite_mode("debug_site()", spdlog::callsite_mode::off);
+    debug_site(logger);
+    REQUIRE(test_sink->msg_counter() == 50);
+    spdlog::reset_callsite_modes();
+    REQUIRE(registry.mode_rules() == 0);
+}
+
+TEST_CASE("callsite mode by file and line", "[callsite]")
+{
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_st>();
+    spdlog::logger logger("callsite", test_sink);
+    logger.set_pattern("%v");
+
+    spdlog::set_callsite_mode("*_callsite.cpp", spdlog::callsite_mode::off);
+    spdlog::set_callsite_mode(spdlog::fmt_lib::format("test_callsite.cpp:{}", __LINE__ + 2), spdlog::callsite_mode::on);
+    SPDLOG_LOGGER_INFO(&logger, "off");
+    SPDLOG_LOGGER_DEBUG(&logger, "on");
+    spdlog::reset_callsite_modes();
+
+    REQUIRE(test_sink->lines() == std::vector<std::string>{"on"});
+
+    // line numbers out of range are rejected before the rule is stored
+    REQUIRE_THROWS_AS(spdlog::set_callsite_mode("f.cpp:99999999999", spdlog::callsite_mode::on), spdlog::spdlog_ex);
+    REQUIRE_THROWS_AS(spdlog::set_callsite_sampling("f.cpp:4294967296", spdlog::sampling_policy::every_nth(2)), spdlog::spdlog_ex);
+}
+
+TEST_CASE("callsite off skips backtrace", "[callsite]")
+{
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_st>();
+    spdlog::logger logger("callsite", test_sink);
+    logger.set_pattern("%v");
+    logger.enable_backtrace(10);
+
+    spdlog::set_callsite_mode("debug_site()", spdlog::callsite_mode::off);
+    debug_site(logger);
+    spdlog::reset_callsite_modes();
+    debug_site(logger);
+    logger.dump_backtrace();
+
+    auto lines = test_sink->lines();
+    REQUIRE(lines.size() == 3);
+    REQUIRE(lines[1] == "debug site");
+}
+
+TEST_CASE("callsite modes from cfg string", "[callsite]")
+{
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_st>();
+    spdlog::logger logger("callsite", test_sink);
+    logger.set_pattern("%v");
+
+    spdlog::cfg::helpers::load_callsite_modes("f.cpp:99999999999=on,debug_site()=ON, info_site()=off, junk()=maybe");
+    debug_site(logger);
+    info_site(logger);
+    spdlog::cfg::helpers::load_callsite_modes("info_site()=default");
+    info_site(logger);
+    spdlog::reset_callsite_modes();
+
+    REQUIRE(test_sink->lines() == std::vector<std::string>{"debug site", "info site"});
+}
+
+TEST_CASE("callsite glob", "[callsite]")
+{
+    using spdlog::details::glob_match;
+    REQUIRE(glob_match("*", ""));
+    REQUIRE(glob_match("*.cpp", "src/a.cpp"));
+    REQUIRE(glob_match("src/?.cpp", "src/a.cpp"));
+    REQUIRE(glob_match("s*c/*a*.cpp", "src/bar.cpp"));
+    REQUIRE_FALSE(glob_match("*.h", "src/a.cpp"));
+    REQUIRE_FALSE(glob_match("a.cpp", "src/a.cpp"));
+}
@@ -1,4 +1,8 @@
 #include "includes.h"
+#include "spdlog/details/mpmc_blocking_q.h"
+#include "spdlog/details/mpmc_ring_q.h"
+#include "spdlog/details/mpsc_byte_ring.h"
+#include "spdlog/details/spsc_merge_q.h"
 
 using std::chrono::milliseconds;
 using test_clock = std::chrono::high_resolution_clock;
@@ -104,3 +108,273 @@ TEST_CASE("full_queue", "[mpmc_blocking_q]")
     q.dequeue_for(item, milliseconds(0));
     REQUIRE(item == 123456);
 }
+
+TEST_CASE("ring_capacity", "[mpmc_ring_q]")
+{
+    REQUIRE(spdlog::details::mpmc_ring_queue<int>(0).capacity() == 2);
+    REQUIRE(spdlog::details::mpmc_ring_queue<int>(1).capacity() == 2);
+    REQUIRE(spdlog::details::mpmc_ring_queue<int>(100).capacity() == 128);
+    REQUIRE(spdlog::details::mpmc_ring_queue<int>(128).capacity() == 128);
+}
+
+TEST_CASE("ring_dequeue-empty-wait", "[mpmc_ring_q]")
+{
+    milliseconds wait_ms(250);
+    milliseconds tolerance_wait(250);
+
+    spdlog::details::mpmc_ring_queue<int> q(16);
+    int popped_item = 0;
+    auto start = test_clock::now();
+    auto rv = q.dequeue_for(popped_item, wait_ms);
+    auto delta_ms = millis_from(start);
+
+    REQUIRE(rv == false);
+    INFO("Delta " << delta_ms.count() << " millis");
+    REQUIRE(delta_ms >= wait_ms - tolerance_wait);
+    REQUIRE(delta_ms <= wait_ms + tolerance_wait);
+}
+
+TEST_CASE("ring_full_queue", "[mpmc_ring_q]")
+{
+    spdlog::details::mpmc_ring_queue<int> q(128);
+    auto q_size = static_cast<int>(q.capacity());
+    for (int i = 0; i < q_size; i++)
+    {
+        q.enqueue(i + 0);
+    }
+    REQUIRE(q.size() == q.capacity());
+
+    q.enqueue_nowait(123456);
+    REQUIRE(q.overrun_counter() == 1);
+
+    for (int i = 1; i < q_size; i++)
+    {
+        int item = -1;
+        q.dequeue_for(item, milliseconds(0));
+        REQUIRE(item == i);
+    }
+
+    // last item pushed has overridden the oldest.
+    int item = -1;
+    q.dequeue_for(item, milliseconds(0));
+    REQUIRE(item == 123456);
+    REQUIRE(q.size() == 0);
+}
+
+TEST_CASE("ring_blocked_producer", "[mpmc_ring_q]")
+{
+    spdlog::details::mpmc_ring_queue<int> q(2);
+    q.enqueue(1);
+    q.enqueue(2);
+
+    // the third enqueue blocks until the consumer makes room
+    std::thread producer([&q] { q.enqueue(3); });
+    spdlog::details::os::sleep_for_millis(50);
+    REQUIRE(q.size() == 2);
+
+    int item = 0;
+    REQUIRE(q.dequeue_for(item, milliseconds(0)));
+    REQUIRE(item == 1);
+    producer.join();
+    REQUIRE(q.dequeue_for(item, milliseconds(0)));
+    REQUIRE(item == 2);
+    REQUIRE(q.dequeue_for(item, milliseconds(0)));
+    REQUIRE(item == 3);
+    REQUIRE(q.overrun_counter() == 0);
+}
+
+TEST_CASE("ring_multi_producers_consumers", "[mpmc_ring_q]")
+{
+    const int producers = 4;
+    const int consumers = 2;
+    const int per_producer = 10000;
+    spdlog::details::mpmc_ring_queue<int> q(64);
+
+    std::atomic<long long> sum{0};
+    std::atomic<int> received{0};
+    std::vector<std::thread> threads;
+    for (int c = 0; c < consumers; c++)
+    {
+        threads.emplace_back([&] {
+            int item = 0;
+            while (received.load() < producers * per_producer)
+            {
+                if (q.dequeue_for(item, milliseconds(10)))
+                {
+                    sum += item;
+                    received++;
+                }
+            }
+        });
+    }
+    for (int p = 0; p < producers; p++)
+    {
+        threads.emplace_back([&q] {
+            for (int i = 1; i <= per_producer; i++)
+            {
+                q.enqueue(i + 0);
+            }
+        });
+    }
+    for (auto &t : threads)
+    {
+        t.join();
+    }
+    REQUIRE(received.load() == producers * per_producer);
+    REQUIRE(sum.load() == static_cast<long long>(producers) * per_producer * (per_producer + 1) / 2);
+}
+
+TEST_CASE("merge_order", "[spsc_merge_q]")
+{
+    spdlog::details::spsc_merge_queue<int> q(16);
+    q.enqueue(1);
+    std::thread([&q] { q.enqueue(2); }).join();
+    q.enqueue(3);
+    std::thread([&q] { q.enqueue(4); }).join();
+    REQUIRE(q.size() == 4);
+    REQUIRE(q.rings() == 3);
+
+    // the heads of the rings are merged in enqueue order
+    for (int i = 1; i <= 4; i++)
+    {
+        int item = 0;
+        REQUIRE(q.dequeue_for(item, milliseconds(0)));
+        REQUIRE(item == i);
+    }
+    int item = 0;
+    REQUIRE_FALSE(q.dequeue_for(item, milliseconds(0)));
+
+    // idle consumer released the rings of the threads that exited
+    REQUIRE(q.rings() == 1);
+}
+
+TEST_CASE("merge_order_interleaved", "[spsc_merge_q]")
+{
+    spdlog::details::spsc_merge_queue<int> q(16);
+    q.enqueue(1);
+    std::thread([&q] { q.enqueue(2); }).join();
+    int item = 0;
+    REQUIRE(q.try_dequeue(item));
+    REQUIRE(item == 1);
+
+    // enqueued after the heads were compared
+    q.enqueue(3);
+    q.enqueue(4);
+    for (int i = 2; i <= 4; i++)
+    {
+        REQUIRE(q.try_dequeue(item));
+        REQUIRE(item == i);
+    }
+    REQUIRE_FALSE(q.try_dequeue(item));
+}
+
+TEST_CASE("merge_full_ring", "[spsc_merge_q]")
+{
+    spdlog::details::spsc_merge_queue<int> q(4);
+    for (int i = 0; i < 4; i++)
+    {
+        q.enqueue_nowait(i + 0);
+    }
+    // the ring is full: the new message is dropped
+    q.enqueue_nowait(123456);
+    REQUIRE(q.overrun_counter() == 1);
+    // other threads have their own room
+    std::thread([&q] { q.enqueue_nowait(4); }).join();
+    REQUIRE(q.overrun_counter() == 1);
+
+    for (int i = 0; i <= 4; i++)
+    {
+        int item = -1;
+        REQUIRE(q.dequeue_for(item, milliseconds(0)));
+        REQUIRE(item == i);
+    }
+}
+
+TEST_CASE("merge_multi_producers", "[spsc_merge_q]")
+{
+    const int producers = 4;
+    const int per_producer = 10000;
+    spdlog::details::spsc_merge_queue<std::pair<int, int>> q(64);
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; p++)
+    {
+        threads.emplace_back([&q, p] {
+            for (int i = 1; i <= per_producer; i++)
+            {
+                q.enqueue(std::make_pair(p, i));
+            }
+        });
+    }
+
+    // every producer's messages come out in order
+    std::vector<int> last(producers, 0);
+    int received = 0;
+    bool in_order = true;
+    while (received < producers * per_producer)
+    {
+        std::pair<int, int> item;
+        if (q.dequeue_for(item, milliseconds(10)))
+        {
+            in_order = in_order && item.second == last[item.first] + 1;
+            last[item.first] = item.second;
+            received++;
+        }
+    }
+    for (auto &t : threads)
+    {
+        t.join();
+    }
+    REQUIRE(in_order);
+    REQUIRE(q.size() == 0);
+}
+
+TEST_CASE("byte_ring_records", "[mpsc_byte_ring]")
+{
+    spdlog::details::mpsc_byte_ring ring(1024);
+    REQUIRE(ring.capacity() == 1024);
+    REQUIRE(ring.read() == nullptr);
+    REQUIRE(ring.try_reserve(ring.max_record_size() + 1) == nullptr);
+
+    // fill the ring and drain it a few times so the records wrap around its end
+    int next_write = 0;
+    int next_read = 0;
+    for (int round = 0; round < 10; round++)
+    {
+        char *record;
+        while ((record = ring.try_reserve(sizeof(int) + 90)) != nullptr)
+        {
+            std::memcpy(record, &next_write, sizeof(int));
+            next_write++;
+            ring.commit(record);
+        }
+        REQUIRE(ring.size() > ring.capacity() - 128);
+
+        while ((record = ring.read()) != nullptr)
+        {
+            int value;
+            std::memcpy(&value, record, sizeof(int));
+            REQUIRE(value == next_read);
+            next_read++;
+        }
+        ring.release();
+        REQUIRE(ring.size() == 0);
+    }
+    REQUIRE(next_read == next_write);
+}
+
+TEST_CASE("byte_ring_uncommitted", "[mpsc_byte_ring]")
+{
+    spdlog::details::mpsc_byte_ring ring(1024);
+    auto *first = ring.try_reserve(8);
+    auto *second = ring.try_reserve(8);
+    ring.commit(second);
+    // records are read in reservation order
+    REQUIRE(ring.read() == nullptr);
+    REQUIRE_FALSE(ring.wait_for(milliseconds(0)));
+    ring.commit(first);
+    REQUIRE(ring.wait_for(milliseconds(0)));
+    REQUIRE(ring.read() == first);
+    REQUIRE(ring.read() == second);
+    REQUIRE(ring.read() == nullptr);
+}
@@ -510,3 +510,164 @@ TEST_CASE("custom flags-exception", "[pattern_formatter]")
     spdlog::details::log_msg msg(spdlog::source_loc{}, "logger-name", spdlog::level::info, "some message");
     CHECK_THROWS_AS(formatter->format(msg, formatted), spdlog::spdlog_ex);
 }
+
+TEST_CASE("share key", "[pattern_formatter]")
+{
+    spdlog::pattern_formatter formatter("[%n] %v");
+    REQUIRE(formatter.share_key() != 0);
+    REQUIRE(formatter.clone()->share_key() == formatter.share_key());
+    REQUIRE(spdlog::pattern_formatter("[%n] %v").share_key() == formatter.share_key());
+    REQUIRE(spdlog::pattern_formatter("[%n] %v", spdlog::pattern_time_type::utc).share_key() != formatter.share_key());
+    REQUIRE(spdlog::pattern_formatter("%v").share_key() != formatter.share_key());
+
+    // elapsed time and custom flags depend on the formatter instance
+    REQUIRE(spdlog::pattern_formatter("%i %v").share_key() == 0);
+    auto custom = spdlog::details::make_unique<spdlog::pattern_formatter>();
+    custom->add_flag<custom_test_flag>('t', "custom").set_pattern("%t %v");
+    REQUIRE(custom->share_key() == 0);
+
+    REQUIRE(spdlog::json_formatter().share_key() == spdlog::json_formatter().share_key());
+    REQUIRE(spdlog::json_formatter().share_key() != 0);
+    REQUIRE(spdlog::json_formatter().clone()->share_key() == spdlog::json_formatter().share_key());
+    spdlog::json_formatter json_with_field;
+    json_with_field.add_field("thread", "%t");
+    REQUIRE(json_with_field.share_key() != spdlog::json_formatter().share_key());
+}
+
+namespace {
+// counts the messages it formats, shared by its clones
+class counting_formatter : public spdlog::formatter
+{
+public:
+    explicit counting_formatter(std::shared_ptr<size_t> count)
+        : count_(std::move(count))
+    {}
+
+    void format(const spdlog::details::log_msg &msg, memory_buf_t &dest) override
+    {
+        (*count_)++;
+        dest.append(msg.payload.data(), msg.payload.data() + msg.payload.size());
+        spdlog::string_view_t eol{spdlog::details::os::default_eol};
+        dest.append(eol.data(), eol.data() + eol.size());
+    }
+
+    std::unique_ptr<spdlog::formatter> clone() const override
+    {
+        return spdlog::details::make_unique<counting_formatter>(count_);
+    }
+
+private:
+    std::shared_ptr<size_t> count_;
+};
+} // namespace
+
+TEST_CASE("shared output between sinks", "[pattern_formatter]")
+{
+    auto sink1 = std::make_shared<spdlog::sinks::test_sink_st>();
+    auto sink2 = std::make_shared<spdlog::sinks::test_sink_st>();
+    auto sink3 = std::make_shared<spdlog::sinks::test_sink_st>();
+    spdlog::logger logger("shared", {sink1, sink2, sink3});
+
+    auto count = std::make_shared<size_t>(0);
+    logger.set_formatter(spdlog::details::make_unique<counting_formatter>(count));
+    logger.info("a");
+    REQUIRE(*count == 3);
+
+    *count = 0;
+    logger.set_formatter(spdlog::details::make_unique<counting_formatter>(count), spdlog::formatter_sharing::always);
+    logger.info("b");
+    REQUIRE(*count == 1);
+    REQUIRE(sink1->lines() == std::vector<std::string>{"a", "b"});
+    REQUIRE(sink3->lines() == std::vector<std::string>{"a", "b"});
+
+    // a sink with a different pattern still formats on its own
+    logger.set_pattern("[%n] %v");
+    sink2->set_pattern("%v");
+    logger.info("c");
+    REQUIRE(sink1->lines().back() == "[shared] c");
+    REQUIRE(sink2->lines().back() == "c");
+    REQUIRE(sink3->lines().back() == "[shared] c");
+
+    logger.set_pattern("[%n] %v", spdlog::pattern_time_type::local, spdlog::formatter_sharing::never);
+    logger.info("d");
+    REQUIRE(sink1->lines().back() == "[shared] d");
+    REQUIRE(sink2->lines().back() == "[shared] d");
+}
+
+TEST_CASE("derived message data", "[pattern_formatter]")
+{
+    spdlog::details::log_msg msg(spdlog::source_loc{"/some/path/file.cpp", 42, "func"}, "logger-name", spdlog::level::info, "some message");
+    auto format_with = [&msg](const std::string &pattern, spdlog::pattern_time_type time_type) {
+        spdlog::pattern_formatter formatter(pattern, time_type);
+        memory_buf_t formatted;
+        formatter.format(msg, formatted);
+        return std::string(formatted.data(), formatted.size());
+    };
+
+    const std::vector<std::string> patterns{"%+", "%t", "%s", "%z", "%Y-%m-%d %H:%M:%S"};
+    std::vector<std::string> expected;
+    for (auto time_type : {spdlog::pattern_time_type::local, spdlog::pattern_time_type::utc})
+    {
+        for (auto &pattern : patterns)
+        {
+            expected.push_back(format_with(pattern, time_type));
+        }
+    }
+
+    spdlog::details::msg_derived derived{msg};
+    REQUIRE(msg.derived == &derived);
+    {
+        // a nested one does not replace it
+        spdlog::details::msg_derived nested{msg};
+        REQUIRE(msg.derived == &derived);
+    }
+    REQUIRE(msg.derived == &derived);
+    REQUIRE(std::string(derived.short_filename()) == "file.cpp");
+    auto thread_id = derived.thread_id();
+    REQUIRE(std::string(thread_id.data(), thread_id.size()) == std::to_string(msg.thread_id));
+
+    size_t i = 0;
+    for (auto time_type : {spdlog::pattern_time_type::local, spdlog::pattern_time_type::utc})
+    {
+        for (auto &pattern : patterns)
+        {
+            REQUIRE(format_with(pattern, time_type) == expected[i++]);
+        }
+    }
+}
+
+namespace {
+// keeps a copy of every message, formatted later
+class keeping_sink : public spdlog::sinks::base_sink<spdlog::details::null_mutex>
+{
+public:
+    std::vector<spdlog::details::log_msg> kept;
+
+protected:
+    void sink_it_(const spdlog::details::log_msg &msg) override
+    {
+        kept.push_back(msg);
+    }
+    void flush_() override {}
+};
+} // namespace
+
+TEST_CASE("message copied in a sink", "[pattern_formatter]")
+{
+    auto keeping = std::make_shared<keeping_sink>();
+    auto other = std::make_shared<spdlog::sinks::test_sink_st>();
+    // two sinks: the logger attaches its output cache and derived data while sinking
+    spdlog::logger logger("copies", {keeping, other});
+    logger.set_pattern("[%n] [%s] %v", spdlog::pattern_time_type::local, spdlog::formatter_sharing::always);
+    logger.log(spdlog::source_loc{"/some/path/file.cpp", 42, "func"}, spdlog::level::info, "kept");
+
+    REQUIRE(keeping->kept.size() == 1);
+    auto &copy = keeping->kept[0];
+    REQUIRE(copy.shared_output == nullptr);
+    REQUIRE(copy.derived == nullptr);
+    spdlog::pattern_formatter formatter("[%n] [%s] %v");
+    memory_buf_t formatted;
+    formatter.format(copy, formatted);
+    REQUIRE(std::string(formatted.data(), formatted.size()) == "[copies] [file.cpp] kept" + std::string(spdlog::details::os::default_eol));
+    REQUIRE(other->lines() == std::vector<std::string>{"[copies] [file.cpp] kept"});
+}
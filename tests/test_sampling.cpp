@@ -0,0 +1,245 @@
+#include "includes.h"
+#include "test_sink.h"
+
+using spdlog::sampling_policy;
+using spdlog::details::sampler;
+using std::chrono::milliseconds;
+
+TEST_CASE("every_nth", "[sampling]")
+{
+    sampler s{sampling_policy::every_nth(3)};
+    auto now = spdlog::log_clock::now();
+    size_t suppressed = 0;
+    std::vector<bool> allowed;
+    for (int i = 0; i < 7; i++)
+    {
+        allowed.push_back(s.allow(now, suppressed));
+        REQUIRE(suppressed == 0);
+    }
+    REQUIRE(allowed == std::vector<bool>{true, false, false, true, false, false, true});
+}
+
+TEST_CASE("token_bucket", "[sampling]")
+{
+    sampler s{sampling_policy::rate_limit(2, milliseconds(100))};
+    auto now = spdlog::log_clock::now();
+    size_t suppressed = 0;
+    REQUIRE(s.allow(now, suppressed));
+    REQUIRE(s.allow(now, suppressed));
+    REQUIRE_FALSE(s.allow(now, suppressed));
+    REQUIRE_FALSE(s.allow(now + milliseconds(10), suppressed));
+
+    // one token refilled after half the interval
+    REQUIRE(s.allow(now + milliseconds(50), suppressed));
+    REQUIRE(suppressed == 2);
+    REQUIRE_FALSE(s.allow(now + milliseconds(50), suppressed));
+
+    // full burst after a long pause
+    REQUIRE(s.allow(now + milliseconds(1000), suppressed));
+    REQUIRE(suppressed == 1);
+    REQUIRE(s.allow(now + milliseconds(1000), suppressed));
+    REQUIRE(suppressed == 0);
+    REQUIRE_FALSE(s.allow(now + milliseconds(1000), suppressed));
+}
+
+TEST_CASE("first_n", "[sampling]")
+{
+    sampler s{sampling_policy::first_n(2, milliseconds(100))};
+    auto now = spdlog::log_clock::now();
+    size_t suppressed = 0;
+    REQUIRE(s.allow(now, suppressed));
+    REQUIRE(s.allow(now + milliseconds(1), suppressed));
+    for (int i = 0; i < 5; i++)
+    {
+        REQUIRE_FALSE(s.allow(now + milliseconds(2), suppressed));
+    }
+    REQUIRE(s.allow(now + milliseconds(100), suppressed));
+    REQUIRE(suppressed == 5);
+    REQUIRE(s.allow(now + milliseconds(101), suppressed));
+    REQUIRE(suppressed == 0);
+}
+
+TEST_CASE("invalid sampling policy", "[sampling]")
+{
+    REQUIRE_THROWS_AS(sampler{sampling_policy::every_nth(0)}, spdlog::spdlog_ex);
+    REQUIRE_THROWS_AS(sampler{sampling_policy::rate_limit(10, milliseconds(0))}, spdlog::spdlog_ex);
+}
+
+TEST_CASE("sampler reset", "[sampling]")
+{
+    sampler s{sampling_policy::every_nth(3)};
+    auto now = spdlog::log_clock::now();
+    size_t suppressed = 0;
+    REQUIRE(s.allow(now, suppressed));
+    REQUIRE_FALSE(s.allow(now, suppressed));
+
+    s.reset(sampling_policy::first_n(1, milliseconds(100)));
+    REQUIRE(s.policy().type == sampling_policy::kind::first_n);
+    REQUIRE(s.policy().n == 1);
+    REQUIRE(s.policy().interval == milliseconds(100));
+    REQUIRE(s.allow(now, suppressed));
+    REQUIRE_FALSE(s.allow(now, suppressed));
+
+    // an invalid policy leaves the sampler alone
+    REQUIRE_THROWS_AS(s.reset(sampling_policy::every_nth(0)), spdlog::spdlog_ex);
+    REQUIRE(s.policy().type == sampling_policy::kind::first_n);
+}
+
+TEST_CASE("logger sampling", "[sampling]")
+{
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_st>();
+    spdlog::logger logger("sampling", test_sink);
+    logger.set_pattern("%v");
+    logger.set_sampling(sampling_policy::first_n(2, std::chrono::hours(1)));
+
+    for (int i = 0; i < 10; i++)
+    {
+        logger.info("msg {}", i);
+    }
+    // below the level: not counted
+    logger.debug("debug");
+    REQUIRE(test_sink->lines() == std::vector<std::string>{"msg 0", "msg 1"});
+
+    logger.set_sampling(sampling_policy{});
+    logger.info("msg 10");
+    REQUIRE(test_sink->msg_counter() == 3);
+}
+
+static void storm(spdlog::logger &logger, int i)
+{
+    SPDLOG_LOGGER_ERROR(&logger, "storm {}", i);
+}
+
+TEST_CASE("callsite sampling", "[sampling]")
+{
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_st>();
+    spdlog::logger logger("sampling", test_sink);
+    logger.set_pattern("%v");
+
+    spdlog::set_callsite_sampling("storm()", sampling_policy::rate_limit(3, milliseconds(200)));
+    for (int i = 0; i < 10; i++)
+    {
+        storm(logger, i);
+    }
+    SPDLOG_LOGGER_ERROR(&logger, "other site");
+    REQUIRE(test_sink->lines() == std::vector<std::string>{"storm 0", "storm 1", "storm 2", "other site"});
+
+    spdlog::details::os::sleep_for_millis(250);
+    storm(logger, 10);
+    spdlog::set_callsite_sampling("storm()", sampling_policy{});
+    storm(logger, 11);
+    storm(logger, 12);
+
+    auto lines = test_sink->lines();
+    REQUIRE(lines.size() == 8);
+    REQUIRE(lines[4] == "Suppressed 7 messages");
+    REQUIRE(lines[5] == "storm 10");
+    REQUIRE(lines[7] == "storm 12");
+}
+
+TEST_CASE("callsite sampling reuses the sampler", "[sampling]")
+{
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_st>();
+    spdlog::logger logger("sampling", test_sink);
+    storm(logger, 0);
+    auto site_sampler = [] {
+        spdlog::details::sampler *found = nullptr;
+        spdlog::details::callsite_registry::instance().for_each([&found](spdlog::details::callsite &site) {
+            if (std::string(site.loc.funcname).find("storm") != std::string::npos)
+            {
+                found = site.site_sampler();
+            }
+        });
+        return found;
+    };
+
+    spdlog::set_callsite_sampling("storm()", sampling_policy::every_nth(2));
+    auto *first = site_sampler();
+    REQUIRE(first != nullptr);
+    spdlog::set_callsite_sampling("storm()", sampling_policy::every_nth(3));
+    REQUIRE(site_sampler() == first);
+    REQUIRE(first->policy().n == 3);
+    spdlog::set_callsite_sampling("storm()", sampling_policy{});
+    REQUIRE(site_sampler() == nullptr);
+    spdlog::set_callsite_sampling("storm()", sampling_policy::every_nth(4));
+    REQUIRE(site_sampler() == first);
+    spdlog::set_callsite_sampling("storm()", sampling_policy{});
+}
+
+TEST_CASE("logger sampling changed while logging", "[sampling]")
+{
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+    spdlog::logger logger("sampling", test_sink);
+    std::atomic<bool> done{false};
+    std::thread th([&logger, &done] {
+        while (!done)
+        {
+            logger.info("msg");
+        }
+    });
+    while (test_sink->msg_counter() == 0)
+    {
+        std::this_thread::yield();
+    }
+    for (int i = 0; i < 1000; i++)
+    {
+        logger.set_sampling(i % 2 == 0 ? sampling_policy::every_nth(2) : sampling_policy::first_n(1, milliseconds(10)));
+        if (i % 100 == 0)
+        {
+            logger.set_sampling(sampling_policy{});
+        }
+    }
+    logger.set_sampling(sampling_policy{});
+    auto logged = test_sink->msg_counter();
+    while (test_sink->msg_counter() == logged)
+    {
+        std::this_thread::yield();
+    }
+    done = true;
+    th.join();
+    REQUIRE(test_sink->msg_counter() > logged);
+}
+
+TEST_CASE("sampling summary on flush", "[sampling]")
+{
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_st>();
+    {
+        spdlog::logger logger("sampling", test_sink);
+        logger.set_pattern("%l %v");
+        logger.set_sampling(sampling_policy::first_n(2, std::chrono::hours(1)));
+        for (int i = 0; i < 10; i++)
+        {
+            logger.warn("msg {}", i);
+        }
+        // the window is still open: the summary is logged by flush(), once
+        logger.flush();
+        logger.flush();
+        REQUIRE(test_sink->lines() == std::vector<std::string>{"warning msg 0", "warning msg 1", "warning Suppressed 8 messages"});
+
+        // and by the destructor
+        logger.warn("msg 10");
+    }
+    REQUIRE(test_sink->lines().size() == 4);
+    REQUIRE(test_sink->lines()[3] == "warning Suppressed 1 messages");
+}
+
+TEST_CASE("callsite sampling summary on flush", "[sampling]")
+{
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_st>();
+    spdlog::logger logger("sampling", test_sink);
+    spdlog::logger other("other", test_sink);
+    logger.set_pattern("%n %l %! %v");
+    other.set_pattern("%n %l %! %v");
+
+    spdlog::set_callsite_sampling("storm()", sampling_policy::rate_limit(1, std::chrono::hours(1)));
+    for (int i = 0; i < 5; i++)
+    {
+        storm(logger, i);
+    }
+    // the summary goes to the logger of the last dropped message
+    other.flush();
+    REQUIRE(test_sink->msg_counter() == 1);
+    logger.flush();
+    spdlog::set_callsite_sampling("storm()", sampling_policy{});
+    REQUIRE(test_sink->lines() == std::vector<std::string>{"sampling error storm storm 0", "sampling error storm Suppressed 4 messages"});
+}
@@ -127,6 +127,46 @@ TEST_CASE("buffered_msg_field_copies ", "[structured]")
     REQUIRE(test1->field_data[1].string_view_ == "two");
 }
 
+TEST_CASE("buffered_msg_field_moves ", "[structured]")
+{
+    using spdlog::details::log_msg_buffer;
+    auto few = {F("a", 1), F("b", "two")};
+    auto many = {F("a", 1), F("b", "two"), F("c", 3), F("d", "four"), F("e", 5)};
+    spdlog::details::log_msg small_msg(spdlog::source_loc{}, "name", spdlog::level::info, "msg", few.begin(), few.size());
+    spdlog::details::log_msg large_msg(spdlog::source_loc{}, "name", spdlog::level::info, "msg", many.begin(), many.size());
+
+    auto check = [](const log_msg_buffer &buffered, size_t count) {
+        REQUIRE(buffered.field_data_count == count);
+        REQUIRE(buffered.field_data[1].string_view_ == "two");
+        REQUIRE(buffered.field_data[count - 1].name == (count == 2 ? "b" : "e"));
+        REQUIRE(buffered.logger_name == "name");
+        REQUIRE(buffered.payload == "msg");
+    };
+
+    for (auto *msg : {&small_msg, &large_msg})
+    {
+        auto count = msg->field_data_count;
+        std::unique_ptr<log_msg_buffer> source{new log_msg_buffer{*msg}};
+        log_msg_buffer copied{*source};
+        log_msg_buffer moved{std::move(*source)};
+        source.reset();
+        check(copied, count);
+        check(moved, count);
+
+        // inline fields are owned by the buffer they were moved to
+        auto *moved_begin = reinterpret_cast<const char *>(&moved);
+        auto *fields_begin = reinterpret_cast<const char *>(moved.field_data);
+        bool inline_fields = fields_begin >= moved_begin && fields_begin < moved_begin + sizeof(moved);
+        REQUIRE(inline_fields == (count <= SPDLOG_MSG_BUFFER_INLINE_FIELDS));
+
+        log_msg_buffer assigned;
+        assigned = std::move(moved);
+        check(assigned, count);
+        assigned = copied;
+        check(assigned, count);
+    }
+}
+
 TEST_CASE("async_structured ", "[structured]")
 {
     auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
@@ -274,4 +314,79 @@ TEST_CASE("structured snapshots with ctx", "[structured]")
 }
 
 
+TEST_CASE("tail sampling discards on success", "[structured]")
+{
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_st>();
+    spdlog::logger logger("tail", test_sink);
+    logger.set_pattern("%v%V");
+    {
+        spdlog::tail_sampling_context ctx({{"req", 1}});
+        logger.debug("parsing");
+        logger.info("done");
+        REQUIRE(ctx.buffered() == 1);
+        REQUIRE(spdlog::details::tail_buffer::current() != nullptr);
+    }
+    REQUIRE(spdlog::details::tail_buffer::current() == nullptr);
+    logger.debug("after");
+    REQUIRE(test_sink->lines() == std::vector<std::string>{"done req:1"});
+}
+
+TEST_CASE("tail sampling flushes on error", "[structured]")
+{
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_st>();
+    spdlog::logger logger("tail", test_sink);
+    logger.set_pattern("%v%V");
+    {
+        spdlog::tail_sampling_context ctx({{"req", 2}}, 2);
+        logger.trace("step 1");
+        logger.debug("step 2");
+        logger.debug("step 3");
+        logger.debug("step 4");
+        REQUIRE(ctx.dropped() == 2);
+        logger.error("failed");
+        REQUIRE(ctx.promoted());
+        REQUIRE(ctx.buffered() == 0);
+        // promoted contexts log below level messages directly
+        logger.debug("cleanup");
+    }
+    REQUIRE(test_sink->lines() == std::vector<std::string>{"step 3 req:2", "step 4 req:2", "failed req:2", "cleanup req:2"});
+}
+
+TEST_CASE("tail sampling explicit promote", "[structured]")
+{
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_st>();
+    spdlog::logger logger("tail", test_sink);
+    logger.set_pattern("%v");
+    {
+        spdlog::tail_sampling_context outer({}, 16, spdlog::level::debug);
+        logger.trace("not captured");
+        logger.debug("outer");
+        {
+            spdlog::tail_sampling_context inner({});
+            logger.debug("inner");
+            inner.promote();
+        }
+        REQUIRE(outer.promoted());
+        logger.debug("outer again");
+    }
+    REQUIRE(test_sink->lines() == std::vector<std::string>{"outer", "inner", "outer again"});
+}
+
+TEST_CASE("tail sampling is per thread", "[structured]")
+{
+    auto test_sink = std::make_shared<spdlog::sinks::test_sink_mt>();
+    spdlog::logger logger("tail", test_sink);
+    logger.set_pattern("%v");
+    spdlog::tail_sampling_context ctx({});
+    std::thread th([&logger] {
+        logger.debug("other thread");
+        logger.error("other error");
+    });
+    th.join();
+    REQUIRE_FALSE(ctx.promoted());
+    REQUIRE(ctx.buffered() == 0);
+    REQUIRE(test_sink->lines() == std::vector<std::string>{"other error"});
+}
+
+
 #endif // SPDLOG_NO_STRUCTURED_SPDLOG